@@ -0,0 +1,794 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#define _POSIX_C_SOURCE 199309L
+
+#include <clash/binary.h>
+#include <clash/clash.h>
+#include <clash/compiled.h>
+#include <clash/complete.h>
+#include <clash/response.h>
+#include <clash/scratch.h>
+#include <clash/state.h>
+#include <clog/clog.h>
+#include <clog/console.h>
+#include <flood/out_stream.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+clog_config g_clog;
+
+// ----- Allocation counting -----
+// On glibc every malloc() in the process, including the ones in the clash library, goes through
+// these, so the allocation count for a phase is exact.
+
+#if defined __GLIBC__
+
+#define BENCH_COUNTS_ALLOCATIONS (1)
+
+#if defined __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wreserved-identifier"
+#endif
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* p, size_t size);
+#if defined __clang__
+#pragma clang diagnostic pop
+#endif
+
+static size_t g_allocationCount;
+
+void* malloc(size_t size)
+{
+    g_allocationCount++;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    g_allocationCount++;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* p, size_t size)
+{
+    g_allocationCount++;
+    return __libc_realloc(p, size);
+}
+
+#else
+
+#define BENCH_COUNTS_ALLOCATIONS (0)
+static size_t g_allocationCount;
+
+#endif
+
+// ----- Timing -----
+
+static uint64_t nowNanoseconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+typedef struct BenchMeasurement {
+    uint64_t startTime;
+    size_t startAllocationCount;
+    uint64_t elapsed;
+    size_t allocationCount;
+    size_t commandCount;
+} BenchMeasurement;
+
+static void measurementInit(BenchMeasurement* self)
+{
+    self->elapsed = 0;
+    self->allocationCount = 0;
+    self->commandCount = 0;
+}
+
+static void measurementStart(BenchMeasurement* self)
+{
+    self->startAllocationCount = g_allocationCount;
+    self->startTime = nowNanoseconds();
+}
+
+static void measurementStop(BenchMeasurement* self, size_t commandCount)
+{
+    self->elapsed += nowNanoseconds() - self->startTime;
+    self->allocationCount += g_allocationCount - self->startAllocationCount;
+    self->commandCount += commandCount;
+}
+
+static void measurementPrint(
+    const BenchMeasurement* self, const char* definitionName, const char* phase)
+{
+    double nsPerCommand = (double)self->elapsed / (double)self->commandCount;
+    printf("%-16s %-34s %12.1f", definitionName, phase, nsPerCommand);
+    if (BENCH_COUNTS_ALLOCATIONS) {
+        printf(" %14.3f\n", (double)self->allocationCount / (double)self->commandCount);
+    } else {
+        printf(" %14s\n", "-");
+    }
+}
+
+// ----- Synthetic definitions -----
+
+#define BENCH_MAX_OPTIONS (64)
+#define BENCH_MAX_TOKENS (64)
+#define BENCH_MAX_LINE_OCTETS (512)
+#define BENCH_CORPUS_LINE_COUNT (1000)
+#define BENCH_TARGET_COMMAND_COUNT (200000)
+#define BENCH_SCRATCH_OCTETS (4096)
+#define BENCH_BINARY_OCTETS (1024)
+
+/// Every option is stored in its own slot, large enough for all the option types.
+typedef struct BenchValues {
+    uint64_t slots[BENCH_MAX_OPTIONS];
+} BenchValues;
+
+typedef struct BenchDefinitionSettings {
+    const char* name;
+    size_t rootCount;
+    size_t depth;
+    size_t branchCount;
+    size_t optionCount;
+} BenchDefinitionSettings;
+
+typedef struct BenchDefinition {
+    const BenchDefinitionSettings* settings;
+    ClashDefinition definition;
+    ClashCommand** commandArrays;
+    size_t commandArrayCount;
+    ClashOption** optionArrays;
+    size_t optionArrayCount;
+    char** names;
+    size_t nameCount;
+    ClashCommand** leaves;
+    size_t leafCount;
+    const ClashCommand*** leafPaths;
+} BenchDefinition;
+
+static uint32_t g_randomState = 0x12345678u;
+
+static uint32_t randomNext(void)
+{
+    uint32_t x = g_randomState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    g_randomState = x;
+
+    return x;
+}
+
+static size_t randomBelow(size_t count)
+{
+    return (size_t)randomNext() % count;
+}
+
+static char* benchName(BenchDefinition* self, size_t index)
+{
+    static const char letters[] = "abcdefghijklmnopqrstuvwxyz";
+    size_t length = 3 + randomBelow(8);
+    char* name = malloc(length + 12);
+    for (size_t i = 0; i < length; ++i) {
+        name[i] = letters[randomBelow(26)];
+    }
+    sprintf(&name[length], "%zu", index);
+    self->names[self->nameCount++] = name;
+
+    return name;
+}
+
+static ClashOptionType optionType(size_t optionIndex)
+{
+    switch (optionIndex % 4) {
+    case 0:
+        return ClashTypeString;
+    case 1:
+        return ClashTypeFlag;
+    case 2:
+        return ClashTypeInt;
+    default:
+        return ClashTypeUInt64;
+    }
+}
+
+static void noCallback(void* userData, const void* data, ClashResponse* response)
+{
+    (void)userData;
+    (void)data;
+    (void)response;
+}
+
+static ClashOption* createOptions(BenchDefinition* self, size_t optionCount)
+{
+    static const char shortNames[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+    ClashOption* options = malloc(sizeof(ClashOption) * optionCount);
+    for (size_t i = 0; i < optionCount; ++i) {
+        ClashOption option = { benchName(self, i), i < sizeof(shortNames) - 1 ? shortNames[i] : 0,
+            "benchmark option",
+            i == 0 ? ClashTypeString | ClashTypeArg : optionType(i), i == 0 ? "default" : "",
+            offsetof(BenchValues, slots) + sizeof(uint64_t) * i, 0, 0, 0 };
+        memcpy(&options[i], &option, sizeof(option));
+    }
+    self->optionArrays[self->optionArrayCount++] = options;
+
+    return options;
+}
+
+static void recordLeafPath(
+    BenchDefinition* self, const ClashCommand** path, size_t depth, ClashCommand* leaf)
+{
+    const ClashCommand** copy = malloc(sizeof(ClashCommand*) * (depth + 1));
+    memcpy(copy, path, sizeof(ClashCommand*) * depth);
+    copy[depth] = leaf;
+    self->leafPaths[self->leafCount] = copy;
+    self->leaves[self->leafCount++] = leaf;
+}
+
+static ClashCommand* createCommands(BenchDefinition* self, size_t count, size_t depth,
+    const ClashCommand** path, size_t pathDepth)
+{
+    const BenchDefinitionSettings* settings = self->settings;
+    ClashCommand* commands = malloc(sizeof(ClashCommand) * count);
+    self->commandArrays[self->commandArrayCount++] = commands;
+
+    for (size_t i = 0; i < count; ++i) {
+        ClashCommand* command = &commands[i];
+        const char* name = benchName(self, i);
+        if (depth > 1) {
+            path[pathDepth] = command;
+            ClashCommand* subCommands
+                = createCommands(self, settings->branchCount, depth - 1, path, pathDepth + 1);
+            ClashCommand branch
+                = { name, "benchmark command", 0, 0, 0, subCommands, settings->branchCount, 0, 0 };
+            memcpy(command, &branch, sizeof(branch));
+        } else {
+            ClashCommand leaf = { name, "benchmark command", sizeof(BenchValues),
+                createOptions(self, settings->optionCount), settings->optionCount, 0, 0,
+                noCallback, 0 };
+            memcpy(command, &leaf, sizeof(leaf));
+            recordLeafPath(self, path, pathDepth, command);
+        }
+    }
+
+    return commands;
+}
+
+static size_t countCommands(const BenchDefinitionSettings* settings)
+{
+    size_t count = 0;
+    size_t levelCount = settings->rootCount;
+    for (size_t level = 0; level < settings->depth; ++level) {
+        count += levelCount;
+        levelCount *= settings->branchCount;
+    }
+
+    return count;
+}
+
+static void benchDefinitionInit(BenchDefinition* self, const BenchDefinitionSettings* settings)
+{
+    size_t commandCount = countCommands(settings);
+    self->settings = settings;
+    self->commandArrays = malloc(sizeof(ClashCommand*) * commandCount);
+    self->commandArrayCount = 0;
+    self->optionArrays = malloc(sizeof(ClashOption*) * commandCount);
+    self->optionArrayCount = 0;
+    self->names = malloc(sizeof(char*) * commandCount * (1 + settings->optionCount));
+    self->nameCount = 0;
+    self->leaves = malloc(sizeof(ClashCommand*) * commandCount);
+    self->leafPaths = malloc(sizeof(ClashCommand**) * commandCount);
+    self->leafCount = 0;
+
+    const ClashCommand* path[16];
+    self->definition.commands
+        = createCommands(self, settings->rootCount, settings->depth, path, 0);
+    self->definition.commandCount = settings->rootCount;
+    self->definition.index = 0;
+    self->definition.parseCache = 0;
+}
+
+static void benchDefinitionDestroy(BenchDefinition* self)
+{
+    clashDefinitionDestroy(&self->definition);
+    for (size_t i = 0; i < self->commandArrayCount; ++i) {
+        free(self->commandArrays[i]);
+    }
+    for (size_t i = 0; i < self->optionArrayCount; ++i) {
+        free(self->optionArrays[i]);
+    }
+    for (size_t i = 0; i < self->nameCount; ++i) {
+        free(self->names[i]);
+    }
+    for (size_t i = 0; i < self->leafCount; ++i) {
+        free((void*)self->leafPaths[i]);
+    }
+    free(self->commandArrays);
+    free(self->optionArrays);
+    free(self->names);
+    free((void*)self->leaves);
+    free((void*)self->leafPaths);
+}
+
+static void setCallbacks(BenchDefinition* self, ClashFn fn)
+{
+    for (size_t i = 0; i < self->leafCount; ++i) {
+        self->leaves[i]->fn = fn;
+    }
+}
+
+// ----- Corpus -----
+
+typedef struct BenchLine {
+    char text[BENCH_MAX_LINE_OCTETS];
+    size_t length;
+    ClashStringView tokens[BENCH_MAX_TOKENS];
+    size_t tokenCount;
+    const char** path;
+    size_t pathCount;
+} BenchLine;
+
+static void appendf(BenchLine* line, const char* fmt, const char* s, uint32_t value)
+{
+    if (line->length != 0) {
+        line->text[line->length++] = ' ';
+    }
+    int written = snprintf(&line->text[line->length], BENCH_MAX_LINE_OCTETS - line->length, fmt,
+        s == 0 ? "" : s, value);
+    line->length += (size_t)written;
+}
+
+/// Creates a realistic command line for a random leaf: the command path, the argument and a few
+/// options of each type.
+static void createLine(BenchLine* line, const BenchDefinition* definition, const char** pathNames)
+{
+    size_t leafIndex = randomBelow(definition->leafCount);
+    const ClashCommand* const* path = definition->leafPaths[leafIndex];
+    size_t depth = definition->settings->depth;
+
+    line->length = 0;
+    for (size_t i = 0; i < depth; ++i) {
+        appendf(line, "%s", path[i]->name, 0);
+        pathNames[i] = path[i]->name;
+    }
+    line->path = pathNames;
+    line->pathCount = depth;
+
+    const ClashCommand* leaf = path[depth - 1];
+    if (randomBelow(4) == 0) {
+        appendf(line, "\"quoted %s\"", leaf->name, 0);
+    } else {
+        appendf(line, "file%s.dat", "", randomNext() % 100);
+    }
+
+    size_t optionUseCount = 1 + randomBelow(4);
+    for (size_t i = 0; i < optionUseCount; ++i) {
+        size_t optionIndex = 1 + randomBelow(leaf->optionCount - 1);
+        const ClashOption* option = &leaf->options[optionIndex];
+        switch (option->type & 0x7) {
+        case ClashTypeFlag:
+            if (option->shortName != 0) {
+                char shortName[2] = { option->shortName, 0 };
+                appendf(line, "-%s", shortName, 0);
+            } else {
+                appendf(line, "--%s x", option->name, 0);
+            }
+            break;
+        case ClashTypeInt:
+            appendf(line, "--%s %u", option->name, randomNext() % 10000);
+            break;
+        case ClashTypeUInt64:
+            appendf(line, "--%s 0x%x", option->name, randomNext());
+            break;
+        default:
+            appendf(line, "--%s value%u", option->name, randomNext() % 1000);
+            break;
+        }
+    }
+    line->text[line->length] = 0;
+
+    int tokenCount
+        = clashSplitStringViews(line->text, line->length, line->tokens, BENCH_MAX_TOKENS);
+    line->tokenCount = tokenCount < 0 ? 0 : (size_t)tokenCount;
+}
+
+// ----- Phases -----
+
+typedef struct Bench {
+    BenchDefinition* definition;
+    BenchLine* lines;
+    size_t lineCount;
+    size_t repeatCount;
+    ClashState* states;
+    uint8_t* scratchMemory;
+    ClashScratch* scratches;
+    uint8_t responseMemory[4096];
+    FldOutStream responseStream;
+} Bench;
+
+static void benchSplitViews(Bench* self)
+{
+    BenchMeasurement measurement;
+    measurementInit(&measurement);
+    ClashStringView tokens[BENCH_MAX_TOKENS];
+    size_t checksum = 0;
+
+    for (size_t repeat = 0; repeat < self->repeatCount; ++repeat) {
+        measurementStart(&measurement);
+        for (size_t i = 0; i < self->lineCount; ++i) {
+            const BenchLine* line = &self->lines[i];
+            checksum += (size_t)clashSplitStringViews(
+                line->text, line->length, tokens, BENCH_MAX_TOKENS);
+        }
+        measurementStop(&measurement, self->lineCount);
+    }
+
+    if (checksum == 0) {
+        printf("no tokens\n");
+    }
+    measurementPrint(&measurement, self->definition->settings->name, "clashSplitStringViews");
+}
+
+static void benchSplitCopy(Bench* self)
+{
+    BenchMeasurement measurement;
+    measurementInit(&measurement);
+    const char* tokens[BENCH_MAX_TOKENS];
+    char temp[BENCH_MAX_LINE_OCTETS + BENCH_MAX_TOKENS];
+    size_t checksum = 0;
+
+    for (size_t repeat = 0; repeat < self->repeatCount; ++repeat) {
+        measurementStart(&measurement);
+        for (size_t i = 0; i < self->lineCount; ++i) {
+            checksum += (size_t)clashSplitString(
+                self->lines[i].text, temp, sizeof(temp), tokens, BENCH_MAX_TOKENS);
+        }
+        measurementStop(&measurement, self->lineCount);
+    }
+
+    if (checksum == 0) {
+        printf("no tokens\n");
+    }
+    measurementPrint(&measurement, self->definition->settings->name, "clashSplitString");
+}
+
+/// Feeds the already split tokens of every line into its own state. Only the command and option
+/// lookups and recording of the values happen here.
+static void feedAll(Bench* self)
+{
+    const ClashDefinition* definition = &self->definition->definition;
+    for (size_t i = 0; i < self->lineCount; ++i) {
+        const BenchLine* line = &self->lines[i];
+        ClashScratch* scratch = &self->scratches[i];
+        clashScratchRewind(scratch, 0);
+        ClashState* state = &self->states[i];
+        clashStateInit(state, definition, scratch, 0);
+        for (size_t tokenIndex = 0; tokenIndex < line->tokenCount; ++tokenIndex) {
+            const ClashStringView* token = &line->tokens[tokenIndex];
+            if (clashStateFeed(state, token->str, token->length) < 0) {
+                printf("could not parse '%s'\n", line->text);
+                exit(1);
+            }
+        }
+    }
+}
+
+static void benchLookup(Bench* self, const char* phase)
+{
+    BenchMeasurement measurement;
+    measurementInit(&measurement);
+
+    for (size_t repeat = 0; repeat < self->repeatCount; ++repeat) {
+        measurementStart(&measurement);
+        feedAll(self);
+        measurementStop(&measurement, self->lineCount);
+    }
+
+    measurementPrint(&measurement, self->definition->settings->name, phase);
+}
+
+static void benchDispatch(Bench* self, ClashFn fn, const char* phase)
+{
+    BenchMeasurement measurement;
+    measurementInit(&measurement);
+    setCallbacks(self->definition, fn);
+
+    for (size_t repeat = 0; repeat < self->repeatCount; ++repeat) {
+        feedAll(self);
+        measurementStart(&measurement);
+        for (size_t i = 0; i < self->lineCount; ++i) {
+            fldOutStreamInit(
+                &self->responseStream, self->responseMemory, sizeof(self->responseMemory));
+            clashStateDispatch(&self->states[i], 0, &self->responseStream);
+        }
+        measurementStop(&measurement, self->lineCount);
+    }
+
+    setCallbacks(self->definition, noCallback);
+    measurementPrint(&measurement, self->definition->settings->name, phase);
+}
+
+static void benchParse(Bench* self)
+{
+    BenchMeasurement measurement;
+    measurementInit(&measurement);
+    const ClashDefinition* definition = &self->definition->definition;
+    ClashScratch* scratch = &self->scratches[0];
+
+    for (size_t repeat = 0; repeat < self->repeatCount; ++repeat) {
+        measurementStart(&measurement);
+        for (size_t i = 0; i < self->lineCount; ++i) {
+            fldOutStreamInit(
+                &self->responseStream, self->responseMemory, sizeof(self->responseMemory));
+            clashScratchRewind(scratch, 0);
+            clashParseStringEx(
+                definition, self->lines[i].text, 0, &self->responseStream, scratch, 0);
+        }
+        measurementStop(&measurement, self->lineCount);
+    }
+
+    measurementPrint(&measurement, self->definition->settings->name, "clashParseStringEx");
+}
+
+static void benchExecuteCompiled(Bench* self)
+{
+    BenchMeasurement measurement;
+    measurementInit(&measurement);
+    const ClashDefinition* definition = &self->definition->definition;
+    ClashCompiledCommand** compiled = malloc(sizeof(ClashCompiledCommand*) * self->lineCount);
+    for (size_t i = 0; i < self->lineCount; ++i) {
+        compiled[i] = clashCompileCommand(definition, self->lines[i].text, 0);
+        if (compiled[i] == 0) {
+            printf("could not compile '%s'\n", self->lines[i].text);
+            exit(1);
+        }
+    }
+
+    for (size_t repeat = 0; repeat < self->repeatCount; ++repeat) {
+        measurementStart(&measurement);
+        for (size_t i = 0; i < self->lineCount; ++i) {
+            fldOutStreamInit(
+                &self->responseStream, self->responseMemory, sizeof(self->responseMemory));
+            clashExecuteCompiled(compiled[i], 0, &self->responseStream);
+        }
+        measurementStop(&measurement, self->lineCount);
+    }
+
+    for (size_t i = 0; i < self->lineCount; ++i) {
+        clashCompiledCommandDestroy(compiled[i]);
+    }
+    free((void*)compiled);
+    measurementPrint(&measurement, self->definition->settings->name, "clashExecuteCompiled");
+}
+
+/// Encodes every line once, checks that the binary command executes, then measures only the
+/// execution of the binary commands.
+static void benchBinaryExecute(Bench* self)
+{
+    BenchMeasurement measurement;
+    measurementInit(&measurement);
+    const ClashDefinition* definition = &self->definition->definition;
+    ClashScratch* scratch = &self->scratches[0];
+    uint8_t* encoded = malloc(BENCH_BINARY_OCTETS * self->lineCount);
+    size_t* encodedOctetCounts = malloc(sizeof(size_t) * self->lineCount);
+    for (size_t i = 0; i < self->lineCount; ++i) {
+        FldOutStream outStream;
+        fldOutStreamInit(&outStream, &encoded[i * BENCH_BINARY_OCTETS], BENCH_BINARY_OCTETS);
+        clashScratchRewind(scratch, 0);
+        int octetCount = clashBinaryEncodeString(definition, self->lines[i].text, &outStream,
+            scratch, 0);
+        fldOutStreamInit(
+            &self->responseStream, self->responseMemory, sizeof(self->responseMemory));
+        if (octetCount < 0
+            || clashBinaryExecute(definition, &encoded[i * BENCH_BINARY_OCTETS],
+                   (size_t)octetCount, 0, &self->responseStream, scratch, 0)
+                < 0) {
+            printf("could not encode and execute '%s'\n", self->lines[i].text);
+            exit(1);
+        }
+        encodedOctetCounts[i] = (size_t)octetCount;
+    }
+
+    for (size_t repeat = 0; repeat < self->repeatCount; ++repeat) {
+        measurementStart(&measurement);
+        for (size_t i = 0; i < self->lineCount; ++i) {
+            fldOutStreamInit(
+                &self->responseStream, self->responseMemory, sizeof(self->responseMemory));
+            clashBinaryExecute(definition, &encoded[i * BENCH_BINARY_OCTETS],
+                encodedOctetCounts[i], 0, &self->responseStream, scratch, 0);
+        }
+        measurementStop(&measurement, self->lineCount);
+    }
+
+    free(encoded);
+    free(encodedOctetCounts);
+    measurementPrint(&measurement, self->definition->settings->name, "clashBinaryExecute");
+}
+
+/// Completes the first two characters of every line, so the candidates are all the root commands
+/// with that prefix.
+static void benchComplete(Bench* self, const char* phase)
+{
+    BenchMeasurement measurement;
+    measurementInit(&measurement);
+    const ClashDefinition* definition = &self->definition->definition;
+    ClashCompletion candidates[16];
+    size_t wordStart;
+    size_t checksum = 0;
+
+    for (size_t repeat = 0; repeat < self->repeatCount; ++repeat) {
+        measurementStart(&measurement);
+        for (size_t i = 0; i < self->lineCount; ++i) {
+            checksum += (size_t)clashComplete(
+                definition, self->lines[i].text, 2, candidates, 16, &wordStart);
+        }
+        measurementStop(&measurement, self->lineCount);
+    }
+
+    if (checksum == 0) {
+        printf("no completions\n");
+    }
+    measurementPrint(&measurement, self->definition->settings->name, phase);
+}
+
+/// Parses every line with the first two characters of the command swapped, so each parse fails
+/// and searches for a suggestion among the root commands.
+static void benchTypo(Bench* self, const char* phase)
+{
+    BenchMeasurement measurement;
+    measurementInit(&measurement);
+    const ClashDefinition* definition = &self->definition->definition;
+    ClashScratch* scratch = &self->scratches[0];
+    char* typoLines = malloc(BENCH_MAX_LINE_OCTETS * self->lineCount);
+    for (size_t i = 0; i < self->lineCount; ++i) {
+        char* typoLine = &typoLines[i * BENCH_MAX_LINE_OCTETS];
+        memcpy(typoLine, self->lines[i].text, self->lines[i].length + 1);
+        char first = typoLine[0];
+        typoLine[0] = typoLine[1];
+        typoLine[1] = first;
+    }
+
+    ClashParseError error;
+    size_t suggestionCount = 0;
+    for (size_t repeat = 0; repeat < self->repeatCount; ++repeat) {
+        measurementStart(&measurement);
+        for (size_t i = 0; i < self->lineCount; ++i) {
+            fldOutStreamInit(
+                &self->responseStream, self->responseMemory, sizeof(self->responseMemory));
+            clashScratchRewind(scratch, 0);
+            clashParseStringEx(definition, &typoLines[i * BENCH_MAX_LINE_OCTETS], 0,
+                &self->responseStream, scratch, &error);
+            suggestionCount += error.suggestion != 0;
+        }
+        measurementStop(&measurement, self->lineCount);
+    }
+
+    if (suggestionCount == 0) {
+        printf("no suggestions\n");
+    }
+    free(typoLines);
+    measurementPrint(&measurement, self->definition->settings->name, phase);
+}
+
+static void benchUsage(Bench* self, const char* phase)
+{
+    BenchMeasurement measurement;
+    measurementInit(&measurement);
+    const ClashDefinition* definition = &self->definition->definition;
+    size_t usageOctetCount = 64 * 1024 * 1024;
+    uint8_t* usageMemory = malloc(usageOctetCount);
+    FldOutStream usageStream;
+    size_t callCount = self->repeatCount < 10 ? self->repeatCount : 10;
+
+    for (size_t repeat = 0; repeat < callCount; ++repeat) {
+        fldOutStreamInit(&usageStream, usageMemory, usageOctetCount);
+        measurementStart(&measurement);
+        clashUsageToStream(definition, &usageStream);
+        measurementStop(&measurement, 1);
+    }
+
+    char fullPhase[64];
+    sprintf(fullPhase, "%s (all)", phase);
+    measurementPrint(&measurement, self->definition->settings->name, fullPhase);
+
+    measurementInit(&measurement);
+    for (size_t repeat = 0; repeat < self->repeatCount; ++repeat) {
+        measurementStart(&measurement);
+        for (size_t i = 0; i < self->lineCount; ++i) {
+            const BenchLine* line = &self->lines[i];
+            fldOutStreamInit(&usageStream, usageMemory, usageOctetCount);
+            clashUsageCommandToStream(definition, line->path, line->pathCount, &usageStream);
+        }
+        measurementStop(&measurement, self->lineCount);
+    }
+
+    sprintf(fullPhase, "%s (command)", phase);
+    measurementPrint(&measurement, self->definition->settings->name, fullPhase);
+
+    free(usageMemory);
+}
+
+static void runBench(const BenchDefinitionSettings* settings)
+{
+    BenchDefinition definition;
+    benchDefinitionInit(&definition, settings);
+
+    Bench bench;
+    bench.definition = &definition;
+    bench.lineCount = BENCH_CORPUS_LINE_COUNT;
+    bench.repeatCount = BENCH_TARGET_COMMAND_COUNT / BENCH_CORPUS_LINE_COUNT;
+    bench.lines = malloc(sizeof(BenchLine) * bench.lineCount);
+    const char** pathNames = malloc(sizeof(char*) * bench.lineCount * settings->depth);
+    for (size_t i = 0; i < bench.lineCount; ++i) {
+        createLine(&bench.lines[i], &definition, &pathNames[i * settings->depth]);
+    }
+    bench.states = malloc(sizeof(ClashState) * bench.lineCount);
+    bench.scratchMemory = malloc(BENCH_SCRATCH_OCTETS * bench.lineCount);
+    bench.scratches = malloc(sizeof(ClashScratch) * bench.lineCount);
+    for (size_t i = 0; i < bench.lineCount; ++i) {
+        uint8_t* memory = &bench.scratchMemory[i * BENCH_SCRATCH_OCTETS];
+        clashScratchInit(&bench.scratches[i], memory, BENCH_SCRATCH_OCTETS);
+    }
+
+    benchSplitViews(&bench);
+    benchSplitCopy(&bench);
+    benchLookup(&bench, "lookup (not compiled)");
+    benchComplete(&bench, "clashComplete (not compiled)");
+    benchTypo(&bench, "typo + suggestion (not compiled)");
+    benchUsage(&bench, "usage render");
+
+    clashDefinitionCompile(&definition.definition);
+
+    benchLookup(&bench, "lookup (compiled)");
+    benchDispatch(&bench, 0, "dispatch (no callback)");
+    benchDispatch(&bench, noCallback, "convertToStruct + callback");
+    benchParse(&bench);
+    benchExecuteCompiled(&bench);
+    benchBinaryExecute(&bench);
+    benchComplete(&bench, "clashComplete (compiled)");
+    benchTypo(&bench, "typo + suggestion (compiled)");
+    benchUsage(&bench, "usage copy");
+    printf("\n");
+
+    free(bench.lines);
+    free((void*)pathNames);
+    free(bench.states);
+    free(bench.scratchMemory);
+    free(bench.scratches);
+    benchDefinitionDestroy(&definition);
+}
+
+int main(int argc, const char* argv[])
+{
+    g_clog.log = clog_console;
+
+    static const BenchDefinitionSettings settings[] = {
+        { "commands-10", 10, 1, 0, 8 },
+        { "commands-100", 100, 1, 0, 8 },
+        { "commands-1000", 1000, 1, 0, 8 },
+        { "deep-3x6", 3, 6, 3, 8 },
+        { "wide-options", 10, 1, 0, BENCH_MAX_OPTIONS },
+    };
+
+    const char* filter = argc > 1 ? argv[1] : 0;
+
+    printf("%-16s %-34s %12s %14s\n", "definition", "phase", "ns/command", "allocs/command");
+    for (size_t i = 0; i < sizeof(settings) / sizeof(settings[0]); ++i) {
+        if (filter != 0 && strstr(settings[i].name, filter) == 0) {
+            continue;
+        }
+        runBench(&settings[i]);
+    }
+
+    return 0;
+}
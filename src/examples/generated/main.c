@@ -0,0 +1,79 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include "example_commands.h"
+#include <clash/parse_error.h>
+#include <clash/response.h>
+#include <clash/scratch.h>
+#include <clog/clog.h>
+#include <clog/console.h>
+#include <flood/out_stream.h>
+#include <stdio.h>
+
+clog_config g_clog;
+
+typedef struct App {
+    const char* secret;
+    int isRunning;
+} App;
+
+void onRecordStart(void* userData, const RecordStartCmd* data, ClashResponse* response)
+{
+    const App* self = (const App*)userData;
+
+    clashResponseWritecf(response, 3, "\nrecord start: %s '", self->secret);
+    clashResponseWritecf(response, 1, "%s", data->filename);
+    clashResponseResetColor(response);
+    clashResponseWritef(response, "'");
+    clashResponseWritecf(response, 18, " verbose:%d frames:%d length:%lld ms quality:%.*s\n",
+        data->verbose, data->frames, (long long)data->length, (int)data->quality.length,
+        data->quality.str);
+}
+
+void onRecordStop(void* userData, const RecordStopCmd* data, ClashResponse* response)
+{
+    (void)userData;
+
+    clashResponseWritecf(response, 22, "\nrecord stop:  %d\n\n", data->verbose);
+}
+
+void onQuit(void* userData, const void* data, ClashResponse* response)
+{
+    (void)data;
+
+    App* self = (App*)userData;
+    self->isRunning = 0;
+    clashResponseWritef(response, "\nquit\n");
+}
+
+int main(int argc, const char* argv[])
+{
+    g_clog.log = clog_console;
+
+    const char* line = argc > 1 ? argv[1] : "record start myfile.swamp-capture -v --frames 30";
+
+    uint8_t scratchMemory[256];
+    ClashScratch scratch;
+    clashScratchInit(&scratch, scratchMemory, sizeof(scratchMemory));
+
+    uint8_t tempResponse[512];
+    FldOutStream responseOut;
+    fldOutStreamInit(&responseOut, tempResponse, 512);
+
+    App app;
+    app.secret = "VerySecret";
+    app.isRunning = 1;
+
+    ClashParseError error;
+    int errorCode = exampleParseString(line, &app, &responseOut, &scratch, &error);
+    if (errorCode < 0) {
+        clashParseErrorToStream(&error, &responseOut);
+        fldOutStreamWriteUInt8(&responseOut, 0);
+    }
+
+    printf("response:\n%s", tempResponse);
+    printf("errorCode:%d\n", errorCode);
+
+    return errorCode;
+}
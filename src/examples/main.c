@@ -43,25 +43,26 @@ static void onRecordStop(App* self, const RecordStopCmd* data, ClashResponse* re
 
 static ClashOption recordStartOptions[]
     = { { "name", 'n', "the file name to store capture to", ClashTypeString | ClashTypeArg,
-            "somefile.swamp-capture", offsetof(RecordStartCmd, filename) },
+            "somefile.swamp-capture", offsetof(RecordStartCmd, filename), 0, 0, 0 },
           { "verbose", 'v', "enable detailed output", ClashTypeFlag, "",
-              offsetof(RecordStartCmd, verbose) } };
+              offsetof(RecordStartCmd, verbose), 0, 0, 0 } };
 
 static ClashOption recordStopOptions[] = { { "verbose", 'v', "enable detailed output",
-    ClashTypeFlag, "", offsetof(RecordStartCmd, verbose) } };
+    ClashTypeFlag, "", offsetof(RecordStartCmd, verbose), 0, 0, 0 } };
 
 static ClashCommand recordCommands[] = {
     { "start", "start recording something", sizeof(struct RecordStartCmd), recordStartOptions,
-        sizeof(recordStartOptions) / sizeof(recordStartOptions[0]), 0, 0, (ClashFn)onRecordStart },
+        sizeof(recordStartOptions) / sizeof(recordStartOptions[0]), 0, 0, (ClashFn)onRecordStart,
+        0 },
     { "stop", "stops the current recording", sizeof(struct RecordStopCmd), recordStopOptions,
-        sizeof(recordStopOptions) / sizeof(recordStopOptions[0]), 0, 0, (ClashFn)onRecordStop }
+        sizeof(recordStopOptions) / sizeof(recordStopOptions[0]), 0, 0, (ClashFn)onRecordStop, 0 }
 };
 
 static ClashCommand mainCommands[] = { { "record", "recording commands", 0, 0, 0, recordCommands,
-    sizeof(recordCommands) / sizeof(recordCommands[0]), 0 } };
+    sizeof(recordCommands) / sizeof(recordCommands[0]), 0, 0 } };
 
 static ClashDefinition definition
-    = { mainCommands, sizeof(mainCommands) / sizeof(mainCommands[0]) };
+    = { mainCommands, sizeof(mainCommands) / sizeof(mainCommands[0]), 0, 0 };
 
 int main(int argc, const char* argv[])
 {
@@ -80,6 +81,7 @@ int main(int argc, const char* argv[])
     }
 
     ClashDefinition* def = &definition;
+    clashDefinitionCompile(def);
 
     char usageBuf[512];
     printf("usage:\n%s\n", clashUsage(def, usageBuf, 512));
@@ -101,5 +103,7 @@ int main(int argc, const char* argv[])
     printf("response:\n%s", tempResponse);
     printf("errorCode:%d\n", errorCode);
 
+    clashDefinitionDestroy(def);
+
     return errorCode;
 }
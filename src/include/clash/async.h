@@ -0,0 +1,70 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CLASH_ASYNC_H
+#define CLASH_ASYNC_H
+
+#include <clash/parse_error.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct ClashDefinition;
+struct FldOutStream;
+
+#define CLASH_ASYNC_QUEUED (1)
+#define CLASH_ASYNC_QUEUE_FULL (-11)
+
+#define CLASH_ASYNC_CACHE_LINE_OCTETS (64)
+
+/// Called on the worker thread when a queued command has been executed.
+/// @param context the context given to clashAsyncParseString()
+/// @param responseStream the zero terminated response, only valid during the call
+typedef void (*ClashAsyncDoneFn)(void* context, struct FldOutStream* responseStream);
+
+typedef struct ClashAsyncCell {
+    uint64_t sequence;
+    void* item;
+} ClashAsyncCell;
+
+/// Bounded lock free queue of pointers, any number of threads can push and pop at the same time.
+/// Each cell has a sequence number that tells if it is free for the push or the pop at a position,
+/// so the only contended writes are to the two positions, which are on separate cache lines.
+typedef struct ClashAsyncRing {
+    ClashAsyncCell* cells;
+    size_t mask;
+    uint8_t enqueuePadding[CLASH_ASYNC_CACHE_LINE_OCTETS];
+    uint64_t enqueuePosition;
+    uint8_t dequeuePadding[CLASH_ASYNC_CACHE_LINE_OCTETS - sizeof(uint64_t)];
+    uint64_t dequeuePosition;
+    uint8_t endPadding[CLASH_ASYNC_CACHE_LINE_OCTETS - sizeof(uint64_t)];
+} ClashAsyncRing;
+
+/// Executes the commands flagged with ClashCommandFlagAsync on worker threads. Parsing and
+/// converting stays on the calling thread, the converted struct and the ClashFn are queued and any
+/// thread that calls clashAsyncExecuteNext() runs them. All job memory is allocated at init, each
+/// job has room for one line, its converted struct and its response.
+/// rejectedCount is the number of async commands that were refused because the queue was full.
+typedef struct ClashAsync {
+    const struct ClashDefinition* definition;
+    ClashAsyncRing pending;
+    ClashAsyncRing free;
+    uint8_t* jobMemory;
+    size_t jobOctetCount;
+    size_t maxLineLength;
+    size_t responseOctetCount;
+    ClashAsyncDoneFn done;
+    uint64_t rejectedCount;
+} ClashAsync;
+
+int clashAsyncInit(ClashAsync* self, const struct ClashDefinition* definition,
+    size_t maxQueuedCount, size_t maxLineLength, size_t responseOctetCount, ClashAsyncDoneFn done);
+void clashAsyncDestroy(ClashAsync* self);
+int clashAsyncParseString(ClashAsync* self, const char* s, void* userData, void* context,
+    struct FldOutStream* responseStream, ClashParseError* error);
+int clashAsyncBinaryExecute(ClashAsync* self, const uint8_t* octets, size_t octetCount,
+    void* userData, void* context, struct FldOutStream* responseStream, ClashParseError* error);
+int clashAsyncExecuteNext(ClashAsync* self);
+size_t clashAsyncPendingCount(const ClashAsync* self);
+
+#endif
@@ -0,0 +1,26 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CLASH_BATCH_H
+#define CLASH_BATCH_H
+
+#include <clash/parse_error.h>
+#include <stddef.h>
+
+struct ClashDefinition;
+struct ClashScratch;
+struct FldOutStream;
+
+typedef struct ClashBatchLineResult {
+    int errorCode;
+    size_t lineOffset;
+    size_t responseOffset;
+    ClashParseError error;
+} ClashBatchLineResult;
+
+int clashExecuteBatch(const struct ClashDefinition* definition, const char* buffer, size_t length,
+    void* userData, struct FldOutStream* responseStream, struct ClashScratch* scratch,
+    ClashBatchLineResult* results, size_t maxResults);
+
+#endif
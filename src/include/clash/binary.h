@@ -0,0 +1,32 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CLASH_BINARY_H
+#define CLASH_BINARY_H
+
+#include <clash/parse_error.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct ClashCall;
+struct ClashCommand;
+struct ClashDefinition;
+struct ClashScratch;
+struct FldOutStream;
+
+#define CLASH_BINARY_VERSION (1)
+#define CLASH_BINARY_MALFORMED (-12)
+
+int clashBinaryEncodeCommand(const struct ClashDefinition* definition,
+    const struct ClashCommand* command, const void* structData, struct FldOutStream* outStream);
+int clashBinaryEncodeString(const struct ClashDefinition* definition, const char* line,
+    struct FldOutStream* outStream, struct ClashScratch* scratch, ClashParseError* error);
+int clashBinaryDecode(const struct ClashDefinition* definition, const uint8_t* octets,
+    size_t octetCount, struct ClashScratch* scratch, ClashParseError* error,
+    struct ClashCall* call, char** heapText);
+int clashBinaryExecute(const struct ClashDefinition* definition, const uint8_t* octets,
+    size_t octetCount, void* userData, struct FldOutStream* responseStream,
+    struct ClashScratch* scratch, ClashParseError* error);
+
+#endif
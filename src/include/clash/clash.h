@@ -5,20 +5,59 @@
 #ifndef CLASH_TYPES_H
 #define CLASH_TYPES_H
 
+#include <stdint.h>
 #include <stdlib.h>
 
+struct ClashHistory;
+struct ClashIndex;
+struct ClashParseCache;
+struct ClashParseError;
 struct ClashResponse;
+struct ClashResponseChunks;
+struct ClashScratch;
 struct FldOutStream;
 
+/// The stack memory clashParse(), clashParseString(), clashComplete() and commands that are not
+/// queued by clashAsyncParseString() use as scratch. They fall back to the heap when a definition
+/// and line need more. Set it to the parseScratchOctetCount of clashDefinitionStats() with the
+/// CLASH_PARSE_SCRATCH_OCTETS build option.
+#if !defined CLASH_PARSE_SCRATCH_OCTETS
+#define CLASH_PARSE_SCRATCH_OCTETS (1024)
+#endif
+
 typedef int ClashOptionType;
 
+typedef struct ClashStringView {
+    const char* str;
+    size_t length;
+} ClashStringView;
+
+/// The values of a ClashTypeList option, in the order they were given.
+typedef struct ClashStringList {
+    const ClashStringView* values;
+    size_t count;
+} ClashStringList;
+
 #define ClashTypeString (0x01)
 #define ClashTypeInt (0x02)
 #define ClashTypeFlag (0x03)
 #define ClashTypeUInt64 (0x04)
+#define ClashTypeInt64 (0x05)
+#define ClashTypeDouble (0x06)
+#define ClashTypeDuration (0x07)
+#define ClashTypeMask (0x07)
 #define ClashTypeArg (0x08)
 #define ClashTypeBool (0x10)
+#define ClashTypeView (0x20)
+#define ClashTypeList (0x40)
 
+/// An option or argument of a command.
+/// ClashTypeDuration values are stored as int64_t milliseconds. For the number types, a value
+/// outside minimum and maximum is a parse error, unless both are zero.
+/// choices is an optional NULL terminated list of the only values allowed for a string option,
+/// they are also offered by clashComplete().
+/// A ClashTypeString | ClashTypeList option can be given any number of times and is stored as a
+/// ClashStringList of views into the tokens. As a ClashTypeArg it takes all remaining arguments.
 typedef struct ClashOption {
     const char* name;
     const char shortName;
@@ -26,10 +65,19 @@ typedef struct ClashOption {
     ClashOptionType type;
     const char* value;
     size_t structOffset;
+    int64_t minimum;
+    int64_t maximum;
+    const char* const* choices;
 } ClashOption;
 
 typedef void (*ClashFn)(void* userData, const void* data, struct ClashResponse* response);
 
+#define ClashCommandFlagAsync (0x01)
+
+/// A command, either with sub commands or a leaf with options and a ClashFn.
+/// flags is a combination of the ClashCommandFlag values. A ClashCommandFlagAsync command is
+/// queued for a worker thread by clashAsyncParseString(), all other parse functions execute it
+/// directly.
 typedef struct ClashCommand {
     const char* name;
     const char* description;
@@ -39,22 +87,50 @@ typedef struct ClashCommand {
     const struct ClashCommand* subCommands;
     size_t subCommandsCount;
     ClashFn fn;
+    int flags;
 } ClashCommand;
 
+/// The command tree. It is only read while parsing, so after clashDefinitionCompile() has returned
+/// the same definition can be shared by any number of threads, as long as each thread uses its own
+/// ClashParser (or its own ClashScratch with the clashParse*Ex() functions) and response stream.
+/// clashDefinitionCompile() and clashDefinitionDestroy() must not run concurrently with parsing.
+/// The optional parse cache is the exception, see clashDefinitionEnableParseCache().
 typedef struct ClashDefinition {
-    struct ClashCommand* commands;
+    const struct ClashCommand* commands;
     size_t commandCount;
+    struct ClashIndex* index;
+    struct ClashParseCache* parseCache;
 } ClashDefinition;
 
+int clashDefinitionCompile(ClashDefinition* definition);
+void clashDefinitionDestroy(ClashDefinition* definition);
+int clashDefinitionEnableParseCache(ClashDefinition* definition, size_t maxOctetCount);
+int clashDefinitionSetHistory(ClashDefinition* definition, struct ClashHistory* history);
+
 int clashParse(const ClashDefinition* definition, const char** argv, int argc, void* userData,
     struct FldOutStream* responseStream);
+int clashParseEx(const ClashDefinition* definition, const char** argv, int argc, void* userData,
+    struct FldOutStream* responseStream, struct ClashScratch* scratch,
+    struct ClashParseError* error);
 int clashParseString(const ClashDefinition* definition, const char* s, void* userData,
     struct FldOutStream* responseStream);
+int clashParseStringEx(const ClashDefinition* definition, const char* s, void* userData,
+    struct FldOutStream* responseStream, struct ClashScratch* scratch,
+    struct ClashParseError* error);
+int clashParseStringChunked(const ClashDefinition* definition, const char* s, void* userData,
+    struct ClashResponseChunks* chunks, struct ClashScratch* scratch,
+    struct ClashParseError* error);
+size_t clashDefinitionScratchOctetCount(const ClashDefinition* definition);
+int clashDefinitionHasListOptions(const ClashDefinition* definition);
+size_t clashDefinitionListOctetCount(const ClashDefinition* definition, size_t maxValueCount);
 
 int clashSplitString(
     const char* s, char* buffer, size_t maxCount, const char** out, size_t arrayCount);
+int clashSplitStringViews(const char* s, size_t length, ClashStringView* out, size_t maxCount);
 
 const char* clashUsage(const ClashDefinition* definition, char* buf, size_t maxCount);
 void clashUsageToStream(const ClashDefinition* definition, struct FldOutStream* outStream);
+int clashUsageCommandToStream(const ClashDefinition* definition, const char** path,
+    size_t pathCount, struct FldOutStream* outStream);
 
 #endif
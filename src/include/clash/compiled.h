@@ -0,0 +1,27 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CLASH_COMPILED_H
+#define CLASH_COMPILED_H
+
+#include <clash/parse_error.h>
+
+struct ClashDefinition;
+struct ClashResponseChunks;
+struct FldOutStream;
+
+/// A command line that has been tokenized, looked up and converted once, so it can be executed any
+/// number of times without parsing it again.
+typedef struct ClashCompiledCommand ClashCompiledCommand;
+
+ClashCompiledCommand* clashCompileCommand(
+    const struct ClashDefinition* definition, const char* line, ClashParseError* error);
+int clashExecuteCompiled(
+    const ClashCompiledCommand* self, void* userData, struct FldOutStream* responseStream);
+int clashExecuteCompiledChunked(
+    const ClashCompiledCommand* self, void* userData, struct ClashResponseChunks* chunks);
+void clashCompiledCommandDestroy(ClashCompiledCommand* self);
+size_t clashCompiledCommandOctetCount(const ClashCompiledCommand* self);
+
+#endif
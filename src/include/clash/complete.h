@@ -0,0 +1,30 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CLASH_COMPLETE_H
+#define CLASH_COMPLETE_H
+
+#include <stddef.h>
+
+struct ClashDefinition;
+
+typedef enum ClashCompletionKind {
+    ClashCompletionKindCommand,
+    ClashCompletionKindLongOption,
+    ClashCompletionKindShortOption,
+    ClashCompletionKindChoice,
+} ClashCompletionKind;
+
+/// A candidate for the word at the cursor. text is a view into the definition, without the dashes
+/// of an option.
+typedef struct ClashCompletion {
+    ClashCompletionKind kind;
+    const char* text;
+    size_t length;
+} ClashCompletion;
+
+int clashComplete(const struct ClashDefinition* definition, const char* line, size_t cursor,
+    ClashCompletion* candidates, size_t maxCount, size_t* wordStart);
+
+#endif
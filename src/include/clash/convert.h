@@ -0,0 +1,36 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CLASH_CONVERT_H
+#define CLASH_CONVERT_H
+
+#include <clash/parse_error.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct ClashOption;
+
+#define CLASH_CONVERT_INVALID (-8)
+#define CLASH_CONVERT_OVERFLOW (-9)
+#define CLASH_CONVERT_OUT_OF_RANGE (-10)
+
+int clashConvertUInt64(const char* s, size_t length, uint64_t* out);
+int clashConvertInt64(const char* s, size_t length, int64_t* out);
+int clashConvertInt(const char* s, size_t length, int* out);
+int clashConvertDouble(const char* s, size_t length, double* out);
+int clashConvertDuration(const char* s, size_t length, int64_t* milliseconds);
+int clashConvertBool(const char* s, size_t length, bool* out);
+
+int clashConvertCheckRange(int64_t value, int64_t minimum, int64_t maximum);
+int clashConvertCheckRangeUInt64(uint64_t value, int64_t minimum, int64_t maximum);
+int clashConvertCheckRangeDouble(double value, int64_t minimum, int64_t maximum);
+int clashConvertCheckChoice(const char* const* choices, const char* s, size_t length);
+
+ClashParseErrorKind clashConvertErrorKind(int errorCode);
+const char* clashConvertTypeName(int type);
+const char* clashConvertExpectedValue(const struct ClashOption* option);
+int clashConvertIsNegativeNumber(int type, const char* s, size_t length);
+
+#endif
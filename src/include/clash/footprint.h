@@ -0,0 +1,41 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CLASH_FOOTPRINT_H
+#define CLASH_FOOTPRINT_H
+
+#include <stddef.h>
+
+struct ClashDefinition;
+struct FldOutStream;
+
+/// The memory a definition takes and the most that parsing a line of it needs.
+/// maxDepth is one for a definition without sub commands. stringOctetCount has the names,
+/// descriptions, defaults and choices with their terminators, a string used twice is counted
+/// twice. tableOctetCount is the ClashCommand, ClashOption and choice arrays. indexOctetCount and
+/// parseCacheOctetCount are the heap of clashDefinitionCompile() and of the parse cache, zero if
+/// not used. parseScratchOctetCount is the scratch clashParseString() needs for the longest line,
+/// parseStackOctetCount the buffer and structs it keeps on the stack (not the call frames) and
+/// parseHeapOctetCount what it allocates when the scratch does not fit the stack buffer.
+typedef struct ClashDefinitionStats {
+    size_t commandCount;
+    size_t optionCount;
+    size_t maxDepth;
+    size_t maxOptionCount;
+    size_t maxStructSize;
+    size_t stringOctetCount;
+    size_t tableOctetCount;
+    size_t indexOctetCount;
+    size_t parseCacheOctetCount;
+    size_t parseScratchOctetCount;
+    size_t parseStackOctetCount;
+    size_t parseHeapOctetCount;
+} ClashDefinitionStats;
+
+int clashDefinitionStats(
+    const struct ClashDefinition* definition, size_t maxLineLength, ClashDefinitionStats* stats);
+int clashDefinitionStatsToStream(
+    const ClashDefinitionStats* stats, struct FldOutStream* outStream);
+
+#endif
@@ -0,0 +1,88 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CLASH_HISTORY_H
+#define CLASH_HISTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct ClashDefinition;
+struct ClashScratch;
+struct FldOutStream;
+
+#define CLASH_HISTORY_MAGIC (0x48534c43)
+#define CLASH_HISTORY_VERSION (1)
+#define CLASH_HISTORY_ALIGNMENT (8)
+#define CLASH_HISTORY_MALFORMED (-13)
+
+/// The start of a history file. appendOffset is the number of entry octets reserved so far, it
+/// passes capacity once appends are dropped. All values are stored in native byte order.
+typedef struct ClashHistoryHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+    uint64_t appendOffset;
+    uint64_t droppedCount;
+} ClashHistoryHeader;
+
+/// A recorded command, followed by argc zero terminated arguments and padding up to
+/// CLASH_HISTORY_ALIGNMENT. octetCount is the size of the whole entry and stays zero until the
+/// entry has been completely written. nodeIndex is the index of the command in the compiled
+/// definition and timestamp is nanoseconds since the Unix epoch.
+typedef struct ClashHistoryEntry {
+    uint32_t octetCount;
+    uint32_t nodeIndex;
+    uint64_t timestamp;
+    uint32_t argc;
+    uint32_t argOctetCount;
+} ClashHistoryEntry;
+
+/// An append only log of executed commands in a memory mapped file. Any number of threads can
+/// append at the same time: space is reserved with an atomic add on appendOffset and the entry is
+/// published by storing its octetCount, so an append is a copy into the mapping that never waits
+/// for the disk. Appends that do not fit in the capacity are dropped and counted.
+typedef struct ClashHistory {
+    int fileDescriptor;
+    uint8_t* mapping;
+    size_t mappingOctetCount;
+    ClashHistoryHeader* header;
+    uint8_t* entries;
+    int isWritable;
+} ClashHistory;
+
+/// A decoded entry. args points into the mapping, argc zero terminated strings after each other.
+typedef struct ClashHistoryRecord {
+    uint64_t timestamp;
+    uint32_t nodeIndex;
+    size_t argc;
+    const char* args;
+    size_t argOctetCount;
+} ClashHistoryRecord;
+
+typedef struct ClashHistoryReplayResult {
+    size_t commandCount;
+    size_t failedCount;
+    uint64_t firstTimestamp;
+    uint64_t lastTimestamp;
+} ClashHistoryReplayResult;
+
+int clashHistoryCreate(ClashHistory* self, const char* path, size_t capacity);
+int clashHistoryOpen(ClashHistory* self, const char* path);
+void clashHistoryClose(ClashHistory* self);
+uint64_t clashHistoryDroppedCount(const ClashHistory* self);
+
+int clashHistoryAppend(ClashHistory* self, size_t nodeIndex, const char** argv, int argc);
+int clashHistoryAppendLine(
+    ClashHistory* self, size_t nodeIndex, const char* start, const char* end);
+int clashHistoryAppendTokens(ClashHistory* self, size_t nodeIndex, const char* tokens,
+    size_t octetCount, size_t tokenCount);
+
+int clashHistoryNext(const ClashHistory* self, size_t* offset, ClashHistoryRecord* record);
+int clashHistoryRecordArgv(const ClashHistoryRecord* record, const char** argv, size_t maxCount);
+int clashHistoryReplay(const struct ClashDefinition* definition, const ClashHistory* history,
+    void* userData, struct FldOutStream* responseStream, struct ClashScratch* scratch,
+    ClashHistoryReplayResult* result);
+
+#endif
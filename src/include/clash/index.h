@@ -0,0 +1,121 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CLASH_INDEX_H
+#define CLASH_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct ClashCommand;
+struct ClashHistory;
+struct ClashStats;
+struct ClashDefinition;
+
+#define CLASH_INDEX_ROOT (0)
+#define CLASH_INDEX_SHORT_OPTION_COUNT (256)
+#define CLASH_INDEX_CACHE_LINE_OCTETS (64)
+
+/// The part of a node that is read while matching tokens, 32 octets so two nodes share a cache
+/// line. There is a node for each command, in breadth first order. Node zero is the root (the
+/// definition itself). The children of a node are always stored next to each other from
+/// childStart, and its options from optionStart. A slot mask of zero means that the node has no
+/// children or no options.
+typedef struct ClashIndexNode {
+    uint32_t childStart;
+    uint32_t childCount;
+    uint32_t childSlotStart;
+    uint32_t childSlotMask;
+    uint32_t optionStart;
+    uint32_t optionSlotStart;
+    uint32_t optionSlotMask;
+    uint32_t shortOptionStart;
+} ClashIndexNode;
+
+/// The part of a node that is only needed once its command has been matched.
+/// usageStart and usageEnd is the slice of the pre-rendered usage text that describes the node.
+typedef struct ClashIndexNodeInfo {
+    const struct ClashCommand* command;
+    size_t usageStart;
+    size_t usageEnd;
+} ClashIndexNodeInfo;
+
+/// An open addressing hash table entry. value is the node index or the option index plus one, zero
+/// for an empty slot. The hash is kept in the slot, so a probe only reads the name on a match.
+typedef struct ClashIndexSlot {
+    uint32_t hash;
+    uint32_t value;
+} ClashIndexSlot;
+
+/// A command or option name copied into the names block of the index.
+typedef struct ClashIndexNameSpan {
+    uint32_t offset;
+    uint32_t length;
+} ClashIndexNameSpan;
+
+/// A name in a list that is sorted per node, so all names with the same prefix, or the same length,
+/// are next to each other. value is the node index for sub commands and the option index for
+/// options. characterMask is the clashSuggestCharacterMask() of the name.
+typedef struct ClashIndexName {
+    const char* name;
+    size_t length;
+    uint32_t value;
+    uint64_t characterMask;
+} ClashIndexName;
+
+/// Immutable lookup tables built once from a definition.
+/// Every command level gets an open addressing hash table for its sub commands and long option
+/// names, and every command with options gets a table indexed directly by the short option
+/// character. Everything the matcher reads (nodes, slots, name spans, short options and the
+/// names themselves) is stored as arrays in one allocation, hotMemory, so a lookup only touches
+/// the node, a slot and the name, and never the ClashCommand and ClashOption tables.
+/// The rest is cold: nodeInfos, and for completion, the sub command and option names of each node
+/// sorted in the same ranges as the nodes (childStart) and the options (optionStart). For
+/// suggestions, the same names are sorted by length in the same ranges.
+/// stats has counters for each node when built with CLASH_STATS, otherwise it is NULL.
+/// history is the optional log that executed commands are appended to, see
+/// clashDefinitionSetHistory(). heapOctetCount is the size of all the allocations of the index.
+typedef struct ClashIndex {
+    uint8_t* hotMemory;
+    ClashIndexNode* nodes;
+    size_t nodeCount;
+    ClashIndexSlot* childSlots;
+    size_t childSlotCount;
+    ClashIndexNameSpan* childNames;
+    ClashIndexSlot* optionSlots;
+    size_t optionSlotCount;
+    ClashIndexNameSpan* optionNames;
+    size_t optionCount;
+    uint16_t* shortOptions;
+    size_t shortOptionCount;
+    char* names;
+    size_t namesOctetCount;
+    ClashIndexNodeInfo* nodeInfos;
+    ClashIndexName* sortedChildNames;
+    ClashIndexName* sortedOptionNames;
+    ClashIndexName* childNamesByLength;
+    ClashIndexName* optionNamesByLength;
+    struct ClashStats* stats;
+    struct ClashHistory* history;
+    size_t scratchOctetCount;
+    int hasListOptions;
+    char* usage;
+    size_t usageOctetCount;
+    size_t heapOctetCount;
+} ClashIndex;
+
+int clashIndexInit(ClashIndex* self, const struct ClashDefinition* definition);
+void clashIndexDestroy(ClashIndex* self);
+
+uint32_t clashIndexHash(const char* s, size_t length);
+int clashIndexFindChild(const ClashIndex* self, size_t nodeIndex, const char* name, size_t length);
+int clashIndexFindNameOption(
+    const ClashIndex* self, size_t nodeIndex, const char* name, size_t length);
+int clashIndexFindShortOption(const ClashIndex* self, size_t nodeIndex, char shortName);
+size_t clashIndexFindPrefix(const ClashIndexName* names, size_t count, const char* prefix,
+    size_t length, size_t* first);
+size_t clashIndexFindLengthRange(const ClashIndexName* names, size_t count, size_t minimumLength,
+    size_t maximumLength, size_t* first);
+
+#endif
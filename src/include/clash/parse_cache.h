@@ -0,0 +1,50 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CLASH_PARSE_CACHE_H
+#define CLASH_PARSE_CACHE_H
+
+#include <clash/parse_error.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct ClashCompiledCommand;
+struct ClashDefinition;
+struct FldOutStream;
+
+typedef struct ClashParseCacheEntry {
+    uint32_t hash;
+    size_t lineLength;
+    const char* line;
+    struct ClashCompiledCommand* compiled;
+    size_t octetCount;
+    struct ClashParseCacheEntry* nextInBucket;
+    struct ClashParseCacheEntry* moreRecent;
+    struct ClashParseCacheEntry* lessRecent;
+} ClashParseCacheEntry;
+
+/// Remembers the compiled command for recently parsed command lines, so a repeated line is
+/// executed without tokenizing, lookup or conversion. When the entries use more than
+/// maxOctetCount, the least recently used ones are evicted. Lines that fail to parse are not
+/// cached. The cache is not thread safe.
+typedef struct ClashParseCache {
+    ClashParseCacheEntry** buckets;
+    size_t bucketMask;
+    ClashParseCacheEntry* mostRecent;
+    ClashParseCacheEntry* leastRecent;
+    size_t entryCount;
+    size_t octetCount;
+    size_t maxOctetCount;
+    uint64_t hitCount;
+    uint64_t missCount;
+    uint64_t evictionCount;
+} ClashParseCache;
+
+int clashParseCacheInit(ClashParseCache* self, size_t maxOctetCount);
+void clashParseCacheDestroy(ClashParseCache* self);
+void clashParseCacheClear(ClashParseCache* self);
+int clashParseCacheExecute(ClashParseCache* self, const struct ClashDefinition* definition,
+    const char* s, void* userData, struct FldOutStream* responseStream, ClashParseError* error);
+
+#endif
@@ -0,0 +1,55 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CLASH_PARSE_ERROR_H
+#define CLASH_PARSE_ERROR_H
+
+#include <stddef.h>
+
+struct FldOutStream;
+
+typedef enum ClashParseErrorKind {
+    ClashParseErrorKindNone,
+    ClashParseErrorKindNullArgument,
+    ClashParseErrorKindUnknownCommand,
+    ClashParseErrorKindUnknownSubCommand,
+    ClashParseErrorKindNoSubCommands,
+    ClashParseErrorKindNoCommand,
+    ClashParseErrorKindUnknownOption,
+    ClashParseErrorKindUnknownShortOption,
+    ClashParseErrorKindExpectedOptionValue,
+    ClashParseErrorKindTooManyArguments,
+    ClashParseErrorKindNotAnArgument,
+    ClashParseErrorKindScratchExhausted,
+    ClashParseErrorKindUnterminatedQuote,
+    ClashParseErrorKindTooManyTokens,
+    ClashParseErrorKindInvalidValue,
+    ClashParseErrorKindValueOverflow,
+    ClashParseErrorKindValueOutOfRange,
+    ClashParseErrorKindQueueFull,
+    ClashParseErrorKindMalformedBinary,
+} ClashParseErrorKind;
+
+/// Describes why a parse failed. Filled in by the parser, but never written anywhere
+/// unless the caller asks for it with clashParseErrorToStream().
+/// suggestion is the closest known name for an unknown command, sub command or option, or NULL.
+typedef struct ClashParseError {
+    ClashParseErrorKind kind;
+    int code;
+    size_t tokenIndex;
+    size_t octetOffset;
+    const char* expected;
+    const char* found;
+    size_t foundLength;
+    const char* suggestion;
+} ClashParseError;
+
+void clashParseErrorClear(ClashParseError* self);
+int clashParseErrorSet(ClashParseError* self, ClashParseErrorKind kind, int code,
+    const char* expected, size_t tokenIndex, const char* found, size_t foundLength,
+    size_t octetOffset);
+const char* clashParseErrorKindToString(ClashParseErrorKind kind);
+int clashParseErrorToStream(const ClashParseError* self, struct FldOutStream* outStream);
+
+#endif
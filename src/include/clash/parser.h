@@ -0,0 +1,29 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CLASH_PARSER_H
+#define CLASH_PARSER_H
+
+#include <clash/parse_error.h>
+#include <clash/scratch.h>
+
+struct ClashDefinition;
+struct FldOutStream;
+
+/// Everything that is mutated during a parse. Create one parser per thread (or per connection),
+/// they can all share the same immutable ClashDefinition.
+typedef struct ClashParser {
+    const struct ClashDefinition* definition;
+    ClashScratch scratch;
+    ClashParseError error;
+} ClashParser;
+
+void clashParserInit(ClashParser* self, const struct ClashDefinition* definition, uint8_t* memory,
+    size_t octetCount);
+int clashParserParse(ClashParser* self, const char** argv, int argc, void* userData,
+    struct FldOutStream* responseStream);
+int clashParserParseString(
+    ClashParser* self, const char* s, void* userData, struct FldOutStream* responseStream);
+
+#endif
@@ -7,11 +7,19 @@
 
 #include <tinge/tinge.h>
 
+struct ClashResponseChunks;
+
+/// The output of a ClashFn. It is either a fixed FldOutStream or, if chunks is set, a chain of
+/// pooled chunks that grows as needed. outStream always points at the stream that is written to,
+/// but only the clashResponse functions start a new chunk when the current one is full.
 typedef struct ClashResponse {
     struct FldOutStream* outStream;
     TingeState tintState;
+    struct ClashResponseChunks* chunks;
 } ClashResponse;
 
+void clashResponseInit(ClashResponse* self, struct FldOutStream* outStream);
+void clashResponseInitChunks(ClashResponse* self, struct ClashResponseChunks* chunks);
 void clashResponseSetColor(ClashResponse* self, uint8_t colorIndex);
 void clashResponseResetColor(ClashResponse* self);
 int clashResponseWritef(ClashResponse* self, const char* fmt, ...);
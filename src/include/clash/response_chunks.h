@@ -0,0 +1,60 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CLASH_RESPONSE_CHUNKS_H
+#define CLASH_RESPONSE_CHUNKS_H
+
+#include <flood/out_stream.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if !defined _WIN32
+#include <sys/uio.h>
+#endif
+
+typedef struct ClashResponseChunk {
+    struct ClashResponseChunk* next;
+    size_t octetCount;
+    uint8_t octets[];
+} ClashResponseChunk;
+
+/// Recycles response chunks of one size. It is not thread safe, use one pool for each thread.
+/// maxChunkCount limits how many chunks are allocated in total, zero means no limit.
+typedef struct ClashResponseChunkPool {
+    ClashResponseChunk* freeChunks;
+    size_t chunkOctetCount;
+    size_t chunkCount;
+    size_t maxChunkCount;
+} ClashResponseChunkPool;
+
+/// A response that grows one pooled chunk at a time, so large responses are neither truncated
+/// nor need a buffer sized for the worst case. stream writes into the last chunk, the first
+/// firstOffset octets of the first chunk have already been consumed.
+typedef struct ClashResponseChunks {
+    ClashResponseChunkPool* pool;
+    ClashResponseChunk* first;
+    ClashResponseChunk* last;
+    size_t firstOffset;
+    FldOutStream stream;
+} ClashResponseChunks;
+
+void clashResponseChunkPoolInit(
+    ClashResponseChunkPool* self, size_t chunkOctetCount, size_t maxChunkCount);
+void clashResponseChunkPoolDestroy(ClashResponseChunkPool* self);
+
+void clashResponseChunksInit(ClashResponseChunks* self, ClashResponseChunkPool* pool);
+void clashResponseChunksClear(ClashResponseChunks* self);
+int clashResponseChunksReserve(ClashResponseChunks* self, size_t octetCount);
+int clashResponseChunksWrite(ClashResponseChunks* self, const uint8_t* octets, size_t octetCount);
+int clashResponseChunksWritevf(ClashResponseChunks* self, const char* fmt, va_list pl);
+size_t clashResponseChunksOctetCount(const ClashResponseChunks* self);
+void clashResponseChunksConsume(ClashResponseChunks* self, size_t octetCount);
+
+#if !defined _WIN32
+int clashResponseChunksToIoVectors(
+    const ClashResponseChunks* self, struct iovec* vectors, size_t maxCount);
+#endif
+
+#endif
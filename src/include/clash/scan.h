@@ -0,0 +1,18 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CLASH_SCAN_H
+#define CLASH_SCAN_H
+
+const char* clashScanSkipWhitespace(const char* p, const char* end);
+const char* clashScanToWhitespace(const char* p, const char* end);
+const char* clashScanToQuotation(const char* p, const char* end);
+
+const char* clashScanSkipWhitespaceScalar(const char* p, const char* end);
+const char* clashScanToWhitespaceScalar(const char* p, const char* end);
+const char* clashScanToQuotationScalar(const char* p, const char* end);
+
+const char* clashScanImplementationName(void);
+
+#endif
@@ -0,0 +1,28 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CLASH_SCRATCH_H
+#define CLASH_SCRATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CLASH_SCRATCH_ALIGNMENT (8)
+
+/// Bump allocator over caller owned memory. Nothing is freed individually,
+/// the parser rewinds it to where it was when the parse started.
+typedef struct ClashScratch {
+    uint8_t* memory;
+    size_t capacity;
+    size_t pos;
+} ClashScratch;
+
+void clashScratchInit(ClashScratch* self, uint8_t* memory, size_t capacity);
+void* clashScratchAlloc(ClashScratch* self, size_t octetCount);
+void* clashScratchAllocOctets(ClashScratch* self, size_t octetCount);
+void* clashScratchGrow(ClashScratch* self, void* p, size_t octetCount, size_t newOctetCount);
+const char* clashScratchCopyString(ClashScratch* self, const char* s, size_t length);
+void clashScratchRewind(ClashScratch* self, size_t pos);
+
+#endif
@@ -0,0 +1,112 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CLASH_STATE_H
+#define CLASH_STATE_H
+
+#include <clash/parse_error.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct ClashCommand;
+struct ClashDefinition;
+struct ClashIndex;
+struct ClashOption;
+struct ClashResponse;
+struct ClashScratch;
+struct ClashStringView;
+struct FldOutStream;
+
+/// The value of an option while parsing. A ClashTypeList option also keeps every value in list,
+/// which has room for listCapacity views.
+typedef struct ClashStructValue {
+    const char* value;
+    size_t length;
+    int count;
+    int isTerminated;
+    size_t tokenIndex;
+    struct ClashStringView* list;
+    size_t listCapacity;
+} ClashStructValue;
+
+typedef struct ClashStructValues {
+    ClashStructValue* values;
+    size_t count;
+} ClashStructValues;
+
+/// The text of a command for the history, in one of the forms it can append: a line (lineStart is
+/// set), an argv array (argv is set) or zero terminated tokens after each other (tokens is set).
+/// Everything is NULL if there is no text to record.
+typedef struct ClashCallText {
+    const char* lineStart;
+    const char* lineEnd;
+    const char** argv;
+    int argc;
+    const char* tokens;
+    size_t tokensOctetCount;
+    size_t tokenCount;
+} ClashCallText;
+
+/// A selected command with its converted struct, ready for clashCall(). Every way of executing a
+/// command goes through clashCall(), so they all count the same stats and record the same history.
+/// index is NULL if the definition is not compiled. statsStartTime is as in ClashState. A call
+/// that isParsedEarlier (compiled, cached, binary or queued) decides itself if it is sampled, and
+/// only its callback time is added to the CLASH_STATS histograms.
+typedef struct ClashCall {
+    const struct ClashIndex* index;
+    size_t nodeIndex;
+    const struct ClashCommand* command;
+    const void* structData;
+    uint64_t statsStartTime;
+    int isParsedEarlier;
+    ClashCallText text;
+} ClashCall;
+
+/// Every fed token is followed by a zero terminator, so strings can be passed on without copying.
+#define ClashStateFlagTerminatedTokens (0x01)
+/// The state only follows a partial line for clashComplete(). Its errors are expected, so they are
+/// not counted in the CLASH_STATS histograms and no suggestion is searched for.
+#define ClashStateFlagCompleting (0x02)
+
+/// The parse state for one command line. Tokens are fed one at a time, so the same state machine
+/// is used for argv arrays, in place tokenized buffers and anything else that produces tokens.
+/// statsStartTime is the clashStatsTicks() when the first token was fed, if the parse is sampled
+/// for the CLASH_STATS histograms. text is what the command is recorded to the history with, the
+/// line given to clashStateFeedLine() or whatever the caller sets before dispatching.
+typedef struct ClashState {
+    const struct ClashDefinition* definition;
+    const struct ClashIndex* index;
+    size_t nodeIndex;
+    const struct ClashCommand* command;
+    const struct ClashOption* nameOption;
+    int nameOptionIndex;
+    ClashStructValues values;
+    int argIndex;
+    struct ClashScratch* scratch;
+    size_t scratchMark;
+    int flags;
+    size_t tokenIndex;
+    const char* token;
+    size_t tokenLength;
+    ClashParseError error;
+    uint64_t statsStartTime;
+    ClashCallText text;
+} ClashState;
+
+void clashStateInit(ClashState* self, const struct ClashDefinition* definition,
+    struct ClashScratch* scratch, int flags);
+void clashStateReset(ClashState* self);
+int clashStateFeed(ClashState* self, const char* token, size_t length);
+int clashStateFeedLine(ClashState* self, const char* start, const char* end);
+int clashStateConvert(ClashState* self, void** structData);
+int clashStateConvertValue(const struct ClashOption* option, const ClashStructValue* item,
+    void* p, struct ClashScratch* scratch);
+int clashStateDispatch(ClashState* self, void* userData, struct FldOutStream* responseStream);
+int clashStateDispatchResponse(ClashState* self, void* userData, struct ClashResponse* response);
+void clashCallResponse(const ClashCall* self, void* userData, struct ClashResponse* response);
+void clashCall(const ClashCall* self, void* userData, struct FldOutStream* responseStream);
+int clashStateError(ClashState* self, ClashParseErrorKind kind, int code, const char* expected,
+    size_t octetOffset);
+
+#endif
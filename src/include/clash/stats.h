@@ -0,0 +1,60 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CLASH_STATS_H
+#define CLASH_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct ClashDefinition;
+struct FldOutStream;
+
+#define CLASH_STATS_BUCKET_COUNT (40)
+#define CLASH_STATS_ERROR_CODE_COUNT (16)
+
+/// Only one in this many parses is timed, must be a power of two. The counters count every parse.
+#if !defined CLASH_STATS_SAMPLE_INTERVAL
+#define CLASH_STATS_SAMPLE_INTERVAL (16)
+#endif
+
+/// Counters for one command, only collected when the library is built with CLASH_STATS.
+/// Durations of the sampled parses are measured in ticks of clashStatsTicks(). Bucket i of a
+/// histogram counts the durations from 2^i up to, but not including, 2^(i+1) ticks (bucket zero
+/// also counts zero). errorCounts[i] counts error code -(i + 1).
+typedef struct ClashCommandStats {
+    uint64_t invocationCount;
+    uint64_t errorCounts[CLASH_STATS_ERROR_CODE_COUNT];
+    uint64_t parseTicks[CLASH_STATS_BUCKET_COUNT];
+    uint64_t callbackTicks[CLASH_STATS_BUCKET_COUNT];
+} ClashCommandStats;
+
+/// The stats of every node of a compiled definition. All counters are updated with relaxed atomic
+/// adds, so parsing from several threads is fine. The start time is used to find out how long a
+/// tick is when the stats are dumped. parseCount decides which parses are sampled.
+typedef struct ClashStats {
+    ClashCommandStats* commands;
+    size_t commandCount;
+    uint64_t startTicks;
+    uint64_t startNanoseconds;
+    uint64_t parseCount;
+} ClashStats;
+
+int clashStatsInit(ClashStats* self, size_t commandCount);
+void clashStatsDestroy(ClashStats* self);
+void clashStatsClear(struct ClashDefinition* definition);
+
+uint64_t clashStatsTicks(void);
+uint64_t clashStatsNanoseconds(void);
+size_t clashStatsBucket(uint64_t ticks);
+uint64_t clashStatsParseStarted(ClashStats* self);
+void clashStatsRecordError(ClashCommandStats* self, int code);
+void clashStatsRecordInvocation(ClashCommandStats* self);
+void clashStatsRecordDurations(
+    ClashCommandStats* self, uint64_t parseTicks, uint64_t callbackTicks);
+void clashStatsRecordCallbackDuration(ClashCommandStats* self, uint64_t callbackTicks);
+
+int clashStatsDump(const struct ClashDefinition* definition, struct FldOutStream* outStream);
+
+#endif
@@ -0,0 +1,51 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CLASH_STREAM_H
+#define CLASH_STREAM_H
+
+#include <clash/parse_error.h>
+#include <clash/scratch.h>
+#include <clash/state.h>
+
+struct ClashDefinition;
+struct FldOutStream;
+
+/// Called when a line has been executed or has failed.
+/// @param userData the user data given to clashStreamParserInit()
+/// @param errorCode negative if the line failed
+/// @param error details of the failure, only valid during the call
+typedef void (*ClashStreamLineFn)(void* userData, int errorCode, const ClashParseError* error);
+
+typedef enum ClashStreamMode {
+    ClashStreamModeBetweenTokens,
+    ClashStreamModeToken,
+    ClashStreamModeQuotedToken,
+    ClashStreamModeSkipLine
+} ClashStreamMode;
+
+/// Push parser for input that arrives in arbitrary fragments, e.g. from a socket. The tokenizer and
+/// the command state are kept between calls and a command is executed as soon as its line
+/// terminator arrives. Only the token characters are copied, into the fixed memory given at init,
+/// which is rewound after every line. The parser must not be moved after it has been initialized.
+typedef struct ClashStreamParser {
+    ClashState state;
+    ClashScratch scratch;
+    ClashScratch tokens;
+    ClashStreamMode mode;
+    size_t tokenStart;
+    size_t lineTokenCount;
+    int hasPendingCarriageReturn;
+    void* userData;
+    struct FldOutStream* responseStream;
+    ClashStreamLineFn lineDone;
+} ClashStreamParser;
+
+void clashStreamParserInit(ClashStreamParser* self, const struct ClashDefinition* definition,
+    uint8_t* memory, size_t octetCount, void* userData, struct FldOutStream* responseStream,
+    ClashStreamLineFn lineDone);
+int clashStreamFeed(ClashStreamParser* self, const char* octets, size_t octetCount);
+int clashStreamEnd(ClashStreamParser* self);
+
+#endif
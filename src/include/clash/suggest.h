@@ -0,0 +1,25 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CLASH_SUGGEST_H
+#define CLASH_SUGGEST_H
+
+#include <clash/parse_error.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct ClashState;
+
+/// Names and words longer than this are never suggested, it also bounds the distance rows.
+#define CLASH_SUGGEST_MAX_LENGTH (64)
+
+size_t clashSuggestMaxDistance(size_t length);
+uint64_t clashSuggestCharacterMask(const char* s, size_t length);
+size_t clashSuggestMinDistance(uint64_t maskA, uint64_t maskB);
+size_t clashSuggestDistance(
+    const char* a, size_t aLength, const char* b, size_t bLength, size_t maxDistance);
+const char* clashSuggestName(
+    const struct ClashState* state, ClashParseErrorKind kind, const char* word, size_t length);
+
+#endif
@@ -0,0 +1,12 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CLASH_TOKENIZER_H
+#define CLASH_TOKENIZER_H
+
+#include <clash/clash.h>
+
+int clashTokenizerNext(const char** cursor, const char* end, ClashStringView* token);
+
+#endif
@@ -0,0 +1,13 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CLASH_USAGE_H
+#define CLASH_USAGE_H
+
+struct ClashDefinition;
+struct ClashIndex;
+
+int clashUsageRender(struct ClashIndex* index, const struct ClashDefinition* definition);
+
+#endif
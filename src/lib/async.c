@@ -0,0 +1,451 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clash/async.h>
+#include <clash/binary.h>
+#include <clash/clash.h>
+#include <clash/scratch.h>
+#include <clash/state.h>
+#include <flood/out_stream.h>
+#include <tiny-libc/tiny_libc.h>
+
+#if defined _MSC_VER
+#include <intrin.h>
+#endif
+
+#if !defined CLASH_ASYNC_SCRATCH_OCTETS
+#define CLASH_ASYNC_SCRATCH_OCTETS CLASH_PARSE_SCRATCH_OCTETS
+#endif
+
+/// A queued command. The line, the values and the converted struct live in the scratch after the
+/// header, followed by the response memory.
+typedef struct ClashAsyncJob {
+    ClashCall call;
+    char* heapText;
+    void* userData;
+    void* context;
+    ClashScratch scratch;
+    uint8_t* responseMemory;
+} ClashAsyncJob;
+
+static uint64_t loadRelaxed(const uint64_t* value)
+{
+#if defined _MSC_VER
+    return *(const volatile uint64_t*)value;
+#else
+    return __atomic_load_n(value, __ATOMIC_RELAXED);
+#endif
+}
+
+static uint64_t loadAcquire(uint64_t* value)
+{
+#if defined _MSC_VER
+    return (uint64_t)_InterlockedOr64((volatile __int64*)value, 0);
+#else
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static void storeRelease(uint64_t* target, uint64_t value)
+{
+#if defined _MSC_VER
+    _InterlockedExchange64((volatile __int64*)target, (__int64)value);
+#else
+    __atomic_store_n(target, value, __ATOMIC_RELEASE);
+#endif
+}
+
+/// Sets target to desired if it still is expected, otherwise expected receives the current value.
+static int compareExchange(uint64_t* target, uint64_t* expected, uint64_t desired)
+{
+#if defined _MSC_VER
+    uint64_t previous = (uint64_t)_InterlockedCompareExchange64(
+        (volatile __int64*)target, (__int64)desired, (__int64)*expected);
+    if (previous == *expected) {
+        return 1;
+    }
+    *expected = previous;
+    return 0;
+#else
+    return __atomic_compare_exchange_n(
+        target, expected, desired, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+#endif
+}
+
+static void addRelaxed(uint64_t* counter, uint64_t value)
+{
+#if defined _MSC_VER
+    _InterlockedExchangeAdd64((volatile __int64*)counter, (__int64)value);
+#else
+    __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+#endif
+}
+
+static int ringInit(ClashAsyncRing* self, size_t capacity)
+{
+    tc_mem_clear_type(self);
+    self->cells = tc_malloc(sizeof(ClashAsyncCell) * capacity);
+    if (self->cells == 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < capacity; ++i) {
+        self->cells[i].sequence = i;
+        self->cells[i].item = 0;
+    }
+    self->mask = capacity - 1;
+
+    return 0;
+}
+
+static void ringDestroy(ClashAsyncRing* self)
+{
+    tc_free(self->cells);
+    self->cells = 0;
+}
+
+/// @return negative if the ring is full
+static int ringPush(ClashAsyncRing* self, void* item)
+{
+    uint64_t position = loadRelaxed(&self->enqueuePosition);
+    ClashAsyncCell* cell;
+
+    while (1) {
+        cell = &self->cells[position & self->mask];
+        int64_t difference = (int64_t)(loadAcquire(&cell->sequence) - position);
+        if (difference == 0) {
+            if (compareExchange(&self->enqueuePosition, &position, position + 1)) {
+                break;
+            }
+        } else if (difference < 0) {
+            return -1;
+        } else {
+            position = loadRelaxed(&self->enqueuePosition);
+        }
+    }
+
+    cell->item = item;
+    storeRelease(&cell->sequence, position + 1);
+
+    return 0;
+}
+
+/// @return the oldest item or NULL if the ring is empty
+static void* ringPop(ClashAsyncRing* self)
+{
+    uint64_t position = loadRelaxed(&self->dequeuePosition);
+    ClashAsyncCell* cell;
+
+    while (1) {
+        cell = &self->cells[position & self->mask];
+        int64_t difference = (int64_t)(loadAcquire(&cell->sequence) - (position + 1));
+        if (difference == 0) {
+            if (compareExchange(&self->dequeuePosition, &position, position + 1)) {
+                break;
+            }
+        } else if (difference < 0) {
+            return 0;
+        } else {
+            position = loadRelaxed(&self->dequeuePosition);
+        }
+    }
+
+    void* item = cell->item;
+    storeRelease(&cell->sequence, position + self->mask + 1);
+
+    return item;
+}
+
+static size_t alignOctetCount(size_t octetCount)
+{
+    return (octetCount + CLASH_SCRATCH_ALIGNMENT - 1) & ~(size_t)(CLASH_SCRATCH_ALIGNMENT - 1);
+}
+
+static ClashAsyncJob* job(const ClashAsync* self, size_t index)
+{
+    return (ClashAsyncJob*)(void*)(self->jobMemory + index * self->jobOctetCount);
+}
+
+/// Allocates the queues and the memory for every job.
+/// @param self the async dispatcher, must not be moved after init
+/// @param definition the definition, should be compiled
+/// @param maxQueuedCount maximum number of queued commands, rounded up to a power of two
+/// @param maxLineLength longest line that can be queued, longer lines are only executed directly
+/// @param responseOctetCount size of the response stream for each queued command
+/// @param done called on the worker thread after each queued command
+/// @return negative on error
+int clashAsyncInit(ClashAsync* self, const ClashDefinition* definition, size_t maxQueuedCount,
+    size_t maxLineLength, size_t responseOctetCount, ClashAsyncDoneFn done)
+{
+    size_t capacity = 1;
+    while (capacity < maxQueuedCount) {
+        capacity *= 2;
+    }
+
+    tc_mem_clear_type(self);
+    self->definition = definition;
+    self->maxLineLength = maxLineLength;
+    self->responseOctetCount = responseOctetCount;
+    self->done = done;
+
+    size_t scratchOctetCount = alignOctetCount(maxLineLength + 1
+        + clashDefinitionScratchOctetCount(definition) + maxLineLength + 1
+        + clashDefinitionListOctetCount(definition, maxLineLength / 2 + 1));
+    self->jobOctetCount = alignOctetCount(sizeof(ClashAsyncJob)) + scratchOctetCount
+        + alignOctetCount(responseOctetCount);
+    self->jobMemory = tc_malloc(self->jobOctetCount * capacity);
+    if (self->jobMemory == 0) {
+        return -1;
+    }
+
+    if (ringInit(&self->pending, capacity) < 0 || ringInit(&self->free, capacity) < 0) {
+        clashAsyncDestroy(self);
+        return -1;
+    }
+
+    for (size_t i = 0; i < capacity; ++i) {
+        ClashAsyncJob* item = job(self, i);
+        uint8_t* scratchMemory = (uint8_t*)item + alignOctetCount(sizeof(ClashAsyncJob));
+        clashScratchInit(&item->scratch, scratchMemory, scratchOctetCount);
+        item->responseMemory = scratchMemory + scratchOctetCount;
+        ringPush(&self->free, item);
+    }
+
+    return 0;
+}
+
+/// Frees the queues and the job memory. Commands that are still queued are dropped, so the
+/// worker threads should have stopped and the queue been drained with clashAsyncExecuteNext().
+void clashAsyncDestroy(ClashAsync* self)
+{
+    ringDestroy(&self->pending);
+    ringDestroy(&self->free);
+    tc_free(self->jobMemory);
+    self->jobMemory = 0;
+}
+
+static int isAsync(const ClashCommand* command)
+{
+    return command != 0 && command->fn != 0 && (command->flags & ClashCommandFlagAsync);
+}
+
+static int queueFull(ClashAsync* self, const char* s, size_t length, ClashParseError* error)
+{
+    addRelaxed(&self->rejectedCount, 1);
+
+    return clashParseErrorSet(
+        error, ClashParseErrorKindQueueFull, CLASH_ASYNC_QUEUE_FULL, 0, 0, s, length, 0);
+}
+
+/// Parses without a job, when every job is in use or the line is too long to be queued.
+/// Only commands that are not async can be executed.
+static int parseWithoutJob(ClashAsync* self, const char* s, size_t length, void* userData,
+    FldOutStream* responseStream, ClashParseError* error)
+{
+    uint8_t stackMemory[CLASH_ASYNC_SCRATCH_OCTETS];
+    uint8_t* heapMemory = 0;
+    size_t octetCount = clashDefinitionScratchOctetCount(self->definition) + length + 1
+        + clashDefinitionListOctetCount(self->definition, length / 2 + 1);
+    ClashScratch scratch;
+
+    if (octetCount <= CLASH_ASYNC_SCRATCH_OCTETS) {
+        clashScratchInit(&scratch, stackMemory, CLASH_ASYNC_SCRATCH_OCTETS);
+    } else {
+        heapMemory = tc_malloc(octetCount);
+        clashScratchInit(&scratch, heapMemory, heapMemory == 0 ? 0 : octetCount);
+    }
+
+    ClashState state;
+    clashStateInit(&state, self->definition, &scratch, 0);
+
+    int result = clashStateFeedLine(&state, s, s + length);
+    if (result >= 0 && isAsync(state.command)) {
+        if (length > self->maxLineLength) {
+            result = clashParseErrorSet(&state.error, ClashParseErrorKindScratchExhausted, -7, 0, 0,
+                s, length, 0);
+        } else {
+            result = queueFull(self, s, length, &state.error);
+        }
+    } else if (result >= 0) {
+        result = clashStateDispatch(&state, userData, responseStream);
+    }
+
+    if (error != 0) {
+        *error = state.error;
+    }
+    tc_free(heapMemory);
+
+    return result;
+}
+
+/// Parses a command line on the calling thread. A command flagged with ClashCommandFlagAsync is
+/// converted and queued for the worker threads, any other command is executed directly.
+/// @param self the async dispatcher
+/// @param s the command line
+/// @param userData passed to the ClashFn
+/// @param context passed to the ClashAsyncDoneFn of a queued command
+/// @param responseStream the response output of a command that is executed directly
+/// @param error optional, receives the details if the parse fails
+/// @return CLASH_ASYNC_QUEUED if queued, 0 if executed directly, CLASH_ASYNC_QUEUE_FULL if the
+/// command is async and the queue is full, or another negative parse error
+int clashAsyncParseString(ClashAsync* self, const char* s, void* userData, void* context,
+    FldOutStream* responseStream, ClashParseError* error)
+{
+    size_t length = tc_strlen(s);
+    ClashAsyncJob* item = length <= self->maxLineLength ? ringPop(&self->free) : 0;
+    if (item == 0) {
+        return parseWithoutJob(self, s, length, userData, responseStream, error);
+    }
+
+    clashScratchRewind(&item->scratch, 0);
+    char* lineCopy = clashScratchAllocOctets(&item->scratch, length + 1);
+    tc_memcpy_octets(lineCopy, s, length + 1);
+
+    ClashState state;
+    clashStateInit(&state, self->definition, &item->scratch, 0);
+
+    void* structData = 0;
+    int result = clashStateFeedLine(&state, lineCopy, lineCopy + length);
+    int isQueued = 0;
+    if (result >= 0 && isAsync(state.command)) {
+        result = clashStateConvert(&state, &structData);
+        isQueued = result >= 0;
+    } else if (result >= 0) {
+        result = clashStateDispatch(&state, userData, responseStream);
+    }
+
+    if (error != 0) {
+        *error = state.error;
+        // Point into the caller's line, the copy belongs to the job
+        if (error->found >= lineCopy && error->found <= lineCopy + length) {
+            error->found = s + (error->found - lineCopy);
+        }
+    }
+
+    if (!isQueued) {
+        ringPush(&self->free, item);
+        return result;
+    }
+
+    // Only the callback is timed, the parse time would include the time in the queue
+    ClashCall call
+        = { state.index, state.nodeIndex, state.command, structData, 0, 1, state.text };
+    item->call = call;
+    item->heapText = 0;
+    item->userData = userData;
+    item->context = context;
+    ringPush(&self->pending, item);
+
+    return CLASH_ASYNC_QUEUED;
+}
+
+/// Decodes without a job, when every job is in use or the command is too long to be queued.
+/// Only commands that are not async can be executed.
+static int binaryWithoutJob(ClashAsync* self, const uint8_t* octets, size_t octetCount,
+    void* userData, FldOutStream* responseStream, ClashParseError* error)
+{
+    uint8_t stackMemory[CLASH_ASYNC_SCRATCH_OCTETS];
+    uint8_t* heapMemory = 0;
+    size_t octetCountNeeded = clashDefinitionScratchOctetCount(self->definition) + octetCount
+        + clashDefinitionListOctetCount(self->definition, octetCount / 4);
+    ClashScratch scratch;
+
+    if (octetCountNeeded <= CLASH_ASYNC_SCRATCH_OCTETS) {
+        clashScratchInit(&scratch, stackMemory, CLASH_ASYNC_SCRATCH_OCTETS);
+    } else {
+        heapMemory = tc_malloc(octetCountNeeded);
+        clashScratchInit(&scratch, heapMemory, heapMemory == 0 ? 0 : octetCountNeeded);
+    }
+
+    ClashCall call;
+    char* heapText;
+    int result = clashBinaryDecode(
+        self->definition, octets, octetCount, &scratch, error, &call, &heapText);
+    if (result >= 0 && isAsync(call.command)) {
+        result = queueFull(self, 0, 0, error);
+    } else if (result >= 0) {
+        clashCall(&call, userData, responseStream);
+    }
+
+    tc_free(heapText);
+    tc_free(heapMemory);
+
+    return result;
+}
+
+/// Executes an encoded command like clashBinaryExecute(), but a command flagged with
+/// ClashCommandFlagAsync is queued for the worker threads, like clashAsyncParseString() does.
+/// The encoded command is copied into the job, so it can be at most maxLineLength octets long.
+/// @param self the async dispatcher
+/// @param octets the encoded command
+/// @param octetCount octet count of the encoded command
+/// @param userData passed to the ClashFn
+/// @param context passed to the ClashAsyncDoneFn of a queued command
+/// @param responseStream the response output of a command that is executed directly
+/// @param error optional, receives the details if the decoding fails
+/// @return CLASH_ASYNC_QUEUED if queued, 0 if executed directly, CLASH_ASYNC_QUEUE_FULL if the
+/// command is async and the queue is full, or another negative error
+int clashAsyncBinaryExecute(ClashAsync* self, const uint8_t* octets, size_t octetCount,
+    void* userData, void* context, FldOutStream* responseStream, ClashParseError* error)
+{
+    ClashAsyncJob* item = octetCount <= self->maxLineLength ? ringPop(&self->free) : 0;
+    if (item == 0) {
+        return binaryWithoutJob(self, octets, octetCount, userData, responseStream, error);
+    }
+
+    clashScratchRewind(&item->scratch, 0);
+    uint8_t* copy = clashScratchAllocOctets(&item->scratch, octetCount);
+    tc_memcpy_octets(copy, octets, octetCount);
+
+    ClashCall call;
+    char* heapText;
+    int result = clashBinaryDecode(
+        self->definition, copy, octetCount, &item->scratch, error, &call, &heapText);
+    if (result < 0 || !isAsync(call.command)) {
+        if (result >= 0) {
+            clashCall(&call, userData, responseStream);
+        }
+        tc_free(heapText);
+        ringPush(&self->free, item);
+        return result;
+    }
+
+    item->call = call;
+    item->heapText = heapText;
+    item->userData = userData;
+    item->context = context;
+    ringPush(&self->pending, item);
+
+    return CLASH_ASYNC_QUEUED;
+}
+
+/// Executes the oldest queued command and calls the ClashAsyncDoneFn with its response.
+/// Any number of worker threads can call it at the same time.
+/// @param self the async dispatcher
+/// @return 1 if a command was executed, 0 if the queue was empty
+int clashAsyncExecuteNext(ClashAsync* self)
+{
+    ClashAsyncJob* item = ringPop(&self->pending);
+    if (item == 0) {
+        return 0;
+    }
+
+    FldOutStream responseStream;
+    fldOutStreamInit(&responseStream, item->responseMemory, self->responseOctetCount);
+    clashCall(&item->call, item->userData, &responseStream);
+    tc_free(item->heapText);
+    self->done(item->context, &responseStream);
+    ringPush(&self->free, item);
+
+    return 1;
+}
+
+/// The number of queued commands that have not been started yet. Only a snapshot when other
+/// threads are pushing or popping.
+size_t clashAsyncPendingCount(const ClashAsync* self)
+{
+    uint64_t enqueuePosition = loadRelaxed(&self->pending.enqueuePosition);
+    uint64_t dequeuePosition = loadRelaxed(&self->pending.dequeuePosition);
+
+    return enqueuePosition > dequeuePosition ? (size_t)(enqueuePosition - dequeuePosition) : 0;
+}
@@ -0,0 +1,80 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clash/batch.h>
+#include <clash/clash.h>
+#include <clash/scratch.h>
+#include <clash/state.h>
+#include <flood/out_stream.h>
+#include <string.h>
+
+static int executeLine(ClashState* state, const char* lineStart, const char* lineEnd,
+    void* userData, FldOutStream* responseStream)
+{
+    int tokenCount = clashStateFeedLine(state, lineStart, lineEnd);
+    if (tokenCount <= 0) {
+        return tokenCount;
+    }
+
+    return clashStateDispatch(state, userData, responseStream);
+}
+
+/// Executes every line in a newline separated buffer. The lines are tokenized in place and
+/// the same parse state and scratch memory is reused for each line. A failing line does not
+/// stop the batch.
+/// @param definition the definition to parse against
+/// @param buffer the lines, does not need to be zero terminated
+/// @param length octet count of the buffer
+/// @param userData passed to each ClashFn
+/// @param responseStream receives the zero terminated response of each executed line
+/// @param scratch temporary memory, should have clashDefinitionScratchOctetCount() plus the
+/// longest line length free, and clashDefinitionListOctetCount() for it with list options
+/// @param results optional, receives the result of each line
+/// @param maxResults maximum number of results to write
+/// @return number of lines in the buffer
+int clashExecuteBatch(const ClashDefinition* definition, const char* buffer, size_t length,
+    void* userData, FldOutStream* responseStream, ClashScratch* scratch,
+    ClashBatchLineResult* results, size_t maxResults)
+{
+    ClashState state;
+    clashStateInit(&state, definition, scratch, 0);
+
+    const char* end = buffer + length;
+    const char* lineStart = buffer;
+    size_t lineCount = 0;
+
+    while (lineStart < end) {
+        const char* lineEnd = memchr(lineStart, '\n', (size_t)(end - lineStart));
+        const char* next = lineEnd == 0 ? end : lineEnd + 1;
+        if (lineEnd == 0) {
+            lineEnd = end;
+        }
+        if (lineEnd > lineStart && lineEnd[-1] == '\r') {
+            lineEnd--;
+        }
+
+        size_t responseOffset = responseStream->pos;
+        int errorCode = executeLine(&state, lineStart, lineEnd, userData, responseStream);
+
+        if (results != 0 && lineCount < maxResults) {
+            ClashBatchLineResult* result = &results[lineCount];
+            result->errorCode = errorCode;
+            result->lineOffset = (size_t)(lineStart - buffer);
+            result->responseOffset = responseOffset;
+            if (errorCode < 0) {
+                result->error = state.error;
+            } else {
+                clashParseErrorClear(&result->error);
+            }
+        }
+
+        clashStateReset(&state);
+        lineCount++;
+        lineStart = next;
+    }
+
+    clashScratchRewind(scratch, state.scratchMark);
+
+    return (int)lineCount;
+}
@@ -0,0 +1,710 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clash/binary.h>
+#include <clash/clash.h>
+#include <clash/convert.h>
+#include <clash/index.h>
+#include <clash/scratch.h>
+#include <clash/state.h>
+#include <flood/out_stream.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <tiny-libc/tiny_libc.h>
+
+// The encoding of a command, all numbers big endian like flood:
+//   uint8 CLASH_BINARY_VERSION
+//   uint32 index of the command node in the compiled ClashIndex
+//   uint16 number of options, then for each option:
+//     uint16 option index in the command
+//     the value: uint8 for bool, int32 for int and flag, uint64 for uint64, int64, duration and
+//     the bits of a double, uint32 octet count followed by the octets for string and view,
+//     uint32 value count followed by each value like a string for list
+// Options that are not encoded get their default value.
+
+static int findNode(const ClashIndex* index, const ClashCommand* command)
+{
+    for (size_t i = 1; i < index->nodeCount; ++i) {
+        if (index->nodeInfos[i].command == command) {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
+
+static int isStringType(const ClashOption* option)
+{
+    return !(option->type & ClashTypeBool) && (option->type & ClashTypeMask) == ClashTypeString;
+}
+
+/// A string field that is NULL is not encoded, so it gets its default when decoded
+static int hasValue(const ClashOption* option, const void* p)
+{
+    if (option->type & ClashTypeList) {
+        return ((const ClashStringList*)p)->count != 0;
+    }
+    if (!isStringType(option)) {
+        return 1;
+    }
+    if (option->type & ClashTypeView) {
+        return ((const ClashStringView*)p)->str != 0;
+    }
+
+    return *(const char* const*)p != 0;
+}
+
+static int writeString(FldOutStream* outStream, const char* s, size_t length)
+{
+    if (length > UINT32_MAX) {
+        return -1;
+    }
+    int result = fldOutStreamWriteUInt32(outStream, (uint32_t)length);
+    if (result < 0) {
+        return result;
+    }
+
+    return fldOutStreamWriteOctets(outStream, (const uint8_t*)s, length);
+}
+
+static int writeList(FldOutStream* outStream, const ClashStringList* list)
+{
+    if (list->count > UINT32_MAX) {
+        return -1;
+    }
+    int result = fldOutStreamWriteUInt32(outStream, (uint32_t)list->count);
+    for (size_t i = 0; i < list->count && result >= 0; ++i) {
+        result = writeString(outStream, list->values[i].str, list->values[i].length);
+    }
+
+    return result;
+}
+
+static int writeValue(FldOutStream* outStream, const ClashOption* option, const void* p)
+{
+    if (option->type & ClashTypeList) {
+        return writeList(outStream, (const ClashStringList*)p);
+    }
+
+    if (option->type & ClashTypeBool) {
+        return fldOutStreamWriteUInt8(outStream, *(const bool*)p ? 1 : 0);
+    }
+
+    switch (option->type & ClashTypeMask) {
+    case ClashTypeString:
+        if (option->type & ClashTypeView) {
+            const ClashStringView* view = (const ClashStringView*)p;
+            return writeString(outStream, view->str, view->length);
+        } else {
+            const char* s = *(const char* const*)p;
+            return writeString(outStream, s, tc_strlen(s));
+        }
+    case ClashTypeInt:
+    case ClashTypeFlag: {
+        int value = *(const int*)p;
+        return fldOutStreamWriteInt32(outStream, (int32_t)value);
+    }
+    case ClashTypeUInt64:
+        return fldOutStreamWriteUInt64(outStream, *(const uint64_t*)p);
+    case ClashTypeInt64:
+    case ClashTypeDuration: {
+        int64_t value = *(const int64_t*)p;
+        return fldOutStreamWriteUInt64(outStream, (uint64_t)value);
+    }
+    case ClashTypeDouble: {
+        uint64_t bits;
+        memcpy(&bits, p, sizeof(bits));
+        return fldOutStreamWriteUInt64(outStream, bits);
+    }
+    default:
+        return fldOutStreamWriteUInt8(outStream, 0);
+    }
+}
+
+static int encodeNode(
+    FldOutStream* outStream, size_t nodeIndex, const ClashCommand* command, const void* structData)
+{
+    size_t startPos = outStream->pos;
+    const uint8_t* data = structData;
+    size_t optionCount = 0;
+    if (data != 0) {
+        for (size_t i = 0; i < command->optionCount; ++i) {
+            const ClashOption* option = &command->options[i];
+            optionCount += (size_t)hasValue(option, data + option->structOffset);
+        }
+    }
+
+    int result = fldOutStreamWriteUInt8(outStream, CLASH_BINARY_VERSION);
+    if (result >= 0) {
+        result = fldOutStreamWriteUInt32(outStream, (uint32_t)nodeIndex);
+    }
+    if (result >= 0) {
+        result = fldOutStreamWriteUInt16(outStream, (uint16_t)optionCount);
+    }
+
+    for (size_t i = 0; i < command->optionCount && data != 0 && result >= 0; ++i) {
+        const ClashOption* option = &command->options[i];
+        const void* p = data + option->structOffset;
+        if (!hasValue(option, p)) {
+            continue;
+        }
+        result = fldOutStreamWriteUInt16(outStream, (uint16_t)i);
+        if (result >= 0) {
+            result = writeValue(outStream, option, p);
+        }
+    }
+
+    return result < 0 ? result : (int)(outStream->pos - startPos);
+}
+
+/// Encodes a command struct, e.g. one filled in by a remote tool, without any text.
+/// The definition must be compiled and the same on both sides, commands are identified by their
+/// position in it.
+/// @param definition the compiled definition
+/// @param command the command, one of the commands in the definition
+/// @param structData the struct of the command, can be NULL for a command without a ClashFn
+/// @param outStream receives the encoded command
+/// @return number of octets written, or negative on error
+int clashBinaryEncodeCommand(const ClashDefinition* definition, const ClashCommand* command,
+    const void* structData, FldOutStream* outStream)
+{
+    if (definition->index == 0) {
+        return -1;
+    }
+
+    int nodeIndex = findNode(definition->index, command);
+    if (nodeIndex < 0 || command->optionCount > UINT16_MAX) {
+        return -4;
+    }
+
+    return encodeNode(outStream, (size_t)nodeIndex, command, command->fn != 0 ? structData : 0);
+}
+
+/// Parses a text command line and encodes the converted command, so it can be sent to a
+/// clashBinaryExecute() that shares the same definition.
+/// @param definition the compiled definition
+/// @param line the command line
+/// @param outStream receives the encoded command
+/// @param scratch temporary memory, see clashParseStringEx()
+/// @param error optional, receives the details if the parse fails
+/// @return number of octets written, or negative on error
+int clashBinaryEncodeString(const ClashDefinition* definition, const char* line,
+    FldOutStream* outStream, ClashScratch* scratch, ClashParseError* error)
+{
+    if (definition->index == 0) {
+        return -1;
+    }
+
+    ClashState state;
+    clashStateInit(&state, definition, scratch, 0);
+
+    void* structData = 0;
+    int result = clashStateFeedLine(&state, line, line + tc_strlen(line));
+    if (result >= 0 && state.command == 0) {
+        result = clashStateError(&state, ClashParseErrorKindNoCommand, -5, "command", 0);
+    }
+    if (result >= 0) {
+        result = clashStateConvert(&state, &structData);
+    }
+    if (result >= 0) {
+        result = encodeNode(outStream, state.nodeIndex, state.command, structData);
+    }
+
+    clashScratchRewind(scratch, state.scratchMark);
+    if (error != 0) {
+        *error = state.error;
+    }
+
+    return result;
+}
+
+typedef struct Decoder {
+    const uint8_t* octets;
+    size_t octetCount;
+    size_t pos;
+    ClashScratch* scratch;
+    ClashParseError* error;
+} Decoder;
+
+static int malformed(Decoder* self, const char* expected)
+{
+    return clashParseErrorSet(self->error, ClashParseErrorKindMalformedBinary,
+        CLASH_BINARY_MALFORMED, expected, 0, 0, 0, self->pos);
+}
+
+static int scratchExhausted(Decoder* self)
+{
+    return clashParseErrorSet(
+        self->error, ClashParseErrorKindScratchExhausted, -7, 0, 0, 0, 0, self->pos);
+}
+
+static int readOctets(Decoder* self, size_t count, const uint8_t** out)
+{
+    if (self->octetCount - self->pos < count) {
+        return -1;
+    }
+    *out = self->octets + self->pos;
+    self->pos += count;
+
+    return 0;
+}
+
+static int readUInt(Decoder* self, size_t octetCount, uint64_t* value)
+{
+    const uint8_t* p;
+    *value = 0;
+    if (readOctets(self, octetCount, &p) < 0) {
+        return malformed(self, "more octets");
+    }
+
+    for (size_t i = 0; i < octetCount; ++i) {
+        *value = (*value << 8) | p[i];
+    }
+
+    return 0;
+}
+
+static int readString(
+    Decoder* self, const ClashOption* option, const char** s, size_t* length)
+{
+    uint64_t octetCount;
+    const uint8_t* p;
+    if (readUInt(self, 4, &octetCount) < 0) {
+        return CLASH_BINARY_MALFORMED;
+    }
+    if (readOctets(self, (size_t)octetCount, &p) < 0) {
+        return malformed(self, "more octets");
+    }
+    *s = (const char*)p;
+    *length = (size_t)octetCount;
+
+    if (clashConvertCheckChoice(option->choices, *s, *length) < 0) {
+        return clashParseErrorSet(self->error, ClashParseErrorKindInvalidValue,
+            CLASH_CONVERT_INVALID, clashConvertExpectedValue(option), 0, *s, *length, self->pos);
+    }
+
+    return 0;
+}
+
+static int valueError(Decoder* self, const ClashOption* option, int code)
+{
+    return clashParseErrorSet(self->error, clashConvertErrorKind(code), code,
+        clashConvertExpectedValue(option), 0, 0, 0, self->pos);
+}
+
+/// All the views are allocated at once, the value count is known before the values are read
+static int readList(Decoder* self, const ClashOption* option, ClashStringList* list)
+{
+    uint64_t count;
+    if (readUInt(self, 4, &count) < 0) {
+        return CLASH_BINARY_MALFORMED;
+    }
+    // Every value takes at least the four octets of its length
+    if (count > (self->octetCount - self->pos) / 4) {
+        return malformed(self, "more octets");
+    }
+
+    ClashStringView* values
+        = clashScratchAlloc(self->scratch, (size_t)count * sizeof(ClashStringView));
+    if (values == 0) {
+        return scratchExhausted(self);
+    }
+    for (size_t i = 0; i < (size_t)count; ++i) {
+        int result = readString(self, option, &values[i].str, &values[i].length);
+        if (result < 0) {
+            return result;
+        }
+    }
+    list->values = count == 0 ? 0 : values;
+    list->count = (size_t)count;
+
+    return 0;
+}
+
+static int readValue(Decoder* self, const ClashOption* option, void* p)
+{
+    if (option->type & ClashTypeList) {
+        return readList(self, option, (ClashStringList*)p);
+    }
+
+    uint64_t value;
+    int octetCount = (option->type & ClashTypeBool) ? 1 : 8;
+    switch (option->type & ClashTypeMask) {
+    case ClashTypeString:
+        if (!(option->type & ClashTypeBool)) {
+            const char* s = 0;
+            size_t length = 0;
+            int result = readString(self, option, &s, &length);
+            if (result < 0) {
+                return result;
+            }
+            if (option->type & ClashTypeView) {
+                ((ClashStringView*)p)->str = s;
+                ((ClashStringView*)p)->length = length;
+            } else {
+                *(const char**)p = clashScratchCopyString(self->scratch, s, length);
+                if (*(const char**)p == 0) {
+                    return scratchExhausted(self);
+                }
+            }
+            return 0;
+        }
+        break;
+    case ClashTypeInt:
+    case ClashTypeFlag:
+        octetCount = 4;
+        break;
+    default:
+        break;
+    }
+
+    if (readUInt(self, (size_t)octetCount, &value) < 0) {
+        return CLASH_BINARY_MALFORMED;
+    }
+
+    int errorCode = 0;
+    if (option->type & ClashTypeBool) {
+        if (value > 1) {
+            return valueError(self, option, CLASH_CONVERT_INVALID);
+        }
+        *(bool*)p = value != 0;
+        return 0;
+    }
+
+    switch (option->type & ClashTypeMask) {
+    case ClashTypeInt:
+        *(int*)p = (int32_t)(uint32_t)value;
+        errorCode = clashConvertCheckRange(*(int*)p, option->minimum, option->maximum);
+        break;
+    case ClashTypeFlag:
+        *(int*)p = (int32_t)(uint32_t)value;
+        break;
+    case ClashTypeUInt64:
+        *(uint64_t*)p = value;
+        errorCode = clashConvertCheckRangeUInt64(value, option->minimum, option->maximum);
+        break;
+    case ClashTypeInt64:
+    case ClashTypeDuration:
+        *(int64_t*)p = (int64_t)value;
+        errorCode = clashConvertCheckRange((int64_t)value, option->minimum, option->maximum);
+        break;
+    case ClashTypeDouble:
+        memcpy(p, &value, sizeof(value));
+        errorCode = clashConvertCheckRangeDouble(*(double*)p, option->minimum, option->maximum);
+        break;
+    default:
+        break;
+    }
+
+    return errorCode < 0 ? valueError(self, option, errorCode) : 0;
+}
+
+static int setDefaults(
+    Decoder* self, const ClashCommand* command, uint8_t* data, const uint8_t* isSet)
+{
+    for (size_t i = 0; i < command->optionCount; ++i) {
+        if (isSet[i]) {
+            continue;
+        }
+        const ClashOption* option = &command->options[i];
+        ClashStructValue item;
+        item.value = option->value;
+        item.length = option->value == 0 ? 0 : tc_strlen(option->value);
+        item.count = 0;
+        item.isTerminated = 1;
+        item.tokenIndex = 0;
+        item.list = 0;
+        item.listCapacity = 0;
+        int errorCode
+            = clashStateConvertValue(option, &item, data + option->structOffset, self->scratch);
+        if (errorCode < 0) {
+            return valueError(self, option, errorCode);
+        }
+    }
+
+    return 0;
+}
+
+static int decode(Decoder* self, const ClashIndex* index, size_t* foundNodeIndex,
+    const ClashCommand** command, void** structData)
+{
+    uint64_t version;
+    uint64_t nodeIndex;
+    uint64_t optionCount;
+    if (readUInt(self, 1, &version) < 0 || readUInt(self, 4, &nodeIndex) < 0
+        || readUInt(self, 2, &optionCount) < 0) {
+        return CLASH_BINARY_MALFORMED;
+    }
+    if (version != CLASH_BINARY_VERSION) {
+        return malformed(self, "binary version 1");
+    }
+    if (nodeIndex == CLASH_INDEX_ROOT || nodeIndex >= index->nodeCount) {
+        return malformed(self, "command");
+    }
+
+    const ClashCommand* found = index->nodeInfos[nodeIndex].command;
+    *foundNodeIndex = (size_t)nodeIndex;
+    *command = found;
+    *structData = 0;
+    if (found->fn == 0) {
+        return optionCount == 0 ? 0 : malformed(self, "no options");
+    }
+
+    uint8_t* data = clashScratchAlloc(self->scratch, found->structSize);
+    uint8_t* isSet = clashScratchAllocOctets(self->scratch, found->optionCount);
+    if (data == 0 || (isSet == 0 && found->optionCount != 0)) {
+        return scratchExhausted(self);
+    }
+    tc_mem_clear(data, found->structSize);
+    tc_mem_clear(isSet, found->optionCount);
+
+    for (size_t i = 0; i < optionCount; ++i) {
+        uint64_t optionIndex;
+        if (readUInt(self, 2, &optionIndex) < 0) {
+            return CLASH_BINARY_MALFORMED;
+        }
+        if (optionIndex >= found->optionCount) {
+            return malformed(self, "option");
+        }
+        const ClashOption* option = &found->options[optionIndex];
+        int result = readValue(self, option, data + option->structOffset);
+        if (result < 0) {
+            return result;
+        }
+        isSet[optionIndex] = 1;
+    }
+
+    if (self->pos != self->octetCount) {
+        return malformed(self, "end of command");
+    }
+    *structData = data;
+
+    return setDefaults(self, found, data, isSet);
+}
+
+typedef struct HistoryText {
+    char* octets;
+    size_t pos;
+    size_t tokenCount;
+} HistoryText;
+
+/// Only counts the octets while octets is NULL
+static void textAppend(HistoryText* self, const char* s, size_t length)
+{
+    if (self->octets != 0) {
+        tc_memcpy_octets(self->octets + self->pos, s, length);
+    }
+    self->pos += length;
+}
+
+static void textToken(HistoryText* self, const char* s, size_t length)
+{
+    textAppend(self, s, length);
+    textAppend(self, "", 1);
+    self->tokenCount++;
+}
+
+static void textOption(HistoryText* self, const ClashOption* option, const char* value,
+    size_t length)
+{
+    textAppend(self, "--", 2);
+    textAppend(self, option->name, tc_strlen(option->name));
+    textAppend(self, "=", 1);
+    textToken(self, value, length);
+}
+
+static void textNumber(HistoryText* self, const ClashOption* option, const void* p)
+{
+    char number[32];
+    int length = 0;
+    switch (option->type & ClashTypeMask) {
+    case ClashTypeInt:
+        length = snprintf(number, sizeof(number), "%d", *(const int*)p);
+        break;
+    case ClashTypeUInt64:
+        length = snprintf(number, sizeof(number), "%" PRIu64, *(const uint64_t*)p);
+        break;
+    case ClashTypeInt64:
+        length = snprintf(number, sizeof(number), "%" PRId64, *(const int64_t*)p);
+        break;
+    case ClashTypeDuration:
+        length = snprintf(number, sizeof(number), "%" PRId64 "ms", *(const int64_t*)p);
+        break;
+    case ClashTypeDouble:
+        // Enough digits to get the same double back
+        length = snprintf(number, sizeof(number), "%.17g", *(const double*)p);
+        break;
+    default:
+        break;
+    }
+    if (length > 0) {
+        textOption(self, option, number, (size_t)length);
+    }
+}
+
+static void textValue(HistoryText* self, const ClashOption* option, const void* p)
+{
+    if (option->type & ClashTypeList) {
+        const ClashStringList* list = (const ClashStringList*)p;
+        for (size_t i = 0; i < list->count; ++i) {
+            textOption(self, option, list->values[i].str, list->values[i].length);
+        }
+    } else if (option->type & ClashTypeBool) {
+        const char* value = *(const bool*)p ? "true" : "false";
+        textOption(self, option, value, tc_strlen(value));
+    } else if ((option->type & ClashTypeMask) == ClashTypeFlag) {
+        for (int i = 0; i < *(const int*)p; ++i) {
+            textAppend(self, "--", 2);
+            textToken(self, option->name, tc_strlen(option->name));
+        }
+    } else if (option->type & ClashTypeView) {
+        const ClashStringView* view = (const ClashStringView*)p;
+        textOption(self, option, view->str, view->length);
+    } else if (isStringType(option)) {
+        const char* value = *(const char* const*)p;
+        textOption(self, option, value, tc_strlen(value));
+    } else {
+        textNumber(self, option, p);
+    }
+}
+
+static size_t parentNode(const ClashIndex* index, size_t nodeIndex)
+{
+    for (size_t i = 0; i < index->nodeCount; ++i) {
+        const ClashIndexNode* node = &index->nodes[i];
+        if (nodeIndex >= node->childStart && nodeIndex - node->childStart < node->childCount) {
+            return i;
+        }
+    }
+
+    return CLASH_INDEX_ROOT;
+}
+
+/// The command names from the root down to the node
+static void textPath(HistoryText* self, const ClashIndex* index, size_t nodeIndex)
+{
+    if (nodeIndex == CLASH_INDEX_ROOT) {
+        return;
+    }
+    textPath(self, index, parentNode(index, nodeIndex));
+    const char* name = index->nodeInfos[nodeIndex].command->name;
+    textToken(self, name, tc_strlen(name));
+}
+
+static void writeHistoryText(HistoryText* self, const ClashIndex* index, size_t nodeIndex,
+    const ClashCommand* command, const uint8_t* data)
+{
+    textPath(self, index, nodeIndex);
+    for (size_t i = 0; i < command->optionCount; ++i) {
+        const ClashOption* option = &command->options[i];
+        if (hasValue(option, data + option->structOffset)) {
+            textValue(self, option, data + option->structOffset);
+        }
+    }
+}
+
+/// A binary command has no text, so it is recorded to the history as the `--name=value` tokens
+/// that parse to the same struct. The tokens are stored in the scratch, or on the heap if it is
+/// full.
+/// @return the heap memory to free after the call, if any
+static char* historyText(ClashCall* call, ClashScratch* scratch)
+{
+    HistoryText text = { 0, 0, 0 };
+    writeHistoryText(&text, call->index, call->nodeIndex, call->command, call->structData);
+
+    char* heapMemory = 0;
+    text.octets = clashScratchAllocOctets(scratch, text.pos);
+    if (text.octets == 0) {
+        heapMemory = tc_malloc(text.pos);
+        text.octets = heapMemory;
+    }
+    if (text.octets == 0) {
+        return 0;
+    }
+
+    text.pos = 0;
+    text.tokenCount = 0;
+    writeHistoryText(&text, call->index, call->nodeIndex, call->command, call->structData);
+    call->text.tokens = text.octets;
+    call->text.tokensOctetCount = text.pos;
+    call->text.tokenCount = text.tokenCount;
+
+    return heapMemory;
+}
+
+/// Decodes an encoded command into a call for clashCall(), without calling it. Nothing is tokenized
+/// and numbers are not parsed, the values are only checked against the bounds and choices of their
+/// options. If the definition has a history, the call also gets the text to record.
+/// @param definition the compiled definition, the same as the one used for encoding
+/// @param octets the encoded command, views in the struct point into it
+/// @param octetCount octet count of the encoded command
+/// @param scratch receives the struct, see clashBinaryExecute()
+/// @param error optional, receives the details if the decoding fails
+/// @param call receives the command and its struct
+/// @param heapText receives the history text if it did not fit in the scratch, tc_free() it after
+/// the call. NULL otherwise.
+/// @return negative on error
+int clashBinaryDecode(const ClashDefinition* definition, const uint8_t* octets, size_t octetCount,
+    ClashScratch* scratch, ClashParseError* error, ClashCall* call, char** heapText)
+{
+    *heapText = 0;
+    if (definition->index == 0) {
+        return -1;
+    }
+
+    if (error != 0) {
+        clashParseErrorClear(error);
+    }
+    Decoder decoder = { octets, octetCount, 0, scratch, error };
+
+    const ClashIndex* index = definition->index;
+    size_t nodeIndex = 0;
+    const ClashCommand* command = 0;
+    void* structData = 0;
+    int result = decode(&decoder, index, &nodeIndex, &command, &structData);
+    if (result < 0) {
+        return result;
+    }
+
+    ClashCall decoded = { index, nodeIndex, command, structData, 0, 1, { 0, 0, 0, 0, 0, 0, 0 } };
+    *call = decoded;
+    if (index->history != 0 && command->fn != 0) {
+        *heapText = historyText(call, scratch);
+    }
+
+    return 0;
+}
+
+/// Executes an encoded command, see clashBinaryDecode(). A command flagged with
+/// ClashCommandFlagAsync is executed directly, use clashAsyncBinaryExecute() to queue it.
+/// @param definition the compiled definition, the same as the one used for encoding
+/// @param octets the encoded command, views point into it during the ClashFn
+/// @param octetCount octet count of the encoded command
+/// @param userData passed to the ClashFn
+/// @param responseStream the response output
+/// @param scratch temporary memory, should have at least clashDefinitionScratchOctetCount() plus
+/// octetCount free, and clashDefinitionListOctetCount() of octetCount / 4 values for list
+/// options, it is rewound before returning
+/// @param error optional, receives the details if the decoding fails
+/// @return negative on error
+int clashBinaryExecute(const ClashDefinition* definition, const uint8_t* octets,
+    size_t octetCount, void* userData, FldOutStream* responseStream, ClashScratch* scratch,
+    ClashParseError* error)
+{
+    size_t scratchMark = scratch->pos;
+    ClashCall call;
+    char* heapText;
+    int result
+        = clashBinaryDecode(definition, octets, octetCount, scratch, error, &call, &heapText);
+    if (result >= 0) {
+        clashCall(&call, userData, responseStream);
+    }
+
+    tc_free(heapText);
+    clashScratchRewind(scratch, scratchMark);
+
+    return result;
+}
@@ -3,530 +3,426 @@
  *  Licensed under the MIT License. See LICENSE in the project root for license information.
  *--------------------------------------------------------------------------------------------------------*/
 #include <clash/clash.h>
+#include <clash/history.h>
+#include <clash/index.h>
+#include <clash/parse_cache.h>
+#include <clash/parse_error.h>
 #include <clash/response.h>
-#include <clog/clog.h>
+#include <clash/response_chunks.h>
+#include <clash/scratch.h>
+#include <clash/state.h>
+#include <clash/tokenizer.h>
+#include <clash/usage.h>
 #include <flood/out_stream.h>
 #include <stdio.h>
 #include <string.h>
 #include <tiny-libc/tiny_libc.h>
 
-typedef struct ClashStructValue {
-    const char* value;
-    int count;
-} ClashStructValue;
-
-typedef struct ClashStructValues {
-    ClashStructValue* values;
-    size_t count;
-} ClashStructValues;
-
-typedef struct ClashState {
-    const ClashCommand* command;
-    const ClashOption* nameOption;
-    int nameOptionIndex;
-    ClashStructValues values;
-    int argIndex;
-} ClashState;
-
-static ClashCommand* clashDefFindCommand(const ClashDefinition* definition, const char* name)
+static size_t alignScratch(size_t octetCount)
 {
-    for (size_t i = 0; i < definition->commandCount; ++i) {
-        if (tc_str_equal(name, definition->commands[i].name)) {
-            return &definition->commands[i];
-        }
-    }
-
-    return 0;
+    return (octetCount + CLASH_SCRATCH_ALIGNMENT - 1) & ~(size_t)(CLASH_SCRATCH_ALIGNMENT - 1);
 }
 
-static int clashCommandFindNameOption(const struct ClashCommand* command, const char* name)
+static size_t scratchOctetCountForCommands(const ClashCommand* commands, size_t count)
 {
-    for (size_t i = 0; i < command->optionCount; ++i) {
-        if (tc_str_equal(name, command->options[i].name)) {
-            return (int)i;
+    size_t maxOctetCount = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const ClashCommand* command = &commands[i];
+        size_t octetCount = alignScratch(sizeof(ClashStructValue) * command->optionCount)
+            + alignScratch(command->structSize);
+        if (octetCount > maxOctetCount) {
+            maxOctetCount = octetCount;
+        }
+        octetCount = scratchOctetCountForCommands(command->subCommands, command->subCommandsCount);
+        if (octetCount > maxOctetCount) {
+            maxOctetCount = octetCount;
         }
     }
 
-    return -1;
+    return maxOctetCount;
 }
 
-static int clashCommandFindShortOption(const struct ClashCommand* command, const char shortName)
+static int commandsHaveListOptions(const ClashCommand* commands, size_t count)
 {
-    for (size_t i = 0; i < command->optionCount; ++i) {
-        if (command->options[i].shortName == shortName) {
-            return (int)i;
+    for (size_t i = 0; i < count; ++i) {
+        const ClashCommand* command = &commands[i];
+        for (size_t j = 0; j < command->optionCount; ++j) {
+            if (command->options[j].type & ClashTypeList) {
+                return 1;
+            }
+        }
+        if (commandsHaveListOptions(command->subCommands, command->subCommandsCount)) {
+            return 1;
         }
     }
 
-    return -1;
+    return 0;
 }
 
-static int clashCommandFindSubCommand(const struct ClashCommand* command, const char* shortName)
+/// Calculates how much scratch memory clashParseEx() needs at most for the definition.
+/// @param definition the definition
+/// @return octet count needed
+size_t clashDefinitionScratchOctetCount(const ClashDefinition* definition)
 {
-    for (size_t i = 0; i < command->subCommandsCount; ++i) {
-        if (tc_str_equal(command->subCommands[i].name, shortName)) {
-            return (int)i;
-        }
+    if (definition->index != 0) {
+        return definition->index->scratchOctetCount;
     }
 
-    return -1;
+    return scratchOctetCountForCommands(definition->commands, definition->commandCount)
+        + CLASH_SCRATCH_ALIGNMENT;
 }
 
-static int parseNameOption(ClashState* state, const char* name)
+/// Checks if any command has a ClashTypeList option, which needs scratch memory for its values.
+/// @param definition the definition
+/// @return non zero if there are list options
+int clashDefinitionHasListOptions(const ClashDefinition* definition)
 {
-    if (state->command == 0) {
-        return -5;
+    if (definition->index != 0) {
+        return definition->index->hasListOptions;
     }
 
-    state->nameOptionIndex = clashCommandFindNameOption(state->command, name);
-    if (state->nameOptionIndex == -1) {
-        CLOG_SOFT_ERROR("could not find option '%s'", name)
-        return -6;
-    }
-
-    state->nameOption = &state->command->options[state->nameOptionIndex];
-    printf("found name option '%s'\n", state->nameOption->name);
-    return 0;
+    return commandsHaveListOptions(definition->commands, definition->commandCount);
 }
 
-#if defined CLASH_DEBUG_OUTPUT
-
-static void valuesDebugOutput(const ClashStructValues* values, const struct ClashCommand* command)
+/// Calculates how much scratch memory the ClashTypeList values of a command line can take at
+/// most, in addition to clashDefinitionScratchOctetCount().
+/// @param definition the definition
+/// @param maxValueCount the most values the line can have, e.g. its token count
+/// @return octet count needed, zero if the definition has no list options
+size_t clashDefinitionListOctetCount(const ClashDefinition* definition, size_t maxValueCount)
 {
-    printf("\n Resulting values ----------- \n");
-    if (command->optionCount == 0) {
-        printf("problem\n");
-        return;
-    }
-    for (size_t i = 0; i < values->count; ++i) {
-        const ClashStructValue* item = &values->values[i];
-        const struct ClashOption* option = &command->options[i];
-        printf("%zu: %s = '%s' (%d) %s\n", i, option->name, item->value, item->count,
-            option->description);
+    if (!clashDefinitionHasListOptions(definition)) {
+        return 0;
     }
-}
-
-#endif
 
-static int setOptionValue(ClashStructValues* values, int optionIndex, const char* value)
-{
-    values->values[optionIndex].value = value;
-    values->values[optionIndex].count++;
-    // printf("* set option %d = '%s' (count:%d)\n", optionIndex, value, values->values[optionIndex].count);
-    return 0;
+    // The lists are packed after each other with one view per value, see appendListValue()
+    return maxValueCount * sizeof(ClashStringView) + CLASH_SCRATCH_ALIGNMENT;
 }
 
-static int parseNameOptionValue(ClashState* state, const char* value)
+/// Parses and executes a command without using the heap.
+/// All temporary memory is taken from the scratch, which is rewound before returning.
+/// @param definition the definition to parse against
+/// @param argv the arguments
+/// @param argc number of arguments
+/// @param userData passed to the ClashFn
+/// @param responseStream the response output
+/// @param scratch temporary memory, should have at least clashDefinitionScratchOctetCount() free,
+/// plus clashDefinitionListOctetCount() for argc values if the definition has list options
+/// @param error optional, receives the details if the parse fails
+/// @return negative on error
+int clashParseEx(const ClashDefinition* definition, const char** argv, int argc, void* userData,
+    FldOutStream* responseStream, ClashScratch* scratch, ClashParseError* error)
 {
-    if (state->nameOptionIndex == -1) {
-        return -6;
-    }
-    if (state->nameOptionIndex >= (int)state->values.count) {
-        return -4;
+    ClashState state;
+    clashStateInit(&state, definition, scratch, ClashStateFlagTerminatedTokens);
+
+    int result = 0;
+    for (int i = 0; i < argc; ++i) {
+        const char* s = argv[i];
+        result = clashStateFeed(&state, s, s == 0 ? 0 : tc_strlen(s));
+        if (result < 0) {
+            break;
+        }
     }
 
-    setOptionValue(&state->values, state->nameOptionIndex, value);
+    if (result >= 0) {
+        state.text.argv = argv;
+        state.text.argc = argc;
+        result = clashStateDispatch(&state, userData, responseStream);
+    }
 
-    state->nameOptionIndex = -1;
-    state->nameOption = 0;
+    clashScratchRewind(scratch, state.scratchMark);
+    if (error != 0) {
+        *error = state.error;
+    }
 
-    return 0;
+    return result;
 }
 
-static int parseShortOption(struct ClashState* state, const char s)
+static uint8_t* initScratch(ClashScratch* scratch, uint8_t* stackMemory, size_t octetCount)
 {
-    int index = clashCommandFindShortOption(state->command, s);
-    if (index < 0) {
-        printf("unknown short option %c\n", s);
-        return index;
+    if (octetCount <= CLASH_PARSE_SCRATCH_OCTETS) {
+        clashScratchInit(scratch, stackMemory, CLASH_PARSE_SCRATCH_OCTETS);
+        return 0;
     }
 
-    setOptionValue(&state->values, index, "");
-    return 0;
-}
+    uint8_t* heapMemory = tc_malloc(octetCount);
+    clashScratchInit(scratch, heapMemory, heapMemory == 0 ? 0 : octetCount);
 
-static void selectCommand(struct ClashState* state, const struct ClashCommand* command)
-{
-    state->command = command;
-    state->values.values = tc_malloc_type_count(ClashStructValue, command->optionCount);
-    state->values.count = command->optionCount;
-    for (size_t i = 0; i < state->values.count; ++i) {
-        state->values.values[i].count = 0;
-        state->values.values[i].value = command->options[i].value;
-    }
+    return heapMemory;
 }
 
-static int parseArg(ClashState* state, const char* value)
+int clashParse(const ClashDefinition* definition, const char** argv, int argc, void* userData,
+    FldOutStream* responseStream)
 {
-    if (state->argIndex >= (int)state->command->optionCount) {
-        return -1;
-    }
+    uint8_t stackMemory[CLASH_PARSE_SCRATCH_OCTETS];
+    ClashScratch scratch;
+    size_t octetCount = clashDefinitionScratchOctetCount(definition)
+        + clashDefinitionListOctetCount(definition, argc < 0 ? 0 : (size_t)argc);
+    uint8_t* heapMemory = initScratch(&scratch, stackMemory, octetCount);
 
-    const ClashOption* nextOption = &state->command->options[state->argIndex];
-    if (!(nextOption->type & ClashTypeArg)) {
-        return -2;
-    }
+    int result = clashParseEx(definition, argv, argc, userData, responseStream, &scratch, 0);
 
-    state->nameOption = nextOption;
-    state->nameOptionIndex = state->argIndex;
-    state->argIndex++;
-    parseNameOptionValue(state, value);
+    tc_free(heapMemory);
 
-    return 0;
+    return result;
 }
 
-static int parseSubCommand(struct ClashState* state, const char* commandName)
+/// Builds the lookup index for the definition, so each command and option lookup in clashParse()
+/// only costs a hash of the token instead of comparing against every name.
+/// The usage text is also rendered once here, so the usage functions only need to copy it.
+/// Should be called once at startup, before the definition is used for parsing.
+/// @param definition the definition to compile
+/// @return negative on error
+int clashDefinitionCompile(ClashDefinition* definition)
 {
-    if (state->command == 0) {
-        return -2;
+    if (definition->index != 0) {
+        return 0;
     }
 
-    if (state->command->subCommands == 0) {
-        return -4;
+    ClashIndex* index = tc_malloc_type(ClashIndex);
+    int errorCode = clashIndexInit(index, definition);
+    if (errorCode < 0) {
+        tc_free(index);
+        return errorCode;
     }
 
-    int foundIndex = clashCommandFindSubCommand(state->command, commandName);
-    if (foundIndex < 0) {
-        return -5;
-    }
+    index->scratchOctetCount
+        = scratchOctetCountForCommands(definition->commands, definition->commandCount)
+        + CLASH_SCRATCH_ALIGNMENT;
+    index->hasListOptions
+        = commandsHaveListOptions(definition->commands, definition->commandCount);
 
-    const ClashCommand* foundCommand = &state->command->subCommands[foundIndex];
+    errorCode = clashUsageRender(index, definition);
+    if (errorCode < 0) {
+        clashIndexDestroy(index);
+        tc_free(index);
+        return errorCode;
+    }
 
-    selectCommand(state, foundCommand);
+    definition->index = index;
 
-    return 00;
+    return 0;
 }
 
-static int parseOption(ClashState* state, const char* s, size_t len)
+/// Lets clashParseString() reuse the result of recently parsed lines, see ClashParseCache.
+/// The cache is mutated by every clashParseString() call, so it must only be enabled when the
+/// definition is used from a single thread. The other parse functions do not use it.
+/// @param definition the definition
+/// @param maxOctetCount memory cap for the cached lines
+/// @return negative on error
+int clashDefinitionEnableParseCache(ClashDefinition* definition, size_t maxOctetCount)
 {
-    int errorCode = 0;
-    if (len >= 2 && s[0] == '-') {
-        errorCode = parseNameOption(state, &s[1]);
-    } else {
-        for (size_t optionIndex = 0; optionIndex < len; ++optionIndex) {
-            errorCode = parseShortOption(state, s[optionIndex]);
-            if (errorCode < 0) {
-                return errorCode;
-            }
-        }
+    if (definition->parseCache != 0) {
+        return 0;
     }
 
-    return errorCode;
-}
-
-static int parseOptionSetCommandIfNeeded(
-    ClashState* state, const ClashDefinition* definition, const char* s, size_t len)
-{
-    if (state->command == 0) {
-        selectCommand(state, &definition->commands[0]);
+    ClashParseCache* cache = tc_malloc_type(ClashParseCache);
+    int errorCode = clashParseCacheInit(cache, maxOctetCount);
+    if (errorCode < 0) {
+        tc_free(cache);
+        return errorCode;
     }
+    definition->parseCache = cache;
 
-    return parseOption(state, s, len);
-}
-
-static void clashStateInit(struct ClashState* state)
-{
-    tc_mem_clear_type(state);
+    return 0;
 }
 
-static uint64_t toUInt64(const char* s)
+/// Appends every command that is executed to the history, so production traffic can be replayed
+/// later with clashHistoryReplay(). That includes commands executed from a ClashCompiledCommand,
+/// the parse cache, a worker thread of ClashAsync, and binary commands, which are recorded as
+/// `--name=value` tokens. A command is recorded after its ClashFn has returned.
+/// Must be called after clashDefinitionCompile() and before the definition is used for parsing.
+/// @param definition the compiled definition
+/// @param history the history to append to, or NULL to stop recording
+/// @return negative if the definition is not compiled
+int clashDefinitionSetHistory(ClashDefinition* definition, ClashHistory* history)
 {
-    int base = 10;
-    if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
-        base = 16;
-        s += 2;
+    if (definition->index == 0) {
+        return -1;
     }
+    definition->index->history = history;
 
-    return tc_str_to_uint64(s, base);
+    return 0;
 }
 
-static void* convertToStruct(const ClashCommand* command, const ClashStructValues* values)
+/// Frees the index created by clashDefinitionCompile() and the parse cache, if enabled
+/// @param definition the compiled definition
+void clashDefinitionDestroy(ClashDefinition* definition)
 {
-    uint8_t* data = tc_malloc(command->structSize);
-    for (size_t i = 0; i < command->optionCount; ++i) {
-        const ClashOption* option = &command->options[i];
-        void* p = (void*)(data + option->structOffset);
-        const ClashStructValue* item = &values->values[i];
-        const char* value = item->value;
-        if (i == 0 && value == 0) {
-            return data;
-        }
+    if (definition->parseCache != 0) {
+        clashParseCacheDestroy(definition->parseCache);
+        tc_free(definition->parseCache);
+        definition->parseCache = 0;
+    }
 
-        switch (option->type & 0x7) {
-        case ClashTypeBool:
-            *((bool*)p) = item->count != 0;
-            break;
-        case ClashTypeInt:
-            *((int*)p) = atoi(value);
-            break;
-        case ClashTypeUInt64:
-            *((uint64_t*)p) = toUInt64(value);
-            break;
-        case ClashTypeString:
-            *((const char**)p) = value;
-            break;
-        case ClashTypeFlag:
-            *((int*)p) = item->count;
-            break;
-        }
+    if (definition->index == 0) {
+        return;
     }
 
-    return data;
+    ClashIndex* index = definition->index;
+    clashIndexDestroy(index);
+    tc_free(index);
+    definition->index = 0;
 }
 
-int clashParse(const ClashDefinition* definition, const char** argv, int argc, void* userData,
-    FldOutStream* responseStream)
+static int parseStringResponse(const ClashDefinition* definition, const char* s, void* userData,
+    ClashResponse* response, ClashScratch* scratch, ClashParseError* error)
 {
     ClashState state;
-    clashStateInit(&state);
-    int errorCode;
-    for (size_t i = 0; i < (size_t)argc; ++i) {
-        const char* s = argv[i];
-        if (s == 0) {
-            return -2;
-        }
-        size_t len = strlen(s);
+    clashStateInit(&state, definition, scratch, 0);
 
-        if (len != 0 && s[0] == '-') {
-            if (state.nameOption != 0) {
-                printf("expected named option value");
-                return -6;
-            }
-            errorCode = parseOptionSetCommandIfNeeded(&state, definition, &s[1], len - 1);
-            if (errorCode < 0) {
-                return errorCode;
-            }
-        } else {
-            if (state.nameOption != 0) {
-                errorCode = parseNameOptionValue(&state, s);
-                if (errorCode < 0) {
-                    return errorCode;
-                }
-            } else if (state.command == 0) {
-                const ClashCommand* foundCommand = clashDefFindCommand(definition, s);
-                if (foundCommand == 0) {
-                    return -4;
-                }
-                selectCommand(&state, foundCommand);
-            } else {
-                if (state.command->subCommands != 0) {
-                    errorCode = parseSubCommand(&state, s);
-                    if (errorCode < 0) {
-                        return errorCode;
-                    }
-                } else {
-                    errorCode = parseArg(&state, s);
-                    if (errorCode < 0) {
-                        return errorCode;
-                    }
-                }
-            }
-        }
+    int result = clashStateFeedLine(&state, s, s + tc_strlen(s));
+    if (result >= 0) {
+        result = clashStateDispatchResponse(&state, userData, response);
     }
 
-#if defined CLASH_DEBUG_OUTPUT
+    clashScratchRewind(scratch, state.scratchMark);
+    if (error != 0) {
+        *error = state.error;
+    }
 
-    valuesDebugOutput(&state.values, state.command);
+    return result;
+}
 
-#endif
+/// Parses and executes a command line without copying it and without using the heap.
+/// Tokens are views into the string, strings are only copied to the scratch when a
+/// ClashTypeString field needs a zero terminator.
+/// @param definition the definition to parse against
+/// @param s the command line
+/// @param userData passed to the ClashFn
+/// @param responseStream the response output
+/// @param scratch temporary memory, should have at least clashDefinitionScratchOctetCount()
+/// plus the string length plus one free, and clashDefinitionListOctetCount() for list options
+/// @param error optional, receives the details if the parse fails
+/// @return negative on error
+int clashParseStringEx(const ClashDefinition* definition, const char* s, void* userData,
+    FldOutStream* responseStream, ClashScratch* scratch, ClashParseError* error)
+{
     ClashResponse response;
-    response.outStream = responseStream;
-    tingeStateInit(&response.tintState, responseStream);
+    clashResponseInit(&response, responseStream);
 
-    if (state.command && state.command->fn) {
-        void* structData = convertToStruct(state.command, &state.values);
-        state.command->fn(userData, structData, &response);
-        tc_free((void*)structData);
+    int result = parseStringResponse(definition, s, userData, &response, scratch, error);
+    if (result >= 0) {
+        fldOutStreamWriteUInt8(responseStream, 0);
     }
 
-    clashResponseResetColor(&response);
-    fldOutStreamWriteUInt8(responseStream, 0);
+    return result;
+}
 
-    return 0;
+/// Like clashParseStringEx(), but the response grows into pooled chunks as needed instead of a
+/// fixed stream. No zero terminator is written, the chunks hold only the response text.
+/// @param definition the definition to parse against
+/// @param s the command line
+/// @param userData passed to the ClashFn
+/// @param chunks receives the response, appended after anything already in it
+/// @param scratch temporary memory, see clashParseStringEx()
+/// @param error optional, receives the details if the parse fails
+/// @return negative on error
+int clashParseStringChunked(const ClashDefinition* definition, const char* s, void* userData,
+    ClashResponseChunks* chunks, ClashScratch* scratch, ClashParseError* error)
+{
+    ClashResponse response;
+    clashResponseInitChunks(&response, chunks);
+
+    return parseStringResponse(definition, s, userData, &response, scratch, error);
 }
 
 int clashParseString(
     const ClashDefinition* definition, const char* s, void* userData, FldOutStream* responseStream)
 {
-    char temp[512];
-    const char* tempArgs[512];
-    int countFound = clashSplitString(s, temp, 512, tempArgs, 512);
-    if (countFound < 0) {
-        return countFound;
+    if (definition->parseCache != 0) {
+        return clashParseCacheExecute(definition->parseCache, definition, s, userData,
+            responseStream, 0);
     }
 
-    return clashParse(definition, tempArgs, countFound, userData, responseStream);
-}
+    uint8_t stackMemory[CLASH_PARSE_SCRATCH_OCTETS];
+    ClashScratch scratch;
+    size_t length = tc_strlen(s);
+    size_t octetCount = clashDefinitionScratchOctetCount(definition) + length + 1
+        + clashDefinitionListOctetCount(definition, length / 2 + 1);
+    uint8_t* heapMemory = initScratch(&scratch, stackMemory, octetCount);
 
-static int isWhitespace(const char ch)
-{
-    return (ch == ' ' || ch == 9);
-}
+    int result = clashParseStringEx(definition, s, userData, responseStream, &scratch, 0);
 
-static const char* skipWhitespace(const char* s, int* wasEnd)
-{
-    const char* p = s;
-    while (*p != 0) {
-        if (!isWhitespace(*p)) {
-            *wasEnd = 0;
-            return p;
-        }
-        p++;
-    }
+    tc_free(heapMemory);
 
-    *wasEnd = 1;
-    return p;
+    return result;
 }
 
-static const char* skipToWhitespace(const char* s, int* wasEnd)
+/// Splits the string into token views pointing into the original string. Nothing is copied.
+/// @param s the string to split
+/// @param length octet count of the string
+/// @param out receives the tokens
+/// @param maxCount maximum number of tokens
+/// @return number of tokens, -1 for an unterminated quotation and -2 if there are too many tokens
+int clashSplitStringViews(const char* s, size_t length, ClashStringView* out, size_t maxCount)
 {
-    const char* p = s;
-    while (*p != 0) {
-        if (isWhitespace(*p)) {
-            *wasEnd = 0;
-            return p;
+    const char* cursor = s;
+    const char* end = s + length;
+    size_t count = 0;
+
+    while (1) {
+        ClashStringView token;
+        int found = clashTokenizerNext(&cursor, end, &token);
+        if (found == 0) {
+            break;
         }
-        p++;
-    }
-
-    *wasEnd = 1;
-    return p;
-}
-
-static const char* skipToQuotation(const char* s, int* wasEnd)
-{
-    const char* p = s;
-    while (*p != 0) {
-        if (*p == '\"') {
-            *wasEnd = 0;
-            return p;
+        if (found < 0) {
+            return -1;
         }
-        p++;
+        if (count >= maxCount) {
+            return -2;
+        }
+        out[count++] = token;
     }
 
-    *wasEnd = 1;
-    return p;
+    return (int)count;
 }
 
+/// Splits the string into zero terminated copies of each token, stored in temp.
+/// @param s the zero terminated string to split
+/// @param temp receives the token copies
+/// @param maxCount octet count of temp
+/// @param out receives pointers into temp
+/// @param arrayCount maximum number of tokens
+/// @return number of tokens, -1 for an unterminated quotation, -2 if there are too many tokens
+/// and -3 if temp is too small
 int clashSplitString(
     const char* s, char* temp, size_t maxCount, const char** out, size_t arrayCount)
 {
-    (void)maxCount;
-
+    const char* cursor = s;
+    const char* end = s + tc_strlen(s);
     char* p = temp;
-
-    int wasEnd = 0;
-
-    const char* source = s;
+    char* tempEnd = temp + maxCount;
     int index = 0;
 
-    while (!wasEnd) {
-        const char* start = skipWhitespace(source, &wasEnd);
-        if (wasEnd) {
+    while (1) {
+        ClashStringView token;
+        int found = clashTokenizerNext(&cursor, end, &token);
+        if (found == 0) {
             break;
         }
-
-        source = start;
-        const char* end;
-        if (*source == '\"') {
-            source++;
-            start++;
-            end = skipToQuotation(source, &wasEnd);
-            if (wasEnd) {
-                return -1;
-            }
-            source = end + 1;
-        } else {
-            end = skipToWhitespace(source, &wasEnd);
-            source = end;
+        if (found < 0) {
+            return -1;
         }
-        size_t count = (size_t)(end - start);
-        tc_memcpy_octets(p, start, count);
         if (index >= (int)arrayCount) {
             return -2;
         }
+        if ((size_t)(tempEnd - p) < token.length + 2) {
+            return -3;
+        }
+        tc_memcpy_octets(p, token.str, token.length);
         out[index++] = p;
-        p += count;
+        p += token.length;
         *p = 0;
         p++;
     }
 
+    if (p == tempEnd) {
+        return -3;
+    }
     *p = 0;
 
     return index;
 }
-
-static void insertIndentation(FldOutStream* stream, size_t indentation)
-{
-    for (size_t i = 0; i < indentation; ++i) {
-        fldOutStreamWrites(stream, "    ");
-    }
-}
-
-static void usageCommand(FldOutStream* stream, const struct ClashCommand* cmd, size_t indentation)
-{
-    fldOutStreamWritef(stream, "\n");
-    insertIndentation(stream, indentation);
-    fldOutStreamWritef(stream, "%s", cmd->name);
-    if (cmd->subCommands != 0) {
-        fldOutStreamWritef(stream, "\n");
-        for (size_t i = 0; i < cmd->subCommandsCount; ++i) {
-            const ClashCommand* subCommand = &cmd->subCommands[i];
-            usageCommand(stream, subCommand, indentation + 1);
-        }
-        return;
-    }
-
-    for (size_t i = 0; i < cmd->optionCount; ++i) {
-        const ClashOption* option = &cmd->options[i];
-        if (option->type & ClashTypeArg) {
-            fldOutStreamWritef(stream, " [%s]", option->name);
-        } else {
-            fldOutStreamWritef(stream, " [options]");
-            break;
-        }
-    }
-
-    fldOutStreamWritef(stream, "\n");
-
-    for (size_t j = 0; j < cmd->optionCount; ++j) {
-        insertIndentation(stream, indentation + 1);
-        const ClashOption* option = &cmd->options[j];
-        if (option->type & ClashTypeArg) {
-            fldOutStreamWritef(stream, "   %-10s", option->name);
-        } else {
-            if (option->shortName != ' ' && option->shortName != 0) {
-                fldOutStreamWritef(stream, "   -%c", option->shortName);
-            }
-
-            if (option->name != 0) {
-                fldOutStreamWritef(stream, "   --%s", option->name);
-            }
-        }
-        if (option->value != 0 && tc_strlen(option->value) > 0) {
-            fldOutStreamWritef(stream, " default: '%s'", option->value);
-        }
-
-        fldOutStreamWritef(stream, "   %s\n", option->description);
-    }
-}
-
-void clashUsageToStream(const ClashDefinition* definition, FldOutStream* outStream)
-{
-    for (size_t i = 0; i < definition->commandCount; ++i) {
-        ClashCommand* cmd = &definition->commands[i];
-        usageCommand(outStream, cmd, 0);
-    }
-
-    fldOutStreamWriteUInt8(outStream, 0);
-}
-
-const char* clashUsage(const ClashDefinition* definition, char* buf, size_t maxCount)
-{
-    FldOutStream outStream;
-    fldOutStreamInit(&outStream, (uint8_t*)buf, maxCount);
-
-    clashUsageToStream(definition, &outStream);
-
-    return buf;
-}
@@ -0,0 +1,123 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clash/clash.h>
+#include <clash/compiled.h>
+#include <clash/response.h>
+#include <clash/response_chunks.h>
+#include <clash/scratch.h>
+#include <clash/state.h>
+#include <tiny-libc/tiny_libc.h>
+
+/// The line, the values and the converted struct all live in one allocation after the header, so
+/// every string and view in the struct stays valid for as long as the compiled command. The call
+/// keeps the line, so every execution is recorded to the history like a parsed line.
+struct ClashCompiledCommand {
+    ClashCall call;
+    ClashScratch scratch;
+};
+
+static size_t headerOctetCount(void)
+{
+    return (sizeof(ClashCompiledCommand) + CLASH_SCRATCH_ALIGNMENT - 1)
+        & ~(size_t)(CLASH_SCRATCH_ALIGNMENT - 1);
+}
+
+/// Parses a command line once. The selected command and its converted struct are kept, so
+/// clashExecuteCompiled() only has to call the ClashFn.
+/// @param definition the definition, must outlive the compiled command
+/// @param line the command line, it is copied
+/// @param error optional, receives the details if the parse fails
+/// @return the compiled command or NULL on error
+ClashCompiledCommand* clashCompileCommand(
+    const ClashDefinition* definition, const char* line, ClashParseError* error)
+{
+    size_t lineLength = tc_strlen(line);
+    size_t scratchOctetCount = lineLength + 1 + clashDefinitionScratchOctetCount(definition)
+        + lineLength + 1 + clashDefinitionListOctetCount(definition, lineLength / 2 + 1);
+    uint8_t* memory = tc_malloc(headerOctetCount() + scratchOctetCount);
+    if (memory == 0) {
+        clashParseErrorSet(
+            error, ClashParseErrorKindScratchExhausted, -7, 0, 0, line, lineLength, 0);
+        return 0;
+    }
+
+    ClashCompiledCommand* self = (ClashCompiledCommand*)memory;
+    clashScratchInit(&self->scratch, memory + headerOctetCount(), scratchOctetCount);
+
+    char* lineCopy = clashScratchAllocOctets(&self->scratch, lineLength + 1);
+    tc_memcpy_octets(lineCopy, line, lineLength + 1);
+
+    ClashState state;
+    clashStateInit(&state, definition, &self->scratch, 0);
+
+    void* structData = 0;
+    int result = clashStateFeedLine(&state, lineCopy, lineCopy + lineLength);
+    if (result >= 0) {
+        result = clashStateConvert(&state, &structData);
+    }
+
+    if (error != 0) {
+        *error = state.error;
+        // Point into the caller's line, the copy is freed below. Defaults point into the
+        // definition and are kept as is.
+        if (error->found >= lineCopy && error->found <= lineCopy + lineLength) {
+            error->found = line + (error->found - lineCopy);
+        }
+    }
+
+    if (result < 0) {
+        tc_free(memory);
+        return 0;
+    }
+
+    ClashCall call
+        = { state.index, state.nodeIndex, state.command, structData, 0, 1, state.text };
+    self->call = call;
+
+    return self;
+}
+
+/// Calls the ClashFn of the compiled command with the struct converted at compile time.
+/// The same compiled command can be executed from several threads at the same time.
+/// @param self the compiled command
+/// @param userData passed to the ClashFn
+/// @param responseStream the response output
+/// @return negative on error
+int clashExecuteCompiled(
+    const ClashCompiledCommand* self, void* userData, struct FldOutStream* responseStream)
+{
+    clashCall(&self->call, userData, responseStream);
+
+    return 0;
+}
+
+/// Calls the ClashFn of the compiled command, with the response growing into pooled chunks.
+/// No zero terminator is written.
+/// @param self the compiled command
+/// @param userData passed to the ClashFn
+/// @param chunks receives the response, appended after anything already in it
+/// @return negative on error
+int clashExecuteCompiledChunked(
+    const ClashCompiledCommand* self, void* userData, ClashResponseChunks* chunks)
+{
+    ClashResponse response;
+    clashResponseInitChunks(&response, chunks);
+    clashCallResponse(&self->call, userData, &response);
+
+    return 0;
+}
+
+/// Frees the compiled command
+/// @param self the compiled command, can be NULL
+void clashCompiledCommandDestroy(ClashCompiledCommand* self)
+{
+    tc_free(self);
+}
+
+/// The octet count of the single allocation holding the compiled command
+size_t clashCompiledCommandOctetCount(const ClashCompiledCommand* self)
+{
+    return headerOctetCount() + self->scratch.capacity;
+}
@@ -0,0 +1,278 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clash/clash.h>
+#include <clash/complete.h>
+#include <clash/index.h>
+#include <clash/scan.h>
+#include <clash/scratch.h>
+#include <clash/state.h>
+#include <clash/tokenizer.h>
+#include <string.h>
+#include <tiny-libc/tiny_libc.h>
+
+#if !defined CLASH_COMPLETE_SCRATCH_OCTETS
+#define CLASH_COMPLETE_SCRATCH_OCTETS CLASH_PARSE_SCRATCH_OCTETS
+#endif
+
+typedef struct Candidates {
+    ClashCompletion* items;
+    size_t maxCount;
+    size_t count;
+} Candidates;
+
+static void addCandidate(
+    Candidates* self, ClashCompletionKind kind, const char* text, size_t length)
+{
+    if (length == 0) {
+        return;
+    }
+
+    if (self->count < self->maxCount) {
+        ClashCompletion* item = &self->items[self->count];
+        item->kind = kind;
+        item->text = text;
+        item->length = length;
+    }
+    self->count++;
+}
+
+static int startsWith(const char* name, size_t nameLength, const char* prefix, size_t length)
+{
+    return nameLength >= length && memcmp(name, prefix, length) == 0;
+}
+
+static void addIfPrefix(Candidates* self, ClashCompletionKind kind, const char* name,
+    const char* prefix, size_t length)
+{
+    if (name == 0) {
+        return;
+    }
+
+    size_t nameLength = tc_strlen(name);
+    if (startsWith(name, nameLength, prefix, length)) {
+        addCandidate(self, kind, name, nameLength);
+    }
+}
+
+static void addSorted(Candidates* self, ClashCompletionKind kind, const ClashIndexName* names,
+    size_t count, const char* prefix, size_t length)
+{
+    size_t first;
+    size_t matchCount = clashIndexFindPrefix(names, count, prefix, length, &first);
+    for (size_t i = 0; i < matchCount; ++i) {
+        addCandidate(self, kind, names[first + i].name, names[first + i].length);
+    }
+}
+
+static void completeChoices(
+    Candidates* self, const ClashOption* option, const char* word, size_t length)
+{
+    if (option->choices == 0) {
+        return;
+    }
+
+    for (const char* const* choice = option->choices; *choice != 0; ++choice) {
+        addIfPrefix(self, ClashCompletionKindChoice, *choice, word, length);
+    }
+}
+
+/// The command that options are parsed for, the first command if no command is selected yet,
+/// the same as the parser does.
+static const ClashCommand* optionCommand(const ClashState* state, size_t* nodeIndex)
+{
+    if (state->command != 0) {
+        *nodeIndex = state->nodeIndex;
+        return state->command;
+    }
+
+    *nodeIndex = state->index != 0 ? state->index->nodes[CLASH_INDEX_ROOT].childStart : 0;
+
+    return &state->definition->commands[0];
+}
+
+static void completeLongOptions(
+    Candidates* self, const ClashState* state, const char* word, size_t length)
+{
+    size_t nodeIndex;
+    const ClashCommand* command = optionCommand(state, &nodeIndex);
+
+    if (state->index != 0) {
+        const ClashIndexNode* node = &state->index->nodes[nodeIndex];
+        addSorted(self, ClashCompletionKindLongOption,
+            &state->index->sortedOptionNames[node->optionStart], command->optionCount, word,
+            length);
+        return;
+    }
+
+    for (size_t i = 0; i < command->optionCount; ++i) {
+        addIfPrefix(self, ClashCompletionKindLongOption, command->options[i].name, word, length);
+    }
+}
+
+static void completeShortOptions(Candidates* self, const ClashState* state)
+{
+    size_t nodeIndex;
+    const ClashCommand* command = optionCommand(state, &nodeIndex);
+
+    for (size_t i = 0; i < command->optionCount; ++i) {
+        const ClashOption* option = &command->options[i];
+        if (option->shortName != 0 && option->shortName != ' ') {
+            addCandidate(self, ClashCompletionKindShortOption, &option->shortName, 1);
+        }
+    }
+}
+
+static void completeCommands(
+    Candidates* self, const ClashState* state, const char* word, size_t length)
+{
+    if (state->index != 0) {
+        const ClashIndexNode* node = &state->index->nodes[state->nodeIndex];
+        addSorted(self, ClashCompletionKindCommand,
+            &state->index->sortedChildNames[node->childStart], node->childCount, word, length);
+        return;
+    }
+
+    const ClashCommand* commands = state->definition->commands;
+    size_t commandCount = state->definition->commandCount;
+    if (state->command != 0) {
+        commands = state->command->subCommands;
+        commandCount = state->command->subCommandsCount;
+    }
+    for (size_t i = 0; i < commandCount; ++i) {
+        addIfPrefix(self, ClashCompletionKindCommand, commands[i].name, word, length);
+    }
+}
+
+static void completeWord(
+    Candidates* self, const ClashState* state, const char* word, size_t length)
+{
+    if (state->nameOption != 0) {
+        completeChoices(self, state->nameOption, word, length);
+    } else if (length >= 2 && word[0] == '-' && word[1] == '-') {
+        completeLongOptions(self, state, word + 2, length - 2);
+    } else if (length == 1 && word[0] == '-') {
+        completeShortOptions(self, state);
+        completeLongOptions(self, state, "", 0);
+    } else if (length != 0 && word[0] == '-') {
+        // Bundled short options are already complete
+        return;
+    } else if (state->command == 0 || state->command->subCommands != 0) {
+        completeCommands(self, state, word, length);
+    } else if (state->argIndex < (int)state->command->optionCount) {
+        const ClashOption* arg = &state->command->options[state->argIndex];
+        if (arg->type & ClashTypeArg) {
+            completeChoices(self, arg, word, length);
+        }
+    }
+}
+
+static int feedPrecedingWords(ClashState* state, const char* line, size_t cursor,
+    const char** word, size_t* wordLength)
+{
+    const char* p = line;
+    const char* end = line + cursor;
+    ClashStringView previous = { 0, 0 };
+    int hasPrevious = 0;
+
+    while (1) {
+        ClashStringView token;
+        int found = clashTokenizerNext(&p, end, &token);
+        if (found < 0) {
+            return -1;
+        }
+        if (found == 0) {
+            break;
+        }
+        if (hasPrevious && clashStateFeed(state, previous.str, previous.length) < 0) {
+            return -1;
+        }
+        previous = token;
+        hasPrevious = 1;
+    }
+
+    // A word that is followed by whitespace is complete, so a new word starts at the cursor
+    int isNewWord = cursor == 0 || clashScanSkipWhitespace(end - 1, end) == end;
+    if (hasPrevious && isNewWord && clashStateFeed(state, previous.str, previous.length) < 0) {
+        return -1;
+    }
+
+    if (!hasPrevious || isNewWord) {
+        *word = end;
+        *wordLength = 0;
+    } else {
+        *word = previous.str;
+        *wordLength = previous.length;
+    }
+
+    return 0;
+}
+
+/// For a `--name=value` word, feeds the `--name` part so only the value is completed.
+static int splitOptionValue(ClashState* state, const char** word, size_t* wordLength)
+{
+    if (*wordLength < 2 || (*word)[0] != '-' || (*word)[1] != '-' || state->nameOption != 0) {
+        return 0;
+    }
+
+    const char* equals = memchr(*word, '=', *wordLength);
+    if (equals == 0) {
+        return 0;
+    }
+    if (clashStateFeed(state, *word, (size_t)(equals - *word)) < 0) {
+        return -1;
+    }
+    *wordLength -= (size_t)(equals + 1 - *word);
+    *word = equals + 1;
+
+    return 0;
+}
+
+/// Finds the commands, options or option values that can complete the word at the cursor.
+/// The words before it are parsed like clashParseString() does, but nothing is executed.
+/// @param definition the definition, the sorted names of a compiled definition are used if present
+/// @param line the command line
+/// @param cursor octet offset of the cursor in line, everything after it is ignored
+/// @param candidates receives the first maxCount candidates, in sorted order if compiled
+/// @param maxCount maximum number of candidates to store
+/// @param wordStart receives the octet offset in line of the word that is replaced by a candidate
+/// @return total number of candidates, can be more than maxCount, or negative on error
+int clashComplete(const ClashDefinition* definition, const char* line, size_t cursor,
+    ClashCompletion* candidates, size_t maxCount, size_t* wordStart)
+{
+    uint8_t stackMemory[CLASH_COMPLETE_SCRATCH_OCTETS];
+    uint8_t* heapMemory = 0;
+    size_t octetCount = clashDefinitionScratchOctetCount(definition)
+        + clashDefinitionListOctetCount(definition, cursor / 2 + 1);
+    ClashScratch scratch;
+
+    if (octetCount <= CLASH_COMPLETE_SCRATCH_OCTETS) {
+        clashScratchInit(&scratch, stackMemory, CLASH_COMPLETE_SCRATCH_OCTETS);
+    } else {
+        heapMemory = tc_malloc(octetCount);
+        if (heapMemory == 0) {
+            return -7;
+        }
+        clashScratchInit(&scratch, heapMemory, octetCount);
+    }
+
+    ClashState state;
+    clashStateInit(&state, definition, &scratch, ClashStateFlagCompleting);
+
+    const char* word;
+    size_t wordLength;
+    Candidates found = { candidates, maxCount, 0 };
+    *wordStart = cursor;
+
+    // Nothing can be completed after an unterminated quote or a word that does not parse
+    if (feedPrecedingWords(&state, line, cursor, &word, &wordLength) == 0
+        && splitOptionValue(&state, &word, &wordLength) == 0) {
+        *wordStart = (size_t)(word - line);
+        completeWord(&found, &state, word, wordLength);
+    }
+
+    tc_free(heapMemory);
+
+    return (int)found.count;
+}
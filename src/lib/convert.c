@@ -0,0 +1,553 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clash/clash.h>
+#include <clash/convert.h>
+#include <errno.h>
+#include <limits.h>
+#include <locale.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tiny-libc/tiny_libc.h>
+
+#define CLASH_CONVERT_DOUBLE_MAX_OCTETS (128)
+
+/// The value of each digit character plus one, zero for everything that is not a digit.
+/// Letters are valid for all bases, the caller compares the value against the base.
+static const uint8_t g_digitValues[256] = {
+    ['0'] = 1,
+    ['1'] = 2,
+    ['2'] = 3,
+    ['3'] = 4,
+    ['4'] = 5,
+    ['5'] = 6,
+    ['6'] = 7,
+    ['7'] = 8,
+    ['8'] = 9,
+    ['9'] = 10,
+    ['a'] = 11,
+    ['b'] = 12,
+    ['c'] = 13,
+    ['d'] = 14,
+    ['e'] = 15,
+    ['f'] = 16,
+    ['A'] = 11,
+    ['B'] = 12,
+    ['C'] = 13,
+    ['D'] = 14,
+    ['E'] = 15,
+    ['F'] = 16,
+};
+
+static unsigned digitValue(char c)
+{
+    // Wraps around to UINT_MAX for anything that is not a digit, so one compare against the base
+    // rejects it
+    return (unsigned)g_digitValues[(uint8_t)c] - 1u;
+}
+
+/// Parses digits in the base, with `_` allowed between two digits.
+static int parseDigits(const char* s, const char* end, unsigned base, uint64_t* out)
+{
+    if (s == end) {
+        return CLASH_CONVERT_INVALID;
+    }
+
+    const uint64_t limit = UINT64_MAX / base;
+    uint64_t value = 0;
+    int overflow = 0;
+    int previousWasDigit = 0;
+
+    for (; s != end; ++s) {
+        unsigned digit = digitValue(*s);
+        if (digit >= base) {
+            if (*s != '_' || !previousWasDigit || s + 1 == end) {
+                return CLASH_CONVERT_INVALID;
+            }
+            previousWasDigit = 0;
+            continue;
+        }
+        // Keep going on overflow, garbage later in the string is reported as invalid
+        overflow |= value > limit;
+        value *= base;
+        overflow |= value > UINT64_MAX - digit;
+        value += digit;
+        previousWasDigit = 1;
+    }
+
+    *out = value;
+
+    return overflow ? CLASH_CONVERT_OVERFLOW : 0;
+}
+
+/// Parses an unsigned magnitude with an optional `0x` (hexadecimal) or `0b` (binary) prefix.
+static int parseMagnitude(const char* s, const char* end, uint64_t* out)
+{
+    unsigned base = 10;
+    if (end - s >= 2 && s[0] == '0') {
+        char prefix = (char)(s[1] | 0x20);
+        if (prefix == 'x') {
+            base = 16;
+            s += 2;
+        } else if (prefix == 'b') {
+            base = 2;
+            s += 2;
+        }
+    }
+
+    return parseDigits(s, end, base, out);
+}
+
+/// Converts an unsigned number. Decimal, `0x` hexadecimal and `0b` binary are supported and
+/// digits can be separated by `_`, e.g. `1_000_000` or `0xffff_0000`.
+/// @param s the number, it does not have to be zero terminated
+/// @param length octet count of s
+/// @param out receives the number
+/// @return CLASH_CONVERT_INVALID or CLASH_CONVERT_OVERFLOW on error
+int clashConvertUInt64(const char* s, size_t length, uint64_t* out)
+{
+    const char* end = s + length;
+    if (length != 0 && s[0] == '+') {
+        s++;
+    }
+
+    return parseMagnitude(s, end, out);
+}
+
+/// Converts a signed number, with the same formats as clashConvertUInt64().
+/// @param s the number, it does not have to be zero terminated
+/// @param length octet count of s
+/// @param out receives the number
+/// @return CLASH_CONVERT_INVALID or CLASH_CONVERT_OVERFLOW on error
+int clashConvertInt64(const char* s, size_t length, int64_t* out)
+{
+    const char* end = s + length;
+    int isNegative = 0;
+    if (length != 0 && (s[0] == '-' || s[0] == '+')) {
+        isNegative = s[0] == '-';
+        s++;
+    }
+
+    uint64_t magnitude;
+    int errorCode = parseMagnitude(s, end, &magnitude);
+    if (errorCode < 0) {
+        return errorCode;
+    }
+
+    if (isNegative) {
+        if (magnitude > (uint64_t)INT64_MAX + 1u) {
+            return CLASH_CONVERT_OVERFLOW;
+        }
+        *out = magnitude == (uint64_t)INT64_MAX + 1u ? INT64_MIN : -(int64_t)magnitude;
+    } else {
+        if (magnitude > (uint64_t)INT64_MAX) {
+            return CLASH_CONVERT_OVERFLOW;
+        }
+        *out = (int64_t)magnitude;
+    }
+
+    return 0;
+}
+
+/// Converts a signed number that must fit in an int.
+/// @return CLASH_CONVERT_INVALID or CLASH_CONVERT_OVERFLOW on error
+int clashConvertInt(const char* s, size_t length, int* out)
+{
+    int64_t value;
+    int errorCode = clashConvertInt64(s, length, &value);
+    if (errorCode < 0) {
+        return errorCode;
+    }
+
+    if (value < INT_MIN || value > INT_MAX) {
+        return CLASH_CONVERT_OVERFLOW;
+    }
+    *out = (int)value;
+
+    return 0;
+}
+
+static const double g_exactPowersOfTen[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+    1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+/// Converts with strtod(), which follows LC_NUMERIC. The point is written as the decimal point of
+/// the current locale, so the number means the same whatever locale the program has set.
+static int convertDoubleSlow(const char* s, const char* end, double* out)
+{
+    const char* decimalPoint = localeconv()->decimal_point;
+    size_t decimalPointLength = tc_strlen(decimalPoint);
+    char copy[CLASH_CONVERT_DOUBLE_MAX_OCTETS];
+    size_t count = 0;
+    for (; s != end; ++s) {
+        if (*s == '_') {
+            continue;
+        }
+        if (*s == '.') {
+            if (count + decimalPointLength >= sizeof(copy)) {
+                return CLASH_CONVERT_INVALID;
+            }
+            tc_memcpy_octets(copy + count, decimalPoint, decimalPointLength);
+            count += decimalPointLength;
+            continue;
+        }
+        if (count + 1 >= sizeof(copy)) {
+            return CLASH_CONVERT_INVALID;
+        }
+        copy[count++] = *s;
+    }
+    copy[count] = 0;
+
+    errno = 0;
+    char* parsedEnd;
+    double value = strtod(copy, &parsedEnd);
+    if (parsedEnd != copy + count) {
+        return CLASH_CONVERT_INVALID;
+    }
+    if (errno == ERANGE && (value == HUGE_VAL || value == -HUGE_VAL)) {
+        return CLASH_CONVERT_OVERFLOW;
+    }
+    *out = value;
+
+    return 0;
+}
+
+/// Converts the exponent of a floating point number, decimal digits with an optional sign.
+/// @return CLASH_CONVERT_INVALID if it is not a number or too large to be a double exponent
+static int convertExponent(const char* s, const char* end, int* out)
+{
+    int isNegative = 0;
+    if (s != end && (*s == '-' || *s == '+')) {
+        isNegative = *s == '-';
+        s++;
+    }
+    if (s == end) {
+        return CLASH_CONVERT_INVALID;
+    }
+
+    int value = 0;
+    for (; s != end; ++s) {
+        unsigned digit = (unsigned)(*s - '0');
+        if (digit > 9) {
+            return CLASH_CONVERT_INVALID;
+        }
+        value = value * 10 + (int)digit;
+        if (value > 100000) {
+            return CLASH_CONVERT_INVALID;
+        }
+    }
+    *out = isNegative ? -value : value;
+
+    return 0;
+}
+
+/// Converts a decimal floating point number, e.g. `-12.5`, `1e-3` or `1_000.25`.
+/// Numbers with at most 15 significant digits and a small exponent are converted exactly without
+/// involving the C library. Anything else falls back to strtod(), with the point translated to
+/// the decimal point of the locale.
+/// @param s the number, it does not have to be zero terminated
+/// @param length octet count of s
+/// @param out receives the number
+/// @return CLASH_CONVERT_INVALID or CLASH_CONVERT_OVERFLOW on error
+int clashConvertDouble(const char* s, size_t length, double* out)
+{
+    const char* start = s;
+    const char* end = s + length;
+    int isNegative = 0;
+    if (s != end && (*s == '-' || *s == '+')) {
+        isNegative = *s == '-';
+        s++;
+    }
+
+    uint64_t mantissa = 0;
+    int significantDigitCount = 0;
+    int digitCount = 0;
+    int exponent = 0;
+    int isFraction = 0;
+    int previousWasDigit = 0;
+
+    for (; s != end; ++s) {
+        unsigned digit = (unsigned)(*s - '0');
+        if (digit <= 9) {
+            if (mantissa != 0 || digit != 0) {
+                significantDigitCount++;
+            }
+            if (significantDigitCount <= 19) {
+                mantissa = mantissa * 10 + digit;
+                exponent -= isFraction;
+            } else {
+                exponent += !isFraction;
+            }
+            digitCount++;
+            previousWasDigit = 1;
+        } else if (*s == '_' && previousWasDigit && s + 1 != end) {
+            previousWasDigit = 0;
+        } else if (*s == '.' && !isFraction) {
+            isFraction = 1;
+            previousWasDigit = 0;
+        } else {
+            break;
+        }
+    }
+
+    if (digitCount == 0) {
+        return CLASH_CONVERT_INVALID;
+    }
+
+    if (s != end) {
+        if ((*s | 0x20) != 'e') {
+            return CLASH_CONVERT_INVALID;
+        }
+        int exponentValue;
+        if (convertExponent(s + 1, end, &exponentValue) < 0) {
+            return CLASH_CONVERT_INVALID;
+        }
+        exponent += exponentValue;
+    }
+
+    if (significantDigitCount > 15 || exponent > 22 || exponent < -22) {
+        return convertDoubleSlow(start, end, out);
+    }
+
+    double value = (double)mantissa;
+    value = exponent < 0 ? value / g_exactPowersOfTen[-exponent]
+                         : value * g_exactPowersOfTen[exponent];
+    *out = isNegative ? -value : value;
+
+    return 0;
+}
+
+static int durationUnit(const char* s, const char* end, const char** next, uint64_t* milliseconds)
+{
+    size_t length = (size_t)(end - s);
+    if (length >= 2 && s[0] == 'm' && s[1] == 's') {
+        *next = s + 2;
+        *milliseconds = 1;
+        return 0;
+    }
+    if (length == 0) {
+        return CLASH_CONVERT_INVALID;
+    }
+
+    *next = s + 1;
+    switch (s[0]) {
+    case 's':
+        *milliseconds = 1000u;
+        return 0;
+    case 'm':
+        *milliseconds = 60u * 1000u;
+        return 0;
+    case 'h':
+        *milliseconds = 60u * 60u * 1000u;
+        return 0;
+    case 'd':
+        *milliseconds = 24u * 60u * 60u * 1000u;
+        return 0;
+    default:
+        return CLASH_CONVERT_INVALID;
+    }
+}
+
+/// Converts a duration to milliseconds. A number without a unit is milliseconds, otherwise it is
+/// one or more numbers with the units `ms`, `s`, `m`, `h` or `d`, e.g. `250ms`, `1h30m` or `2d`.
+/// @param s the duration, it does not have to be zero terminated
+/// @param length octet count of s
+/// @param milliseconds receives the duration
+/// @return CLASH_CONVERT_INVALID or CLASH_CONVERT_OVERFLOW on error
+int clashConvertDuration(const char* s, size_t length, int64_t* milliseconds)
+{
+    const char* end = s + length;
+    int isNegative = 0;
+    if (s != end && (*s == '-' || *s == '+')) {
+        isNegative = *s == '-';
+        s++;
+    }
+
+    const char* digitsEnd = s;
+    while (digitsEnd != end && (digitValue(*digitsEnd) < 10 || *digitsEnd == '_')) {
+        digitsEnd++;
+    }
+
+    uint64_t total = 0;
+    if (digitsEnd == end) {
+        int errorCode = parseDigits(s, end, 10, &total);
+        if (errorCode < 0) {
+            return errorCode;
+        }
+    } else {
+        while (s != end) {
+            digitsEnd = s;
+            while (digitsEnd != end && (digitValue(*digitsEnd) < 10 || *digitsEnd == '_')) {
+                digitsEnd++;
+            }
+            uint64_t count;
+            int errorCode = parseDigits(s, digitsEnd, 10, &count);
+            if (errorCode < 0) {
+                return errorCode;
+            }
+            uint64_t unit;
+            errorCode = durationUnit(digitsEnd, end, &s, &unit);
+            if (errorCode < 0) {
+                return errorCode;
+            }
+            if (count > (UINT64_MAX - total) / unit) {
+                return CLASH_CONVERT_OVERFLOW;
+            }
+            total += count * unit;
+        }
+    }
+
+    if (total > (uint64_t)INT64_MAX) {
+        return CLASH_CONVERT_OVERFLOW;
+    }
+    *milliseconds = isNegative ? -(int64_t)total : (int64_t)total;
+
+    return 0;
+}
+
+static int wordEqual(const char* s, size_t length, const char* word)
+{
+    return tc_strlen(word) == length && memcmp(s, word, length) == 0;
+}
+
+/// Converts `true`, `yes`, `on`, `1`, `false`, `no`, `off` or `0`.
+/// @return CLASH_CONVERT_INVALID on error
+int clashConvertBool(const char* s, size_t length, bool* out)
+{
+    if (wordEqual(s, length, "true") || wordEqual(s, length, "yes") || wordEqual(s, length, "on")
+        || wordEqual(s, length, "1")) {
+        *out = true;
+        return 0;
+    }
+
+    if (wordEqual(s, length, "false") || wordEqual(s, length, "no") || wordEqual(s, length, "off")
+        || wordEqual(s, length, "0")) {
+        *out = false;
+        return 0;
+    }
+
+    return CLASH_CONVERT_INVALID;
+}
+
+/// Checks the value against the ClashOption bounds. The bounds are ignored when both are zero.
+/// @return CLASH_CONVERT_OUT_OF_RANGE if the value is outside the bounds
+int clashConvertCheckRange(int64_t value, int64_t minimum, int64_t maximum)
+{
+    if (minimum == 0 && maximum == 0) {
+        return 0;
+    }
+
+    return value < minimum || value > maximum ? CLASH_CONVERT_OUT_OF_RANGE : 0;
+}
+
+int clashConvertCheckRangeUInt64(uint64_t value, int64_t minimum, int64_t maximum)
+{
+    if (minimum == 0 && maximum == 0) {
+        return 0;
+    }
+
+    if (value > (uint64_t)INT64_MAX) {
+        return CLASH_CONVERT_OUT_OF_RANGE;
+    }
+
+    return clashConvertCheckRange((int64_t)value, minimum, maximum);
+}
+
+int clashConvertCheckRangeDouble(double value, int64_t minimum, int64_t maximum)
+{
+    if (minimum == 0 && maximum == 0) {
+        return 0;
+    }
+
+    return value < (double)minimum || value > (double)maximum ? CLASH_CONVERT_OUT_OF_RANGE : 0;
+}
+
+/// Checks that the value is one of the choices of a ClashOption.
+/// @param choices NULL terminated list, or NULL if every value is allowed
+/// @return CLASH_CONVERT_INVALID if the value is not one of the choices
+int clashConvertCheckChoice(const char* const* choices, const char* s, size_t length)
+{
+    if (choices == 0) {
+        return 0;
+    }
+
+    for (const char* const* choice = choices; *choice != 0; ++choice) {
+        if (wordEqual(s, length, *choice)) {
+            return 0;
+        }
+    }
+
+    return CLASH_CONVERT_INVALID;
+}
+
+/// Maps the error codes of the conversion functions to parse error kinds.
+ClashParseErrorKind clashConvertErrorKind(int errorCode)
+{
+    switch (errorCode) {
+    case CLASH_CONVERT_INVALID:
+        return ClashParseErrorKindInvalidValue;
+    case CLASH_CONVERT_OVERFLOW:
+        return ClashParseErrorKindValueOverflow;
+    case CLASH_CONVERT_OUT_OF_RANGE:
+        return ClashParseErrorKindValueOutOfRange;
+    default:
+        return ClashParseErrorKindScratchExhausted;
+    }
+}
+
+/// A human readable name of the value type of an option, used as the expected value in errors.
+/// @param type the ClashOptionType
+/// @return the name or NULL if the type has no value to convert
+const char* clashConvertTypeName(int type)
+{
+    if (type & ClashTypeBool) {
+        return "bool";
+    }
+
+    switch (type & ClashTypeMask) {
+    case ClashTypeInt:
+        return "integer";
+    case ClashTypeUInt64:
+        return "unsigned integer";
+    case ClashTypeInt64:
+        return "64 bit integer";
+    case ClashTypeDouble:
+        return "number";
+    case ClashTypeDuration:
+        return "duration";
+    default:
+        return 0;
+    }
+}
+
+/// Describes the values an option accepts, used as the expected value in errors.
+/// @param option the option
+/// @return the description or NULL
+const char* clashConvertExpectedValue(const struct ClashOption* option)
+{
+    return option->choices != 0 ? "one of the choices" : clashConvertTypeName(option->type);
+}
+
+/// Checks if a token that starts with `-`, e.g. `-12`, is a negative value for an option of the
+/// type, instead of a short option.
+/// @param type the ClashOptionType of the option waiting for a value
+/// @param s the token
+/// @param length octet count of the token
+/// @return true if the token is a negative number
+int clashConvertIsNegativeNumber(int type, const char* s, size_t length)
+{
+    if (length < 2 || s[0] != '-' || (type & ClashTypeBool)) {
+        return 0;
+    }
+
+    switch (type & ClashTypeMask) {
+    case ClashTypeInt:
+    case ClashTypeInt64:
+    case ClashTypeDouble:
+    case ClashTypeDuration:
+        return (s[1] >= '0' && s[1] <= '9') || s[1] == '.';
+    default:
+        return 0;
+    }
+}
@@ -0,0 +1,116 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clash/clash.h>
+#include <clash/footprint.h>
+#include <clash/index.h>
+#include <clash/parse_cache.h>
+#include <clash/response.h>
+#include <clash/scratch.h>
+#include <clash/state.h>
+#include <flood/out_stream.h>
+#include <tiny-libc/tiny_libc.h>
+
+static size_t stringOctetCount(const char* s)
+{
+    return s == 0 ? 0 : tc_strlen(s) + 1;
+}
+
+static void addOption(ClashDefinitionStats* stats, const ClashOption* option)
+{
+    stats->stringOctetCount += stringOctetCount(option->name)
+        + stringOctetCount(option->description) + stringOctetCount(option->value);
+    if (option->choices == 0) {
+        return;
+    }
+
+    size_t choiceCount = 0;
+    for (; option->choices[choiceCount] != 0; ++choiceCount) {
+        stats->stringOctetCount += stringOctetCount(option->choices[choiceCount]);
+    }
+    stats->tableOctetCount += sizeof(const char*) * (choiceCount + 1);
+}
+
+static void addCommands(
+    ClashDefinitionStats* stats, const ClashCommand* commands, size_t count, size_t depth)
+{
+    if (count != 0 && depth > stats->maxDepth) {
+        stats->maxDepth = depth;
+    }
+    stats->commandCount += count;
+    stats->tableOctetCount += sizeof(ClashCommand) * count;
+
+    for (size_t i = 0; i < count; ++i) {
+        const ClashCommand* command = &commands[i];
+        stats->stringOctetCount
+            += stringOctetCount(command->name) + stringOctetCount(command->description);
+        stats->optionCount += command->optionCount;
+        stats->tableOctetCount += sizeof(ClashOption) * command->optionCount;
+        if (command->optionCount > stats->maxOptionCount) {
+            stats->maxOptionCount = command->optionCount;
+        }
+        if (command->structSize > stats->maxStructSize) {
+            stats->maxStructSize = command->structSize;
+        }
+        for (size_t j = 0; j < command->optionCount; ++j) {
+            addOption(stats, &command->options[j]);
+        }
+        addCommands(stats, command->subCommands, command->subCommandsCount, depth + 1);
+    }
+}
+
+/// Measures the memory of a definition and the worst case memory needed to parse it, e.g. to
+/// choose CLASH_PARSE_SCRATCH_OCTETS for a device where the stack is small.
+/// @param definition the definition, the index and parse cache are included if it is compiled
+/// @param maxLineLength octet count of the longest line that is parsed
+/// @param stats receives the sizes
+/// @return negative on error
+int clashDefinitionStats(
+    const ClashDefinition* definition, size_t maxLineLength, ClashDefinitionStats* stats)
+{
+    tc_mem_clear_type(stats);
+    addCommands(stats, definition->commands, definition->commandCount, 1);
+
+    const ClashIndex* index = definition->index;
+    if (index != 0) {
+        stats->indexOctetCount = sizeof(ClashIndex) + index->heapOctetCount;
+    }
+    const ClashParseCache* cache = definition->parseCache;
+    if (cache != 0) {
+        stats->parseCacheOctetCount = sizeof(ClashParseCache)
+            + sizeof(ClashParseCacheEntry*) * (cache->bucketMask + 1) + cache->octetCount;
+    }
+
+    // The same sizes as clashParseString() uses
+    stats->parseScratchOctetCount = clashDefinitionScratchOctetCount(definition) + maxLineLength
+        + 1 + clashDefinitionListOctetCount(definition, maxLineLength / 2 + 1);
+    stats->parseStackOctetCount
+        = CLASH_PARSE_SCRATCH_OCTETS + sizeof(ClashScratch) + sizeof(ClashResponse)
+        + sizeof(ClashState);
+    stats->parseHeapOctetCount = stats->parseScratchOctetCount > CLASH_PARSE_SCRATCH_OCTETS
+        ? stats->parseScratchOctetCount
+        : 0;
+
+    return 0;
+}
+
+/// Writes the stats as text, one line for the definition and one for parsing.
+/// @param stats the stats from clashDefinitionStats()
+/// @param outStream the output
+/// @return negative on error
+int clashDefinitionStatsToStream(const ClashDefinitionStats* stats, FldOutStream* outStream)
+{
+    int errorCode = fldOutStreamWritef(outStream,
+        "commands:%zu options:%zu depth:%zu max options:%zu max struct:%zu strings:%zu "
+        "tables:%zu index:%zu parse cache:%zu\n",
+        stats->commandCount, stats->optionCount, stats->maxDepth, stats->maxOptionCount,
+        stats->maxStructSize, stats->stringOctetCount, stats->tableOctetCount,
+        stats->indexOctetCount, stats->parseCacheOctetCount);
+    if (errorCode < 0) {
+        return errorCode;
+    }
+
+    return fldOutStreamWritef(outStream, "parse scratch:%zu stack:%zu heap:%zu\n",
+        stats->parseScratchOctetCount, stats->parseStackOctetCount, stats->parseHeapOctetCount);
+}
@@ -0,0 +1,469 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#if !defined _WIN32
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <clash/clash.h>
+#include <clash/history.h>
+#include <clash/parse_error.h>
+#include <clash/tokenizer.h>
+#include <flood/out_stream.h>
+#include <tiny-libc/tiny_libc.h>
+
+#if defined _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#if !defined CLASH_HISTORY_MAX_ARGS
+#define CLASH_HISTORY_MAX_ARGS (64)
+#endif
+
+static uint64_t fetchAddRelaxed(uint64_t* counter, uint64_t value)
+{
+#if defined _MSC_VER
+    return (uint64_t)_InterlockedExchangeAdd64((volatile __int64*)counter, (__int64)value);
+#else
+    return __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+#endif
+}
+
+static uint64_t loadRelaxed(const uint64_t* value)
+{
+#if defined _MSC_VER
+    return *(const volatile uint64_t*)value;
+#else
+    return __atomic_load_n(value, __ATOMIC_RELAXED);
+#endif
+}
+
+static uint32_t loadAcquire(const uint32_t* value)
+{
+#if defined _MSC_VER
+    return (uint32_t)_InterlockedOr((volatile long*)(uintptr_t)value, 0);
+#else
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static void storeRelease(uint32_t* target, uint32_t value)
+{
+#if defined _MSC_VER
+    _InterlockedExchange((volatile long*)target, (long)value);
+#else
+    __atomic_store_n(target, value, __ATOMIC_RELEASE);
+#endif
+}
+
+static uint64_t nanosecondsSinceEpoch(void)
+{
+#if defined _WIN32
+    FILETIME now;
+    GetSystemTimePreciseAsFileTime(&now);
+    uint64_t intervals = ((uint64_t)now.dwHighDateTime << 32) | now.dwLowDateTime;
+
+    // FILETIME counts 100 ns intervals since 1601
+    return (intervals - 116444736000000000u) * 100u;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#endif
+}
+
+static size_t entryOctetCount(size_t argOctetCount)
+{
+    return (sizeof(ClashHistoryEntry) + argOctetCount + CLASH_HISTORY_ALIGNMENT - 1)
+        & ~(size_t)(CLASH_HISTORY_ALIGNMENT - 1);
+}
+
+#if !defined _WIN32
+
+static int mapFile(ClashHistory* self, int fileDescriptor, size_t octetCount, int isWritable)
+{
+    int protection = isWritable ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* mapping = mmap(0, octetCount, protection, MAP_SHARED, fileDescriptor, 0);
+    if (mapping == MAP_FAILED) {
+        close(fileDescriptor);
+        return -1;
+    }
+
+    self->fileDescriptor = fileDescriptor;
+    self->mapping = mapping;
+    self->mappingOctetCount = octetCount;
+    self->header = mapping;
+    self->entries = self->mapping + sizeof(ClashHistoryHeader);
+    self->isWritable = isWritable;
+
+    return 0;
+}
+
+/// Creates, or truncates, a history file and maps it, so commands can be appended.
+/// The file is created with room for capacity octets of entries and is shrunk to the octets
+/// actually used by clashHistoryClose().
+/// @param self the history
+/// @param path the file to create
+/// @param capacity octets available for entries
+/// @return negative on error
+int clashHistoryCreate(ClashHistory* self, const char* path, size_t capacity)
+{
+    tc_mem_clear_type(self);
+    self->fileDescriptor = -1;
+
+    capacity &= ~(size_t)(CLASH_HISTORY_ALIGNMENT - 1);
+    size_t octetCount = sizeof(ClashHistoryHeader) + capacity;
+
+    int fileDescriptor = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fileDescriptor < 0) {
+        return -1;
+    }
+    if (ftruncate(fileDescriptor, (off_t)octetCount) < 0) {
+        close(fileDescriptor);
+        return -1;
+    }
+    if (mapFile(self, fileDescriptor, octetCount, 1) < 0) {
+        return -1;
+    }
+
+    self->header->magic = CLASH_HISTORY_MAGIC;
+    self->header->version = CLASH_HISTORY_VERSION;
+    self->header->capacity = capacity;
+    self->header->appendOffset = 0;
+    self->header->droppedCount = 0;
+
+    return 0;
+}
+
+/// Maps an existing history file for reading, e.g. to replay it.
+/// @param self the history
+/// @param path the history file
+/// @return negative on error, CLASH_HISTORY_MALFORMED if it is not a history file
+int clashHistoryOpen(ClashHistory* self, const char* path)
+{
+    tc_mem_clear_type(self);
+    self->fileDescriptor = -1;
+
+    int fileDescriptor = open(path, O_RDONLY);
+    if (fileDescriptor < 0) {
+        return -1;
+    }
+
+    struct stat status;
+    if (fstat(fileDescriptor, &status) < 0
+        || (size_t)status.st_size < sizeof(ClashHistoryHeader)) {
+        close(fileDescriptor);
+        return CLASH_HISTORY_MALFORMED;
+    }
+    if (mapFile(self, fileDescriptor, (size_t)status.st_size, 0) < 0) {
+        return -1;
+    }
+
+    const ClashHistoryHeader* header = self->header;
+    if (header->magic != CLASH_HISTORY_MAGIC || header->version != CLASH_HISTORY_VERSION
+        || header->capacity > self->mappingOctetCount - sizeof(ClashHistoryHeader)) {
+        clashHistoryClose(self);
+        return CLASH_HISTORY_MALFORMED;
+    }
+
+    return 0;
+}
+
+/// Unmaps the history. A created history is shrunk to the entries that were appended. Must not be
+/// called while other threads can append.
+/// @param self the history
+void clashHistoryClose(ClashHistory* self)
+{
+    if (self->mapping == 0) {
+        return;
+    }
+
+    size_t usedOctetCount = 0;
+    if (self->isWritable) {
+        ClashHistoryHeader* header = self->header;
+        usedOctetCount = header->appendOffset < header->capacity ? (size_t)header->appendOffset
+                                                                 : (size_t)header->capacity;
+        header->capacity = usedOctetCount;
+        header->appendOffset = usedOctetCount;
+    }
+
+    munmap(self->mapping, self->mappingOctetCount);
+    if (self->isWritable) {
+        (void)ftruncate(self->fileDescriptor, (off_t)(sizeof(ClashHistoryHeader) + usedOctetCount));
+    }
+    close(self->fileDescriptor);
+
+    tc_mem_clear_type(self);
+    self->fileDescriptor = -1;
+}
+
+#else
+
+int clashHistoryCreate(ClashHistory* self, const char* path, size_t capacity)
+{
+    (void)path;
+    (void)capacity;
+    tc_mem_clear_type(self);
+    self->fileDescriptor = -1;
+
+    return -1;
+}
+
+int clashHistoryOpen(ClashHistory* self, const char* path)
+{
+    (void)path;
+    tc_mem_clear_type(self);
+    self->fileDescriptor = -1;
+
+    return -1;
+}
+
+void clashHistoryClose(ClashHistory* self)
+{
+    tc_mem_clear_type(self);
+    self->fileDescriptor = -1;
+}
+
+#endif
+
+/// Number of appends that were dropped because the history was full.
+uint64_t clashHistoryDroppedCount(const ClashHistory* self)
+{
+    return self->header == 0 ? 0 : loadRelaxed(&self->header->droppedCount);
+}
+
+/// Reserves room for an entry and fills in everything but octetCount.
+/// @return the entry, or NULL if the history is full
+static ClashHistoryEntry* beginEntry(
+    ClashHistory* self, size_t nodeIndex, size_t argc, size_t argOctetCount)
+{
+    if (argOctetCount > UINT32_MAX - sizeof(ClashHistoryEntry) - CLASH_HISTORY_ALIGNMENT) {
+        return 0;
+    }
+
+    size_t octetCount = entryOctetCount(argOctetCount);
+    uint64_t offset = fetchAddRelaxed(&self->header->appendOffset, octetCount);
+    if (offset + octetCount > self->header->capacity) {
+        fetchAddRelaxed(&self->header->droppedCount, 1);
+        return 0;
+    }
+
+    ClashHistoryEntry* entry = (ClashHistoryEntry*)(self->entries + offset);
+    entry->nodeIndex = (uint32_t)nodeIndex;
+    entry->timestamp = nanosecondsSinceEpoch();
+    entry->argc = (uint32_t)argc;
+    entry->argOctetCount = (uint32_t)argOctetCount;
+
+    return entry;
+}
+
+static void commitEntry(ClashHistoryEntry* entry)
+{
+    storeRelease(&entry->octetCount, (uint32_t)entryOctetCount(entry->argOctetCount));
+}
+
+/// Appends an executed command given as arguments.
+/// @param self the history
+/// @param nodeIndex the index of the command in the compiled definition
+/// @param argv the arguments, NULL arguments are recorded as empty strings
+/// @param argc number of arguments
+/// @return negative if the history is full
+int clashHistoryAppend(ClashHistory* self, size_t nodeIndex, const char** argv, int argc)
+{
+    size_t argOctetCount = 0;
+    for (int i = 0; i < argc; ++i) {
+        argOctetCount += (argv[i] == 0 ? 0 : tc_strlen(argv[i])) + 1;
+    }
+
+    ClashHistoryEntry* entry = beginEntry(self, nodeIndex, (size_t)argc, argOctetCount);
+    if (entry == 0) {
+        return -1;
+    }
+
+    char* p = (char*)(entry + 1);
+    for (int i = 0; i < argc; ++i) {
+        size_t length = 0;
+        if (argv[i] != 0) {
+            length = tc_strlen(argv[i]);
+            tc_memcpy_octets(p, argv[i], length);
+        }
+        p[length] = 0;
+        p += length + 1;
+    }
+    commitEntry(entry);
+
+    return 0;
+}
+
+/// Appends an executed command line. It is tokenized again, so the arguments are recorded the same
+/// way as for clashHistoryAppend().
+/// @param self the history
+/// @param nodeIndex the index of the command in the compiled definition
+/// @param start first character of the line
+/// @param end one past the last character of the line
+/// @return negative if the history is full or the line has an unterminated quotation
+int clashHistoryAppendLine(ClashHistory* self, size_t nodeIndex, const char* start, const char* end)
+{
+    const char* cursor = start;
+    ClashStringView token;
+    size_t argc = 0;
+    size_t argOctetCount = 0;
+    int found;
+    while ((found = clashTokenizerNext(&cursor, end, &token)) > 0) {
+        argc++;
+        argOctetCount += token.length + 1;
+    }
+    if (found < 0) {
+        return -1;
+    }
+
+    ClashHistoryEntry* entry = beginEntry(self, nodeIndex, argc, argOctetCount);
+    if (entry == 0) {
+        return -1;
+    }
+
+    char* p = (char*)(entry + 1);
+    cursor = start;
+    while (clashTokenizerNext(&cursor, end, &token) > 0) {
+        tc_memcpy_octets(p, token.str, token.length);
+        p[token.length] = 0;
+        p += token.length + 1;
+    }
+    commitEntry(entry);
+
+    return 0;
+}
+
+/// Appends an executed command whose tokens are already stored as zero terminated strings after
+/// each other, e.g. by the ClashStreamParser.
+/// @param self the history
+/// @param nodeIndex the index of the command in the compiled definition
+/// @param tokens the zero terminated tokens
+/// @param octetCount octet count of all the tokens, including the terminators
+/// @param tokenCount number of tokens
+/// @return negative if the history is full
+int clashHistoryAppendTokens(ClashHistory* self, size_t nodeIndex, const char* tokens,
+    size_t octetCount, size_t tokenCount)
+{
+    ClashHistoryEntry* entry = beginEntry(self, nodeIndex, tokenCount, octetCount);
+    if (entry == 0) {
+        return -1;
+    }
+
+    tc_memcpy_octets(entry + 1, tokens, octetCount);
+    commitEntry(entry);
+
+    return 0;
+}
+
+/// Reads the entry at offset. Reading stops at the first entry that is not completely written
+/// yet, so a history that is still being appended to can be read.
+/// @param self the history
+/// @param offset the entry to read, zero for the first one. Advanced to the next entry
+/// @param record receives the entry
+/// @return 1 if an entry was read, 0 at the end and CLASH_HISTORY_MALFORMED for a corrupt entry
+int clashHistoryNext(const ClashHistory* self, size_t* offset, ClashHistoryRecord* record)
+{
+    uint64_t appendOffset = loadRelaxed(&self->header->appendOffset);
+    uint64_t capacity = self->header->capacity;
+    size_t endOffset = (size_t)(appendOffset < capacity ? appendOffset : capacity);
+    if (*offset + sizeof(ClashHistoryEntry) > endOffset) {
+        return 0;
+    }
+
+    const ClashHistoryEntry* entry = (const ClashHistoryEntry*)(self->entries + *offset);
+    uint32_t octetCount = loadAcquire(&entry->octetCount);
+    if (octetCount == 0) {
+        return 0;
+    }
+
+    const char* args = (const char*)(entry + 1);
+    if (octetCount != entryOctetCount(entry->argOctetCount) || octetCount > endOffset - *offset
+        || (entry->argOctetCount > 0 && args[entry->argOctetCount - 1] != 0)) {
+        return CLASH_HISTORY_MALFORMED;
+    }
+
+    record->timestamp = entry->timestamp;
+    record->nodeIndex = entry->nodeIndex;
+    record->argc = entry->argc;
+    record->args = args;
+    record->argOctetCount = entry->argOctetCount;
+    *offset += octetCount;
+
+    return 1;
+}
+
+/// Points argv at each argument of a record.
+/// @param record the record
+/// @param argv receives the arguments
+/// @param maxCount maximum number of arguments
+/// @return the number of arguments, or CLASH_HISTORY_MALFORMED if they do not match the record or
+/// there are more than maxCount
+int clashHistoryRecordArgv(const ClashHistoryRecord* record, const char** argv, size_t maxCount)
+{
+    const char* p = record->args;
+    const char* end = record->args + record->argOctetCount;
+    size_t count = 0;
+    while (p != end) {
+        if (count >= maxCount) {
+            return CLASH_HISTORY_MALFORMED;
+        }
+        argv[count++] = p;
+        p += tc_strlen(p) + 1;
+    }
+
+    if (count != record->argc) {
+        return CLASH_HISTORY_MALFORMED;
+    }
+
+    return (int)count;
+}
+
+/// Executes every recorded command with clashParseEx(), as fast as possible. The response stream is
+/// rewound before each command, so it only needs to fit the largest response.
+/// @param definition the definition, should be the one the history was recorded with
+/// @param history the history to replay
+/// @param userData passed to the ClashFn
+/// @param responseStream the response output
+/// @param scratch temporary memory, see clashParseEx()
+/// @param result receives the number of commands, failures and the recorded time span
+/// @return negative if the history is malformed
+int clashHistoryReplay(const ClashDefinition* definition, const ClashHistory* history,
+    void* userData, FldOutStream* responseStream, struct ClashScratch* scratch,
+    ClashHistoryReplayResult* result)
+{
+    tc_mem_clear_type(result);
+
+    size_t offset = 0;
+    ClashHistoryRecord record;
+    int found;
+    while ((found = clashHistoryNext(history, &offset, &record)) > 0) {
+        if (result->commandCount == 0) {
+            result->firstTimestamp = record.timestamp;
+        }
+        result->lastTimestamp = record.timestamp;
+        result->commandCount++;
+
+        const char* argv[CLASH_HISTORY_MAX_ARGS];
+        int argc = clashHistoryRecordArgv(&record, argv, CLASH_HISTORY_MAX_ARGS);
+        if (argc < 0) {
+            result->failedCount++;
+            continue;
+        }
+
+        fldOutStreamInit(responseStream, responseStream->octets, responseStream->size);
+        if (clashParseEx(definition, argv, argc, userData, responseStream, scratch, 0) < 0) {
+            result->failedCount++;
+        }
+    }
+
+    return found;
+}
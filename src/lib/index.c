@@ -0,0 +1,515 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clash/clash.h>
+#include <clash/index.h>
+#include <clash/stats.h>
+#include <clash/suggest.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tiny-libc/tiny_libc.h>
+
+uint32_t clashIndexHash(const char* s, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= (uint8_t)s[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static size_t slotCapacity(size_t count)
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    size_t capacity = 2;
+    while (capacity < count * 2) {
+        capacity <<= 1;
+    }
+
+    return capacity;
+}
+
+static void* allocCleared(ClashIndex* self, size_t octetCount)
+{
+    void* p = tc_malloc(octetCount);
+    if (p != 0) {
+        tc_mem_clear(p, octetCount);
+        self->heapOctetCount += octetCount;
+    }
+    return p;
+}
+
+static size_t countNodes(const ClashCommand* commands, size_t count)
+{
+    size_t total = count;
+    for (size_t i = 0; i < count; ++i) {
+        total += countNodes(commands[i].subCommands, commands[i].subCommandsCount);
+    }
+
+    return total;
+}
+
+static void nodeChildren(const ClashCommand* command, const ClashDefinition* definition,
+    const ClashCommand** children, size_t* childCount)
+{
+    if (command == 0) {
+        *children = definition->commands;
+        *childCount = definition->commandCount;
+    } else {
+        *children = command->subCommands;
+        *childCount = command->subCommandsCount;
+    }
+}
+
+static void insertSlot(ClashIndexSlot* slots, size_t mask, uint32_t hash, size_t value)
+{
+    size_t slot = hash & mask;
+    while (slots[slot].value != 0) {
+        slot = (slot + 1) & mask;
+    }
+    slots[slot].hash = hash;
+    slots[slot].value = (uint32_t)value;
+}
+
+static int compareNames(const void* a, const void* b)
+{
+    return strcmp(((const ClashIndexName*)a)->name, ((const ClashIndexName*)b)->name);
+}
+
+/// Shortest first, names of the same length in name order.
+static int compareLengths(const void* a, const void* b)
+{
+    const ClashIndexName* nameA = (const ClashIndexName*)a;
+    const ClashIndexName* nameB = (const ClashIndexName*)b;
+    if (nameA->length != nameB->length) {
+        return nameA->length < nameB->length ? -1 : 1;
+    }
+
+    return strcmp(nameA->name, nameB->name);
+}
+
+static void sortNames(ClashIndexName* sorted, ClashIndexName* byLength, size_t count)
+{
+    if (count == 0) {
+        return;
+    }
+
+    qsort(sorted, count, sizeof(ClashIndexName), compareNames);
+    tc_memcpy_octets(byLength, sorted, sizeof(ClashIndexName) * count);
+    qsort(byLength, count, sizeof(ClashIndexName), compareLengths);
+}
+
+static void setName(ClashIndexName* target, const char* name, size_t length, size_t value)
+{
+    target->name = name;
+    target->length = length;
+    target->value = (uint32_t)value;
+    target->characterMask = clashSuggestCharacterMask(name, length);
+}
+
+/// Copies a name to the names block.
+/// @return the copy
+static const char* addName(
+    ClashIndex* self, ClashIndexNameSpan* span, const char* name, size_t length)
+{
+    char* copy = &self->names[self->namesOctetCount];
+    tc_memcpy_octets(copy, name, length);
+    copy[length] = 0;
+
+    span->offset = (uint32_t)self->namesOctetCount;
+    span->length = (uint32_t)length;
+    self->namesOctetCount += length + 1;
+
+    return copy;
+}
+
+static void fillNode(ClashIndex* self, size_t nodeIndex, const ClashDefinition* definition)
+{
+    const ClashIndexNode* node = &self->nodes[nodeIndex];
+    const ClashCommand* command = self->nodeInfos[nodeIndex].command;
+
+    const ClashCommand* children;
+    size_t childCount;
+    nodeChildren(command, definition, &children, &childCount);
+
+    ClashIndexSlot* childSlots = &self->childSlots[node->childSlotStart];
+    for (size_t i = 0; i < childCount; ++i) {
+        size_t childIndex = node->childStart + i;
+        size_t length = tc_strlen(children[i].name);
+        const char* name
+            = addName(self, &self->childNames[childIndex], children[i].name, length);
+        insertSlot(childSlots, node->childSlotMask, clashIndexHash(name, length), childIndex + 1);
+        setName(&self->sortedChildNames[childIndex], name, length, childIndex);
+    }
+    sortNames(&self->sortedChildNames[node->childStart],
+        &self->childNamesByLength[node->childStart], childCount);
+
+    if (command == 0 || command->optionCount == 0) {
+        return;
+    }
+
+    ClashIndexSlot* optionSlots = &self->optionSlots[node->optionSlotStart];
+    uint16_t* shortOptions = &self->shortOptions[node->shortOptionStart];
+    for (size_t i = 0; i < command->optionCount; ++i) {
+        const ClashOption* option = &command->options[i];
+        if (option->name != 0) {
+            size_t length = tc_strlen(option->name);
+            const char* name
+                = addName(self, &self->optionNames[node->optionStart + i], option->name, length);
+            insertSlot(optionSlots, node->optionSlotMask, clashIndexHash(name, length), i + 1);
+            setName(&self->sortedOptionNames[node->optionStart + i], name, length, i);
+        } else {
+            setName(&self->sortedOptionNames[node->optionStart + i], "", 0, i);
+        }
+
+        uint8_t shortName = (uint8_t)option->shortName;
+        if (shortName != 0 && shortName != ' ' && shortOptions[shortName] == 0) {
+            shortOptions[shortName] = (uint16_t)(i + 1);
+        }
+    }
+    sortNames(&self->sortedOptionNames[node->optionStart],
+        &self->optionNamesByLength[node->optionStart], command->optionCount);
+}
+
+static size_t alignCacheLine(size_t octetCount)
+{
+    return (octetCount + CLASH_INDEX_CACHE_LINE_OCTETS - 1)
+        & ~(size_t)(CLASH_INDEX_CACHE_LINE_OCTETS - 1);
+}
+
+/// Finds the commands of every node in breadth first order, and sizes the tables.
+/// @return negative if a command has too many options or the tables are too large
+static int countTables(ClashIndex* self, const ClashDefinition* definition)
+{
+    size_t writeIndex = 1;
+    for (size_t i = 0; i < self->nodeCount; ++i) {
+        const ClashCommand* command = self->nodeInfos[i].command;
+
+        const ClashCommand* children;
+        size_t childCount;
+        nodeChildren(command, definition, &children, &childCount);
+        self->childSlotCount += slotCapacity(childCount);
+        for (size_t childIndex = 0; childIndex < childCount; ++childIndex) {
+            self->nodeInfos[writeIndex++].command = &children[childIndex];
+            self->namesOctetCount += tc_strlen(children[childIndex].name) + 1;
+        }
+
+        size_t optionCount = command == 0 ? 0 : command->optionCount;
+        if (optionCount >= UINT16_MAX) {
+            return -2;
+        }
+        self->optionCount += optionCount;
+        self->optionSlotCount += slotCapacity(optionCount);
+        if (optionCount > 0) {
+            self->shortOptionCount += CLASH_INDEX_SHORT_OPTION_COUNT;
+        }
+        for (size_t optionIndex = 0; optionIndex < optionCount; ++optionIndex) {
+            const char* name = command->options[optionIndex].name;
+            self->namesOctetCount += name == 0 ? 0 : tc_strlen(name) + 1;
+        }
+    }
+
+    // Offsets in the hot arrays are 32 bit
+    if (self->namesOctetCount >= UINT32_MAX || self->childSlotCount >= UINT32_MAX
+        || self->optionSlotCount >= UINT32_MAX || self->shortOptionCount >= UINT32_MAX) {
+        return -2;
+    }
+
+    return 0;
+}
+
+/// Allocates the hot arrays in one block, each starting on a cache line.
+static int allocHot(ClashIndex* self)
+{
+    size_t nodesOctetCount = alignCacheLine(sizeof(ClashIndexNode) * self->nodeCount);
+    size_t childSlotsOctetCount = alignCacheLine(sizeof(ClashIndexSlot) * self->childSlotCount);
+    size_t childNamesOctetCount = alignCacheLine(sizeof(ClashIndexNameSpan) * self->nodeCount);
+    size_t optionSlotsOctetCount = alignCacheLine(sizeof(ClashIndexSlot) * self->optionSlotCount);
+    size_t optionNamesOctetCount = alignCacheLine(sizeof(ClashIndexNameSpan) * self->optionCount);
+    size_t shortOptionsOctetCount = alignCacheLine(sizeof(uint16_t) * self->shortOptionCount);
+
+    uint8_t* p = allocCleared(self, nodesOctetCount + childSlotsOctetCount + childNamesOctetCount
+        + optionSlotsOctetCount + optionNamesOctetCount + shortOptionsOctetCount
+        + self->namesOctetCount);
+    if (p == 0) {
+        return -1;
+    }
+
+    self->hotMemory = p;
+    self->nodes = (ClashIndexNode*)p;
+    p += nodesOctetCount;
+    self->childSlots = (ClashIndexSlot*)p;
+    p += childSlotsOctetCount;
+    self->childNames = (ClashIndexNameSpan*)p;
+    p += childNamesOctetCount;
+    self->optionSlots = (ClashIndexSlot*)p;
+    p += optionSlotsOctetCount;
+    self->optionNames = (ClashIndexNameSpan*)p;
+    p += optionNamesOctetCount;
+    self->shortOptions = (uint16_t*)p;
+    p += shortOptionsOctetCount;
+    self->names = (char*)p;
+
+    return 0;
+}
+
+/// Sets the child, option and slot ranges of every node, in the same order as countTables().
+static void setRanges(ClashIndex* self, const ClashDefinition* definition)
+{
+    size_t childStart = 1;
+    size_t childSlotStart = 0;
+    size_t optionStart = 0;
+    size_t optionSlotStart = 0;
+    size_t shortOptionStart = 0;
+    for (size_t i = 0; i < self->nodeCount; ++i) {
+        ClashIndexNode* node = &self->nodes[i];
+        const ClashCommand* command = self->nodeInfos[i].command;
+
+        const ClashCommand* children;
+        size_t childCount;
+        nodeChildren(command, definition, &children, &childCount);
+        size_t capacity = slotCapacity(childCount);
+        node->childStart = (uint32_t)childStart;
+        node->childCount = (uint32_t)childCount;
+        node->childSlotStart = (uint32_t)childSlotStart;
+        node->childSlotMask = capacity == 0 ? 0 : (uint32_t)(capacity - 1);
+        childStart += childCount;
+        childSlotStart += capacity;
+
+        size_t optionCount = command == 0 ? 0 : command->optionCount;
+        capacity = slotCapacity(optionCount);
+        node->optionStart = (uint32_t)optionStart;
+        node->optionSlotStart = (uint32_t)optionSlotStart;
+        node->optionSlotMask = capacity == 0 ? 0 : (uint32_t)(capacity - 1);
+        node->shortOptionStart = (uint32_t)shortOptionStart;
+        optionStart += optionCount;
+        optionSlotStart += capacity;
+        if (optionCount > 0) {
+            shortOptionStart += CLASH_INDEX_SHORT_OPTION_COUNT;
+        }
+    }
+}
+
+/// Builds the lookup tables for the whole definition.
+/// @param self the index to initialize
+/// @param definition the definition to index. It must not change while the index is in use.
+/// @return negative on error
+int clashIndexInit(ClashIndex* self, const ClashDefinition* definition)
+{
+    tc_mem_clear_type(self);
+
+    size_t nodeCount = 1 + countNodes(definition->commands, definition->commandCount);
+    self->nodeInfos = allocCleared(self, sizeof(ClashIndexNodeInfo) * nodeCount);
+    if (self->nodeInfos == 0) {
+        return -1;
+    }
+    self->nodeCount = nodeCount;
+
+    int errorCode = countTables(self, definition);
+    if (errorCode >= 0) {
+        errorCode = allocHot(self);
+    }
+    if (errorCode < 0) {
+        clashIndexDestroy(self);
+        return errorCode;
+    }
+    setRanges(self, definition);
+
+    self->sortedChildNames = allocCleared(self, sizeof(ClashIndexName) * self->nodeCount);
+    self->sortedOptionNames = allocCleared(self, sizeof(ClashIndexName) * self->optionCount);
+    self->childNamesByLength = allocCleared(self, sizeof(ClashIndexName) * self->nodeCount);
+    self->optionNamesByLength = allocCleared(self, sizeof(ClashIndexName) * self->optionCount);
+    // malloc(0) is allowed to return NULL, so a definition without options is not an error
+    int hasOptionNames = self->optionCount == 0
+        || (self->sortedOptionNames != 0 && self->optionNamesByLength != 0);
+    if (self->sortedChildNames == 0 || self->childNamesByLength == 0 || !hasOptionNames) {
+        clashIndexDestroy(self);
+        return -1;
+    }
+#if defined CLASH_STATS
+    self->stats = tc_malloc_type(ClashStats);
+    if (self->stats != 0 && clashStatsInit(self->stats, self->nodeCount) < 0) {
+        tc_free(self->stats);
+        self->stats = 0;
+    }
+    if (self->stats != 0) {
+        self->heapOctetCount += sizeof(ClashStats) + sizeof(ClashCommandStats) * self->nodeCount;
+    }
+#endif
+
+    // The names block is filled again, in node order
+    self->namesOctetCount = 0;
+    for (size_t i = 0; i < nodeCount; ++i) {
+        fillNode(self, i, definition);
+    }
+
+    return 0;
+}
+
+void clashIndexDestroy(ClashIndex* self)
+{
+    tc_free(self->hotMemory);
+    tc_free(self->nodeInfos);
+    tc_free(self->sortedChildNames);
+    tc_free(self->sortedOptionNames);
+    tc_free(self->childNamesByLength);
+    tc_free(self->optionNamesByLength);
+    if (self->stats != 0) {
+        clashStatsDestroy(self->stats);
+        tc_free(self->stats);
+    }
+    tc_free(self->usage);
+    tc_mem_clear_type(self);
+}
+
+static int nameEqual(const ClashIndex* self, const ClashIndexNameSpan* span, const char* name,
+    size_t length)
+{
+    return span->length == length && memcmp(&self->names[span->offset], name, length) == 0;
+}
+
+/// Looks up a direct sub command of the node.
+/// @return the node index of the sub command, or -1 if not found
+int clashIndexFindChild(const ClashIndex* self, size_t nodeIndex, const char* name, size_t length)
+{
+    const ClashIndexNode* node = &self->nodes[nodeIndex];
+    if (node->childSlotMask == 0) {
+        return -1;
+    }
+
+    uint32_t hash = clashIndexHash(name, length);
+    const ClashIndexSlot* slots = &self->childSlots[node->childSlotStart];
+    for (size_t slot = hash & node->childSlotMask;; slot = (slot + 1) & node->childSlotMask) {
+        const ClashIndexSlot* entry = &slots[slot];
+        if (entry->value == 0) {
+            return -1;
+        }
+        size_t childIndex = (size_t)entry->value - 1;
+        if (entry->hash == hash && nameEqual(self, &self->childNames[childIndex], name, length)) {
+            return (int)childIndex;
+        }
+    }
+}
+
+/// Looks up a long option name for the command of the node.
+/// @return the option index, or -1 if not found
+int clashIndexFindNameOption(
+    const ClashIndex* self, size_t nodeIndex, const char* name, size_t length)
+{
+    const ClashIndexNode* node = &self->nodes[nodeIndex];
+    if (node->optionSlotMask == 0) {
+        return -1;
+    }
+
+    uint32_t hash = clashIndexHash(name, length);
+    const ClashIndexSlot* slots = &self->optionSlots[node->optionSlotStart];
+    for (size_t slot = hash & node->optionSlotMask;; slot = (slot + 1) & node->optionSlotMask) {
+        const ClashIndexSlot* entry = &slots[slot];
+        if (entry->value == 0) {
+            return -1;
+        }
+        size_t optionIndex = (size_t)entry->value - 1;
+        if (entry->hash == hash
+            && nameEqual(self, &self->optionNames[node->optionStart + optionIndex], name, length)) {
+            return (int)optionIndex;
+        }
+    }
+}
+
+/// Looks up a short option character for the command of the node.
+/// @return the option index, or -1 if not found
+int clashIndexFindShortOption(const ClashIndex* self, size_t nodeIndex, char shortName)
+{
+    const ClashIndexNode* node = &self->nodes[nodeIndex];
+    if (node->optionSlotMask == 0) {
+        return -1;
+    }
+
+    return (int)self->shortOptions[node->shortOptionStart + (uint8_t)shortName] - 1;
+}
+
+/// Compares the start of the name with the prefix. Names that start with the prefix are equal.
+static int comparePrefix(const ClashIndexName* name, const char* prefix, size_t length)
+{
+    size_t count = name->length < length ? name->length : length;
+    int result = memcmp(name->name, prefix, count);
+    if (result != 0) {
+        return result;
+    }
+
+    return name->length < length ? -1 : 0;
+}
+
+/// Finds all names that start with the prefix with two binary searches.
+/// @param names the sorted names
+/// @param count number of names
+/// @param prefix the prefix, does not have to be zero terminated
+/// @param length octet count of prefix
+/// @param first receives the index of the first matching name
+/// @return number of matching names
+size_t clashIndexFindPrefix(const ClashIndexName* names, size_t count, const char* prefix,
+    size_t length, size_t* first)
+{
+    size_t low = 0;
+    size_t high = count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (comparePrefix(&names[middle], prefix, length) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    size_t end = low;
+    high = count;
+    while (end < high) {
+        size_t middle = end + (high - end) / 2;
+        if (comparePrefix(&names[middle], prefix, length) <= 0) {
+            end = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    *first = low;
+
+    return end - low;
+}
+
+static size_t lowerBoundLength(const ClashIndexName* names, size_t count, size_t length)
+{
+    size_t low = 0;
+    size_t high = count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (names[middle].length < length) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+/// Finds all names with a length in the range.
+/// @param names the names sorted by length
+/// @param count number of names
+/// @param minimumLength shortest length to include
+/// @param maximumLength longest length to include
+/// @param first receives the index of the first name in the range
+/// @return number of names in the range
+size_t clashIndexFindLengthRange(const ClashIndexName* names, size_t count, size_t minimumLength,
+    size_t maximumLength, size_t* first)
+{
+    *first = lowerBoundLength(names, count, minimumLength);
+
+    return lowerBoundLength(names, count, maximumLength + 1) - *first;
+}
@@ -0,0 +1,192 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clash/compiled.h>
+#include <clash/index.h>
+#include <clash/parse_cache.h>
+#include <string.h>
+#include <tiny-libc/tiny_libc.h>
+
+/// Rough octet count of an entry, used to pick the bucket count
+#define CLASH_PARSE_CACHE_TYPICAL_ENTRY_OCTETS (512)
+
+/// Initializes an empty cache.
+/// @param self the cache
+/// @param maxOctetCount the maximum memory used by the cached lines and compiled commands
+/// @return negative on error
+int clashParseCacheInit(ClashParseCache* self, size_t maxOctetCount)
+{
+    tc_mem_clear_type(self);
+
+    size_t bucketCount = 16;
+    while (bucketCount * CLASH_PARSE_CACHE_TYPICAL_ENTRY_OCTETS < maxOctetCount) {
+        bucketCount *= 2;
+    }
+
+    self->buckets = tc_malloc(sizeof(ClashParseCacheEntry*) * bucketCount);
+    if (self->buckets == 0) {
+        return -1;
+    }
+    tc_mem_clear(self->buckets, sizeof(ClashParseCacheEntry*) * bucketCount);
+    self->bucketMask = bucketCount - 1;
+    self->maxOctetCount = maxOctetCount;
+
+    return 0;
+}
+
+static void unlinkRecent(ClashParseCache* self, ClashParseCacheEntry* entry)
+{
+    if (entry->moreRecent != 0) {
+        entry->moreRecent->lessRecent = entry->lessRecent;
+    } else {
+        self->mostRecent = entry->lessRecent;
+    }
+
+    if (entry->lessRecent != 0) {
+        entry->lessRecent->moreRecent = entry->moreRecent;
+    } else {
+        self->leastRecent = entry->moreRecent;
+    }
+}
+
+static void linkMostRecent(ClashParseCache* self, ClashParseCacheEntry* entry)
+{
+    entry->moreRecent = 0;
+    entry->lessRecent = self->mostRecent;
+    if (self->mostRecent != 0) {
+        self->mostRecent->moreRecent = entry;
+    } else {
+        self->leastRecent = entry;
+    }
+    self->mostRecent = entry;
+}
+
+static void removeEntry(ClashParseCache* self, ClashParseCacheEntry* entry)
+{
+    ClashParseCacheEntry** link = &self->buckets[entry->hash & self->bucketMask];
+    while (*link != entry) {
+        link = &(*link)->nextInBucket;
+    }
+    *link = entry->nextInBucket;
+
+    unlinkRecent(self, entry);
+    self->entryCount--;
+    self->octetCount -= entry->octetCount;
+
+    clashCompiledCommandDestroy(entry->compiled);
+    tc_free(entry);
+}
+
+/// Frees all entries and the bucket table
+void clashParseCacheDestroy(ClashParseCache* self)
+{
+    clashParseCacheClear(self);
+    tc_free(self->buckets);
+    self->buckets = 0;
+}
+
+/// Removes all entries, e.g. when the definition has changed. The counters are kept.
+void clashParseCacheClear(ClashParseCache* self)
+{
+    while (self->leastRecent != 0) {
+        removeEntry(self, self->leastRecent);
+    }
+}
+
+static ClashParseCacheEntry* findEntry(
+    const ClashParseCache* self, uint32_t hash, const char* s, size_t length)
+{
+    for (ClashParseCacheEntry* entry = self->buckets[hash & self->bucketMask]; entry != 0;
+         entry = entry->nextInBucket) {
+        if (entry->hash == hash && entry->lineLength == length
+            && memcmp(entry->line, s, length) == 0) {
+            return entry;
+        }
+    }
+
+    return 0;
+}
+
+/// Takes ownership of the compiled command. Least recently used entries are evicted to make room,
+/// and a compiled command that is larger than the whole cache is destroyed.
+static void addEntry(ClashParseCache* self, uint32_t hash, const char* s, size_t length,
+    ClashCompiledCommand* compiled)
+{
+    size_t octetCount
+        = sizeof(ClashParseCacheEntry) + length + clashCompiledCommandOctetCount(compiled);
+    if (octetCount > self->maxOctetCount) {
+        clashCompiledCommandDestroy(compiled);
+        return;
+    }
+
+    while (self->octetCount + octetCount > self->maxOctetCount) {
+        removeEntry(self, self->leastRecent);
+        self->evictionCount++;
+    }
+
+    ClashParseCacheEntry* entry = tc_malloc(sizeof(ClashParseCacheEntry) + length);
+    if (entry == 0) {
+        clashCompiledCommandDestroy(compiled);
+        return;
+    }
+    char* line = (char*)(entry + 1);
+    tc_memcpy_octets(line, s, length);
+
+    entry->hash = hash;
+    entry->lineLength = length;
+    entry->line = line;
+    entry->compiled = compiled;
+    entry->octetCount = octetCount;
+
+    ClashParseCacheEntry** bucket = &self->buckets[hash & self->bucketMask];
+    entry->nextInBucket = *bucket;
+    *bucket = entry;
+    linkMostRecent(self, entry);
+    self->entryCount++;
+    self->octetCount += octetCount;
+}
+
+/// Parses and executes a command line, or executes the cached compiled command if the exact same
+/// line has been parsed before.
+/// @param self the cache
+/// @param definition the definition, the cache must be cleared if it changes
+/// @param s the command line
+/// @param userData passed to the ClashFn
+/// @param responseStream the response output
+/// @param error optional, receives the details if the parse fails
+/// @return negative on error
+int clashParseCacheExecute(ClashParseCache* self, const struct ClashDefinition* definition,
+    const char* s, void* userData, struct FldOutStream* responseStream, ClashParseError* error)
+{
+    size_t length = tc_strlen(s);
+    uint32_t hash = clashIndexHash(s, length);
+
+    ClashParseCacheEntry* entry = findEntry(self, hash, s, length);
+    if (entry != 0) {
+        self->hitCount++;
+        if (entry != self->mostRecent) {
+            unlinkRecent(self, entry);
+            linkMostRecent(self, entry);
+        }
+        if (error != 0) {
+            clashParseErrorClear(error);
+        }
+        return clashExecuteCompiled(entry->compiled, userData, responseStream);
+    }
+
+    self->missCount++;
+    ClashParseError compileError;
+    ClashCompiledCommand* compiled = clashCompileCommand(definition, s, &compileError);
+    if (error != 0) {
+        *error = compileError;
+    }
+    if (compiled == 0) {
+        return compileError.code;
+    }
+
+    int result = clashExecuteCompiled(compiled, userData, responseStream);
+    addEntry(self, hash, s, length, compiled);
+
+    return result;
+}
@@ -0,0 +1,119 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clash/parse_error.h>
+#include <flood/out_stream.h>
+#include <tiny-libc/tiny_libc.h>
+
+void clashParseErrorClear(ClashParseError* self)
+{
+    tc_mem_clear_type(self);
+}
+
+/// Fills in all the fields of the error.
+/// @param self the error, can be NULL
+/// @return the code, for convenience
+int clashParseErrorSet(ClashParseError* self, ClashParseErrorKind kind, int code,
+    const char* expected, size_t tokenIndex, const char* found, size_t foundLength,
+    size_t octetOffset)
+{
+    if (self == 0) {
+        return code;
+    }
+
+    self->kind = kind;
+    self->code = code;
+    self->tokenIndex = tokenIndex;
+    self->octetOffset = octetOffset;
+    self->expected = expected;
+    self->found = found;
+    self->foundLength = foundLength;
+    self->suggestion = 0;
+
+    return code;
+}
+
+const char* clashParseErrorKindToString(ClashParseErrorKind kind)
+{
+    switch (kind) {
+    case ClashParseErrorKindNone:
+        return "no error";
+    case ClashParseErrorKindNullArgument:
+        return "null argument";
+    case ClashParseErrorKindUnknownCommand:
+        return "unknown command";
+    case ClashParseErrorKindUnknownSubCommand:
+        return "unknown sub command";
+    case ClashParseErrorKindNoSubCommands:
+        return "command has no sub commands";
+    case ClashParseErrorKindNoCommand:
+        return "no command selected";
+    case ClashParseErrorKindUnknownOption:
+        return "unknown option";
+    case ClashParseErrorKindUnknownShortOption:
+        return "unknown short option";
+    case ClashParseErrorKindExpectedOptionValue:
+        return "expected option value";
+    case ClashParseErrorKindTooManyArguments:
+        return "too many arguments";
+    case ClashParseErrorKindNotAnArgument:
+        return "not an argument";
+    case ClashParseErrorKindScratchExhausted:
+        return "out of scratch memory";
+    case ClashParseErrorKindUnterminatedQuote:
+        return "unterminated quote";
+    case ClashParseErrorKindTooManyTokens:
+        return "too many tokens";
+    case ClashParseErrorKindInvalidValue:
+        return "invalid value";
+    case ClashParseErrorKindValueOverflow:
+        return "value overflows";
+    case ClashParseErrorKindValueOutOfRange:
+        return "value out of range";
+    case ClashParseErrorKindQueueFull:
+        return "async queue is full";
+    case ClashParseErrorKindMalformedBinary:
+        return "malformed binary command";
+    }
+
+    return "unknown error";
+}
+
+/// Renders a human readable description of the error.
+/// @param self the error
+/// @param outStream stream to write to, typically the response stream
+/// @return negative on error
+int clashParseErrorToStream(const ClashParseError* self, FldOutStream* outStream)
+{
+    int result = fldOutStreamWritef(
+        outStream, "%s", clashParseErrorKindToString(self->kind));
+    if (result < 0) {
+        return result;
+    }
+
+    if (self->found != 0) {
+        result = fldOutStreamWritef(outStream, " '%.*s' (token %zu, offset %zu)",
+            (int)self->foundLength, self->found, self->tokenIndex, self->octetOffset);
+        if (result < 0) {
+            return result;
+        }
+    }
+
+    if (self->expected != 0) {
+        result = fldOutStreamWritef(outStream, ", expected %s", self->expected);
+        if (result < 0) {
+            return result;
+        }
+    }
+
+    if (self->suggestion != 0) {
+        const char* dashes = self->kind == ClashParseErrorKindUnknownOption ? "--" : "";
+        result = fldOutStreamWritef(outStream, ", did you mean '%s%s'?", dashes, self->suggestion);
+        if (result < 0) {
+            return result;
+        }
+    }
+
+    return fldOutStreamWritef(outStream, "\n");
+}
@@ -0,0 +1,38 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clash/clash.h>
+#include <clash/parser.h>
+
+/// Initializes a parser context.
+/// @param self the parser
+/// @param definition the shared definition, should be compiled before it is shared between threads
+/// @param memory scratch memory owned by this parser, see clashDefinitionScratchOctetCount() and
+/// clashDefinitionListOctetCount()
+/// @param octetCount octet count of memory
+void clashParserInit(
+    ClashParser* self, const ClashDefinition* definition, uint8_t* memory, size_t octetCount)
+{
+    self->definition = definition;
+    clashScratchInit(&self->scratch, memory, octetCount);
+    clashParseErrorClear(&self->error);
+}
+
+/// Parses and executes an argument list. Details of a failure are stored in self->error.
+/// @return negative on error
+int clashParserParse(ClashParser* self, const char** argv, int argc, void* userData,
+    struct FldOutStream* responseStream)
+{
+    return clashParseEx(
+        self->definition, argv, argc, userData, responseStream, &self->scratch, &self->error);
+}
+
+/// Parses and executes a command line. Details of a failure are stored in self->error.
+/// @return negative on error
+int clashParserParseString(
+    ClashParser* self, const char* s, void* userData, struct FldOutStream* responseStream)
+{
+    return clashParseStringEx(
+        self->definition, s, userData, responseStream, &self->scratch, &self->error);
+}
@@ -3,24 +3,65 @@
  *  Licensed under the MIT License. See LICENSE in the project root for license information.
  *--------------------------------------------------------------------------------------------------------*/
 #include <clash/response.h>
+#include <clash/response_chunks.h>
 #include <flood/out_stream.h>
 
+/// Color codes are written by tinge directly to the stream, so this much is kept free for them
+#define CLASH_RESPONSE_COLOR_OCTETS (24)
+
+void clashResponseInit(ClashResponse* self, FldOutStream* outStream)
+{
+    self->outStream = outStream;
+    self->chunks = 0;
+    tingeStateInit(&self->tintState, outStream);
+}
+
+/// Lets the response grow into pooled chunks instead of a fixed stream.
+/// @param self the response
+/// @param chunks the chunks to append to, must not be moved while the response is used
+void clashResponseInitChunks(ClashResponse* self, ClashResponseChunks* chunks)
+{
+    clashResponseInit(self, &chunks->stream);
+    self->chunks = chunks;
+}
+
+static int reserveColor(ClashResponse* self)
+{
+    return self->chunks == 0
+        || clashResponseChunksReserve(self->chunks, CLASH_RESPONSE_COLOR_OCTETS) >= 0;
+}
+
 void clashResponseSetColor(ClashResponse* self, uint8_t colorIndex)
 {
+    if (!reserveColor(self)) {
+        return;
+    }
     tingeStateFgColorIndex(&self->tintState, colorIndex);
 }
 
 void clashResponseResetColor(ClashResponse* self)
 {
+    if (!reserveColor(self)) {
+        return;
+    }
     tingeStateReset(&self->tintState);
 }
 
+static int writevf(ClashResponse* self, const char* fmt, va_list pl)
+{
+    if (self->chunks != 0) {
+        return clashResponseChunksWritevf(self->chunks, fmt, pl);
+    }
+
+    return fldOutStreamWritevf(self->outStream, fmt, pl);
+}
+
 int clashResponseWritef(ClashResponse* self, const char* fmt, ...)
 {
     va_list pl;
 
     va_start(pl, fmt);
-    int ret = fldOutStreamWritevf(self->outStream, fmt, pl);
+    int ret = writevf(self, fmt, pl);
     va_end(pl);
     return ret;
 }
@@ -31,7 +72,7 @@ int clashResponseWritecf(ClashResponse* self, uint8_t colorIndex, const char* fm
 
     clashResponseSetColor(self, colorIndex);
     va_start(pl, fmt);
-    int ret = fldOutStreamWritevf(self->outStream, fmt, pl);
+    int ret = writevf(self, fmt, pl);
     va_end(pl);
     return ret;
 }
@@ -0,0 +1,249 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clash/response_chunks.h>
+#include <stdio.h>
+#include <tiny-libc/tiny_libc.h>
+
+#if !defined CLASH_RESPONSE_FORMAT_OCTETS
+#define CLASH_RESPONSE_FORMAT_OCTETS (256)
+#endif
+
+/// Prepares a pool, chunks are allocated when they are first needed.
+/// @param self the pool
+/// @param chunkOctetCount octets of text in each chunk
+/// @param maxChunkCount maximum number of chunks to allocate, zero for no limit
+void clashResponseChunkPoolInit(
+    ClashResponseChunkPool* self, size_t chunkOctetCount, size_t maxChunkCount)
+{
+    self->freeChunks = 0;
+    self->chunkOctetCount = chunkOctetCount;
+    self->chunkCount = 0;
+    self->maxChunkCount = maxChunkCount;
+}
+
+/// Frees the pooled chunks. Every ClashResponseChunks using the pool must have been cleared.
+void clashResponseChunkPoolDestroy(ClashResponseChunkPool* self)
+{
+    ClashResponseChunk* chunk = self->freeChunks;
+    while (chunk != 0) {
+        ClashResponseChunk* next = chunk->next;
+        tc_free(chunk);
+        chunk = next;
+    }
+    self->freeChunks = 0;
+    self->chunkCount = 0;
+}
+
+static ClashResponseChunk* poolAlloc(ClashResponseChunkPool* self)
+{
+    ClashResponseChunk* chunk = self->freeChunks;
+    if (chunk != 0) {
+        self->freeChunks = chunk->next;
+    } else {
+        if (self->maxChunkCount != 0 && self->chunkCount >= self->maxChunkCount) {
+            return 0;
+        }
+        chunk = tc_malloc(sizeof(ClashResponseChunk) + self->chunkOctetCount);
+        if (chunk == 0) {
+            return 0;
+        }
+        self->chunkCount++;
+    }
+
+    chunk->next = 0;
+    chunk->octetCount = 0;
+
+    return chunk;
+}
+
+static void poolFree(ClashResponseChunkPool* self, ClashResponseChunk* chunk)
+{
+    chunk->next = self->freeChunks;
+    self->freeChunks = chunk;
+}
+
+/// Prepares an empty response, the first chunk is taken from the pool on the first write.
+/// @param self the response chunks, must not be moved while a ClashResponse uses it
+/// @param pool the pool to take chunks from
+void clashResponseChunksInit(ClashResponseChunks* self, ClashResponseChunkPool* pool)
+{
+    self->pool = pool;
+    self->first = 0;
+    self->last = 0;
+    self->firstOffset = 0;
+    fldOutStreamInit(&self->stream, 0, 0);
+}
+
+/// Returns all the chunks to the pool, so the response is empty again.
+void clashResponseChunksClear(ClashResponseChunks* self)
+{
+    ClashResponseChunk* chunk = self->first;
+    while (chunk != 0) {
+        ClashResponseChunk* next = chunk->next;
+        poolFree(self->pool, chunk);
+        chunk = next;
+    }
+    clashResponseChunksInit(self, self->pool);
+}
+
+static int addChunk(ClashResponseChunks* self)
+{
+    ClashResponseChunk* chunk = poolAlloc(self->pool);
+    if (chunk == 0) {
+        return -1;
+    }
+
+    if (self->last != 0) {
+        self->last->octetCount = self->stream.pos;
+        self->last->next = chunk;
+    } else {
+        self->first = chunk;
+    }
+    self->last = chunk;
+    fldOutStreamInit(&self->stream, chunk->octets, self->pool->chunkOctetCount);
+
+    return 0;
+}
+
+/// Makes sure that the next octetCount octets are written to the same chunk, e.g. for a color
+/// code written by tinge directly to the stream.
+/// @param self the response chunks
+/// @param octetCount octets needed, at most the chunk size
+/// @return negative if no chunk could be allocated
+int clashResponseChunksReserve(ClashResponseChunks* self, size_t octetCount)
+{
+    if (self->stream.size - self->stream.pos >= octetCount) {
+        return 0;
+    }
+
+    return addChunk(self);
+}
+
+/// Appends octets, continuing in new chunks when the last one is full.
+/// @param self the response chunks
+/// @param octets the octets to append
+/// @param octetCount number of octets
+/// @return negative if the pool has no more chunks
+int clashResponseChunksWrite(ClashResponseChunks* self, const uint8_t* octets, size_t octetCount)
+{
+    while (octetCount > 0) {
+        size_t available = self->stream.size - self->stream.pos;
+        if (available == 0) {
+            if (addChunk(self) < 0) {
+                return -1;
+            }
+            continue;
+        }
+
+        size_t count = octetCount < available ? octetCount : available;
+        fldOutStreamWriteOctets(&self->stream, octets, count);
+        octets += count;
+        octetCount -= count;
+    }
+
+    return 0;
+}
+
+/// Appends formatted text. Text longer than CLASH_RESPONSE_FORMAT_OCTETS is formatted on the heap.
+/// @param self the response chunks
+/// @param fmt the printf style format
+/// @param pl the arguments
+/// @return number of octets written or negative on error
+int clashResponseChunksWritevf(ClashResponseChunks* self, const char* fmt, va_list pl)
+{
+    char stackText[CLASH_RESPONSE_FORMAT_OCTETS];
+    va_list retry;
+    va_copy(retry, pl);
+
+    int length = vsnprintf(stackText, sizeof(stackText), fmt, pl);
+    char* heapText = 0;
+    if (length >= (int)sizeof(stackText)) {
+        heapText = tc_malloc((size_t)length + 1);
+        length = heapText == 0 ? -1 : vsnprintf(heapText, (size_t)length + 1, fmt, retry);
+    }
+    va_end(retry);
+
+    int result = length;
+    if (length > 0) {
+        const char* text = heapText != 0 ? heapText : stackText;
+        result = clashResponseChunksWrite(self, (const uint8_t*)text, (size_t)length);
+    }
+    tc_free(heapText);
+
+    return result < 0 ? result : length;
+}
+
+static size_t chunkOctetCount(const ClashResponseChunks* self, const ClashResponseChunk* chunk)
+{
+    return chunk == self->last ? self->stream.pos : chunk->octetCount;
+}
+
+/// The number of octets written and not yet consumed.
+size_t clashResponseChunksOctetCount(const ClashResponseChunks* self)
+{
+    size_t octetCount = 0;
+    for (const ClashResponseChunk* chunk = self->first; chunk != 0; chunk = chunk->next) {
+        octetCount += chunkOctetCount(self, chunk);
+    }
+
+    return octetCount - self->firstOffset;
+}
+
+/// Drops octets from the start of the response, e.g. after a partial writev(). Chunks that are
+/// completely consumed go back to the pool.
+/// @param self the response chunks
+/// @param octetCount number of octets to drop, at most clashResponseChunksOctetCount()
+void clashResponseChunksConsume(ClashResponseChunks* self, size_t octetCount)
+{
+    while (self->first != 0 && octetCount > 0) {
+        ClashResponseChunk* chunk = self->first;
+        size_t remaining = chunkOctetCount(self, chunk) - self->firstOffset;
+        if (octetCount < remaining) {
+            self->firstOffset += octetCount;
+            return;
+        }
+
+        octetCount -= remaining;
+        if (chunk == self->last) {
+            // Keep writing into the last chunk, it is just empty from here on
+            self->firstOffset = self->stream.pos;
+            return;
+        }
+        self->first = chunk->next;
+        self->firstOffset = 0;
+        poolFree(self->pool, chunk);
+    }
+}
+
+#if !defined _WIN32
+
+/// Fills in one iovec for each chunk, so the response can be sent with writev() without
+/// copying it into one buffer.
+/// @param self the response chunks
+/// @param vectors receives the chunks
+/// @param maxCount maximum number of vectors
+/// @return number of vectors, or negative if maxCount is too small
+int clashResponseChunksToIoVectors(
+    const ClashResponseChunks* self, struct iovec* vectors, size_t maxCount)
+{
+    size_t count = 0;
+    size_t offset = self->firstOffset;
+    for (const ClashResponseChunk* chunk = self->first; chunk != 0; chunk = chunk->next) {
+        size_t octetCount = chunkOctetCount(self, chunk) - offset;
+        if (octetCount != 0) {
+            if (count >= maxCount) {
+                return -1;
+            }
+            vectors[count].iov_base = (void*)(uintptr_t)(chunk->octets + offset);
+            vectors[count].iov_len = octetCount;
+            count++;
+        }
+        offset = 0;
+    }
+
+    return (int)count;
+}
+
+#endif
@@ -0,0 +1,247 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clash/scan.h>
+#include <stdint.h>
+
+// Whitespace is space and tab. Each scan classifies a whole block of characters at a time and
+// finishes the last partial block with the scalar loop, so nothing past end is ever read.
+
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+#define CLASH_SCAN_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined CLASH_SCAN_SSE2 && defined __GNUC__ && (defined __x86_64__ || defined __i386__)
+#define CLASH_SCAN_AVX2
+#include <immintrin.h>
+#endif
+
+#if !defined CLASH_SCAN_SSE2 && defined __ARM_NEON && defined __aarch64__
+#define CLASH_SCAN_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined _MSC_VER
+#include <intrin.h>
+#endif
+
+typedef enum ClashScanKind {
+    ClashScanKindSkipWhitespace,
+    ClashScanKindToWhitespace,
+    ClashScanKindToQuotation,
+} ClashScanKind;
+
+static int isWhitespace(const char ch)
+{
+    return (ch == ' ' || ch == 9);
+}
+
+const char* clashScanSkipWhitespaceScalar(const char* p, const char* end)
+{
+    while (p < end && isWhitespace(*p)) {
+        p++;
+    }
+
+    return p;
+}
+
+const char* clashScanToWhitespaceScalar(const char* p, const char* end)
+{
+    while (p < end && !isWhitespace(*p)) {
+        p++;
+    }
+
+    return p;
+}
+
+const char* clashScanToQuotationScalar(const char* p, const char* end)
+{
+    while (p < end && *p != '\"') {
+        p++;
+    }
+
+    return p;
+}
+
+#if defined CLASH_SCAN_SSE2 || defined CLASH_SCAN_AVX2
+
+static int firstSetBit(uint32_t mask)
+{
+#if defined _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+#endif
+
+#if defined CLASH_SCAN_SSE2
+
+static uint32_t matchMaskSse2(__m128i chunk, ClashScanKind kind)
+{
+    if (kind == ClashScanKindToQuotation) {
+        return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\"')));
+    }
+
+    __m128i whitespace = _mm_or_si128(
+        _mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t')));
+    uint32_t mask = (uint32_t)_mm_movemask_epi8(whitespace);
+
+    return kind == ClashScanKindSkipWhitespace ? mask ^ 0xffffu : mask;
+}
+
+static const char* scanSse2(const char** cursor, const char* end, ClashScanKind kind)
+{
+    const char* p = *cursor;
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(const void*)p);
+        uint32_t mask = matchMaskSse2(chunk, kind);
+        if (mask != 0) {
+            return p + firstSetBit(mask);
+        }
+        p += 16;
+    }
+    *cursor = p;
+
+    return 0;
+}
+
+#endif
+
+#if defined CLASH_SCAN_AVX2
+
+__attribute__((target("avx2"))) static uint32_t matchMaskAvx2(__m256i chunk, ClashScanKind kind)
+{
+    if (kind == ClashScanKindToQuotation) {
+        return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\"')));
+    }
+
+    __m256i whitespace = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')),
+        _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\t')));
+    uint32_t mask = (uint32_t)_mm256_movemask_epi8(whitespace);
+
+    return kind == ClashScanKindSkipWhitespace ? ~mask : mask;
+}
+
+__attribute__((target("avx2"))) static const char* scanAvx2(
+    const char** cursor, const char* end, ClashScanKind kind)
+{
+    const char* p = *cursor;
+    while (end - p >= 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)(const void*)p);
+        uint32_t mask = matchMaskAvx2(chunk, kind);
+        if (mask != 0) {
+            return p + firstSetBit(mask);
+        }
+        p += 32;
+    }
+    *cursor = p;
+
+    return 0;
+}
+
+static int hasAvx2(void)
+{
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif
+
+#if defined CLASH_SCAN_NEON
+
+static const char* scanNeon(const char** cursor, const char* end, ClashScanKind kind)
+{
+    const char* p = *cursor;
+    while (end - p >= 16) {
+        uint8x16_t chunk = vld1q_u8((const uint8_t*)p);
+        uint8x16_t matches;
+        if (kind == ClashScanKindToQuotation) {
+            matches = vceqq_u8(chunk, vdupq_n_u8('\"'));
+        } else {
+            matches = vorrq_u8(vceqq_u8(chunk, vdupq_n_u8(' ')), vceqq_u8(chunk, vdupq_n_u8('\t')));
+            if (kind == ClashScanKindSkipWhitespace) {
+                matches = vmvnq_u8(matches);
+            }
+        }
+        // Narrow each byte to four bits, so the 64 bit lane has the same layout as a movemask
+        uint64_t mask
+            = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(matches), 4)), 0);
+        if (mask != 0) {
+            return p + (__builtin_ctzll(mask) >> 2);
+        }
+        p += 16;
+    }
+    *cursor = p;
+
+    return 0;
+}
+
+#endif
+
+/// Scans whole blocks with the widest available instructions.
+/// @return the first matching character, or the start of the remaining partial block
+static const char* scanBlocks(const char* p, const char* end, ClashScanKind kind)
+{
+    const char* found = 0;
+
+#if defined CLASH_SCAN_AVX2
+    if (hasAvx2()) {
+        found = scanAvx2(&p, end, kind);
+        if (found != 0) {
+            return found;
+        }
+    }
+#endif
+
+#if defined CLASH_SCAN_SSE2
+    found = scanSse2(&p, end, kind);
+#elif defined CLASH_SCAN_NEON
+    found = scanNeon(&p, end, kind);
+#else
+    (void)end;
+    (void)kind;
+#endif
+
+    return found != 0 ? found : p;
+}
+
+const char* clashScanSkipWhitespace(const char* p, const char* end)
+{
+    p = scanBlocks(p, end, ClashScanKindSkipWhitespace);
+    return clashScanSkipWhitespaceScalar(p, end);
+}
+
+const char* clashScanToWhitespace(const char* p, const char* end)
+{
+    p = scanBlocks(p, end, ClashScanKindToWhitespace);
+    return clashScanToWhitespaceScalar(p, end);
+}
+
+const char* clashScanToQuotation(const char* p, const char* end)
+{
+    p = scanBlocks(p, end, ClashScanKindToQuotation);
+    return clashScanToQuotationScalar(p, end);
+}
+
+/// Name of the block scanner picked for this CPU, for diagnostics and benchmarks.
+const char* clashScanImplementationName(void)
+{
+#if defined CLASH_SCAN_AVX2
+    if (hasAvx2()) {
+        return "avx2";
+    }
+#endif
+
+#if defined CLASH_SCAN_SSE2
+    return "sse2";
+#elif defined CLASH_SCAN_NEON
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,87 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clash/scratch.h>
+#include <tiny-libc/tiny_libc.h>
+
+void clashScratchInit(ClashScratch* self, uint8_t* memory, size_t capacity)
+{
+    self->memory = memory;
+    self->capacity = capacity;
+    self->pos = 0;
+}
+
+/// Allocates octetCount octets, aligned to CLASH_SCRATCH_ALIGNMENT.
+/// @return pointer to the memory or NULL if the scratch is exhausted
+void* clashScratchAlloc(ClashScratch* self, size_t octetCount)
+{
+    uintptr_t address = (uintptr_t)(self->memory + self->pos);
+    size_t padding = (size_t)(-address & (CLASH_SCRATCH_ALIGNMENT - 1));
+    if (self->pos + padding + octetCount > self->capacity) {
+        return 0;
+    }
+
+    uint8_t* p = self->memory + self->pos + padding;
+    self->pos += padding + octetCount;
+
+    return p;
+}
+
+/// Allocates octetCount octets without any alignment, e.g. for string copies.
+/// @return pointer to the memory or NULL if the scratch is exhausted
+void* clashScratchAllocOctets(ClashScratch* self, size_t octetCount)
+{
+    if (self->pos + octetCount > self->capacity) {
+        return 0;
+    }
+
+    uint8_t* p = self->memory + self->pos;
+    self->pos += octetCount;
+
+    return p;
+}
+
+/// Grows an allocation. The last allocation is extended in place, any other is copied to a new
+/// allocation and the old memory is only reused after a rewind.
+/// @param p the allocation to grow, can be NULL
+/// @param octetCount the current octet count of p
+/// @param newOctetCount the octet count it should have
+/// @return pointer to the memory or NULL if the scratch is exhausted
+void* clashScratchGrow(ClashScratch* self, void* p, size_t octetCount, size_t newOctetCount)
+{
+    uint8_t* octets = p;
+    if (octets != 0 && octets + octetCount == self->memory + self->pos) {
+        if (newOctetCount - octetCount > self->capacity - self->pos) {
+            return 0;
+        }
+        self->pos += newOctetCount - octetCount;
+        return p;
+    }
+
+    uint8_t* grown = clashScratchAlloc(self, newOctetCount);
+    if (grown != 0 && octets != 0) {
+        tc_memcpy_octets(grown, octets, octetCount);
+    }
+
+    return grown;
+}
+
+/// Copies a string that is not zero terminated and adds the terminator.
+/// @return the copy or NULL if the scratch is exhausted
+const char* clashScratchCopyString(ClashScratch* self, const char* s, size_t length)
+{
+    char* copy = clashScratchAllocOctets(self, length + 1);
+    if (copy == 0) {
+        return 0;
+    }
+    tc_memcpy_octets(copy, s, length);
+    copy[length] = 0;
+
+    return copy;
+}
+
+void clashScratchRewind(ClashScratch* self, size_t pos)
+{
+    self->pos = pos;
+}
@@ -0,0 +1,836 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clash/clash.h>
+#include <clash/convert.h>
+#include <clash/history.h>
+#include <clash/index.h>
+#include <clash/response.h>
+#include <clash/scratch.h>
+#include <clash/state.h>
+#include <clash/stats.h>
+#include <clash/suggest.h>
+#include <clash/tokenizer.h>
+#include <flood/out_stream.h>
+#include <stdio.h>
+#include <string.h>
+#include <tiny-libc/tiny_libc.h>
+
+static int nameEqual(const char* name, const char* s, size_t length)
+{
+    return tc_strlen(name) == length && memcmp(name, s, length) == 0;
+}
+
+static const ClashCommand* clashDefFindCommand(
+    const ClashDefinition* definition, const char* name, size_t length)
+{
+    for (size_t i = 0; i < definition->commandCount; ++i) {
+        if (nameEqual(definition->commands[i].name, name, length)) {
+            return &definition->commands[i];
+        }
+    }
+
+    return 0;
+}
+
+static int clashCommandFindNameOption(
+    const struct ClashCommand* command, const char* name, size_t length)
+{
+    for (size_t i = 0; i < command->optionCount; ++i) {
+        if (command->options[i].name != 0 && nameEqual(command->options[i].name, name, length)) {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
+
+static int clashCommandFindShortOption(const struct ClashCommand* command, const char shortName)
+{
+    for (size_t i = 0; i < command->optionCount; ++i) {
+        if (command->options[i].shortName == shortName) {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
+
+static int clashCommandFindSubCommand(
+    const struct ClashCommand* command, const char* name, size_t length)
+{
+    for (size_t i = 0; i < command->subCommandsCount; ++i) {
+        if (nameEqual(command->subCommands[i].name, name, length)) {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
+
+#if defined CLASH_STATS
+
+/// The stats of the selected command, or of the root node if no command is selected yet.
+static ClashCommandStats* commandStats(const ClashState* self)
+{
+    if (self->index == 0 || self->index->stats == 0) {
+        return 0;
+    }
+
+    return &self->index->stats->commands[self->nodeIndex];
+}
+
+static void recordError(const ClashState* self, int code)
+{
+    if (self->flags & ClashStateFlagCompleting) {
+        return;
+    }
+    ClashCommandStats* stats = commandStats(self);
+    if (stats != 0) {
+        clashStatsRecordError(stats, code);
+    }
+}
+
+#endif
+
+/// Records a parse error for the current token.
+/// @return the code, for convenience
+int clashStateError(ClashState* self, ClashParseErrorKind kind, int code, const char* expected,
+    size_t octetOffset)
+{
+#if defined CLASH_STATS
+    recordError(self, code);
+#endif
+    return clashParseErrorSet(&self->error, kind, code, expected, self->tokenIndex, self->token,
+        self->tokenLength, octetOffset);
+}
+
+/// Records an error for a name that was not found, with the closest known name as suggestion.
+static int unknownNameError(ClashState* self, ClashParseErrorKind kind, int code,
+    const char* expected, const char* name, size_t length, size_t octetOffset)
+{
+    clashStateError(self, kind, code, expected, octetOffset);
+    if ((self->flags & ClashStateFlagCompleting) == 0) {
+        self->error.suggestion = clashSuggestName(self, kind, name, length);
+    }
+
+    return code;
+}
+
+#if defined CLASH_DEBUG_OUTPUT
+
+static void valuesDebugOutput(const ClashStructValues* values, const struct ClashCommand* command)
+{
+    printf("\n Resulting values ----------- \n");
+    if (command->optionCount == 0) {
+        printf("problem\n");
+        return;
+    }
+    for (size_t i = 0; i < values->count; ++i) {
+        const ClashStructValue* item = &values->values[i];
+        const struct ClashOption* option = &command->options[i];
+        printf("%zu: %s = '%.*s' (%d) %s\n", i, option->name, (int)item->length, item->value,
+            item->count, option->description);
+    }
+}
+
+#endif
+
+static int setOptionValue(ClashStructValues* values, int optionIndex, const char* value,
+    size_t length, int isTerminated, size_t tokenIndex)
+{
+    values->values[optionIndex].value = value;
+    values->values[optionIndex].length = length;
+    values->values[optionIndex].isTerminated = isTerminated;
+    values->values[optionIndex].tokenIndex = tokenIndex;
+    values->values[optionIndex].count++;
+    // printf("* set option %d = '%s' (count:%d)\n", optionIndex, value, values->values[optionIndex].count);
+    return 0;
+}
+
+/// Makes room for one more view at the end of a list by moving the views of the lists that were
+/// allocated after it. Only lists are allocated while the options are fed, so the lists stay
+/// packed after each other and take exactly one view per value.
+/// @return zero, or -1 if something else was allocated after the list or the scratch is full
+static int growListInPlace(ClashState* state, ClashStructValue* item)
+{
+    ClashStringView* end = item->list + item->listCapacity;
+    size_t tailCount = 0;
+    for (size_t i = 0; i < state->values.count; ++i) {
+        const ClashStructValue* other = &state->values.values[i];
+        if (other != item && other->list != 0 && other->list >= end) {
+            tailCount += other->listCapacity;
+        }
+    }
+
+    ClashScratch* scratch = state->scratch;
+    if ((uint8_t*)(end + tailCount) != scratch->memory + scratch->pos
+        || clashScratchAllocOctets(scratch, sizeof(ClashStringView)) == 0) {
+        return -1;
+    }
+
+    for (size_t i = tailCount; i > 0; --i) {
+        end[i] = end[i - 1];
+    }
+    for (size_t i = 0; i < state->values.count; ++i) {
+        ClashStructValue* other = &state->values.values[i];
+        if (other != item && other->list != 0 && other->list >= end) {
+            other->list++;
+        }
+    }
+    item->listCapacity++;
+
+    return 0;
+}
+
+/// Adds a value of a ClashTypeList option. The list grows by one view in place, so a line
+/// never needs more than clashDefinitionListOctetCount() for its token count.
+/// Choices are checked here, since only the last value is kept for the error at convert time.
+static int appendListValue(ClashState* state, const char* value, size_t length)
+{
+    const ClashOption* option = state->nameOption;
+    ClashStructValue* item = &state->values.values[state->nameOptionIndex];
+    if (clashConvertCheckChoice(option->choices, value, length) < 0) {
+        clashStateError(state, clashConvertErrorKind(CLASH_CONVERT_INVALID), CLASH_CONVERT_INVALID,
+            clashConvertExpectedValue(option), 0);
+        state->error.found = value;
+        state->error.foundLength = length;
+        return CLASH_CONVERT_INVALID;
+    }
+
+    size_t count = (size_t)item->count;
+    if (count == item->listCapacity && (item->list == 0 || growListInPlace(state, item) < 0)) {
+        ClashStringView* list = clashScratchGrow(state->scratch, item->list,
+            count * sizeof(ClashStringView), (count + 1) * sizeof(ClashStringView));
+        if (list == 0) {
+            return clashStateError(state, ClashParseErrorKindScratchExhausted, -7, 0, 0);
+        }
+        item->list = list;
+        item->listCapacity = count + 1;
+    }
+    item->list[count].str = value;
+    item->list[count].length = length;
+
+    return 0;
+}
+
+static int parseNameOptionValue(ClashState* state, const char* value, size_t length)
+{
+    if (state->nameOptionIndex == -1) {
+        return clashStateError(state, ClashParseErrorKindUnknownOption, -6, "option", 0);
+    }
+    if (state->nameOptionIndex >= (int)state->values.count) {
+        return clashStateError(state, ClashParseErrorKindUnknownOption, -4, "option", 0);
+    }
+
+    if (state->nameOption->type & ClashTypeList) {
+        int errorCode = appendListValue(state, value, length);
+        if (errorCode < 0) {
+            return errorCode;
+        }
+    }
+    setOptionValue(&state->values, state->nameOptionIndex, value, length,
+        (state->flags & ClashStateFlagTerminatedTokens) != 0, state->tokenIndex);
+
+    state->nameOptionIndex = -1;
+    state->nameOption = 0;
+
+    return 0;
+}
+
+/// Flags and bools are set by just naming them, all other options and lists take a value.
+static int optionTakesValue(const ClashOption* option)
+{
+    return (option->type & ClashTypeList)
+        || (!(option->type & ClashTypeBool) && (option->type & ClashTypeMask) != ClashTypeFlag);
+}
+
+/// Looks up a long option. In the `--name=value` form the value is the rest of the token, it is
+/// used in place.
+static int parseNameOption(ClashState* state, const char* name, size_t len)
+{
+    if (state->command == 0) {
+        return clashStateError(state, ClashParseErrorKindNoCommand, -5, "command", 0);
+    }
+
+    const char* equals = memchr(name, '=', len);
+    size_t nameLength = equals == 0 ? len : (size_t)(equals - name);
+    if (state->index != 0) {
+        state->nameOptionIndex
+            = clashIndexFindNameOption(state->index, state->nodeIndex, name, nameLength);
+    } else {
+        state->nameOptionIndex = clashCommandFindNameOption(state->command, name, nameLength);
+    }
+    if (state->nameOptionIndex == -1) {
+        return unknownNameError(
+            state, ClashParseErrorKindUnknownOption, -6, "option", name, nameLength, 2);
+    }
+
+    const ClashOption* option = &state->command->options[state->nameOptionIndex];
+    if (equals == 0 && !optionTakesValue(option)) {
+        setOptionValue(&state->values, state->nameOptionIndex, "", 0, 1, state->tokenIndex);
+        state->nameOptionIndex = -1;
+        return 0;
+    }
+
+    state->nameOption = option;
+    if (equals != 0) {
+        return parseNameOptionValue(state, equals + 1, len - nameLength - 1);
+    }
+
+    return 0;
+}
+
+/// Handles bundled short options, e.g. `-vn file`. The first option that takes a value ends the
+/// bundle: the rest of the token is its value (`-nfile`), or the next token if there is no rest.
+static int parseShortOptions(ClashState* state, const char* s, size_t len)
+{
+    for (size_t i = 0; i < len; ++i) {
+        int index = state->index != 0
+            ? clashIndexFindShortOption(state->index, state->nodeIndex, s[i])
+            : clashCommandFindShortOption(state->command, s[i]);
+        if (index < 0) {
+            return clashStateError(
+                state, ClashParseErrorKindUnknownShortOption, index, "short option", i + 1);
+        }
+
+        const ClashOption* option = &state->command->options[index];
+        if (!optionTakesValue(option)) {
+            setOptionValue(&state->values, index, "", 0, 1, state->tokenIndex);
+            continue;
+        }
+
+        state->nameOption = option;
+        state->nameOptionIndex = index;
+        if (i + 1 < len) {
+            return parseNameOptionValue(state, &s[i + 1], len - i - 1);
+        }
+        break;
+    }
+
+    return 0;
+}
+
+static int selectCommand(
+    struct ClashState* state, const struct ClashCommand* command, size_t nodeIndex)
+{
+    state->command = command;
+    state->nodeIndex = nodeIndex;
+
+    // The values of the parent command are never used again, so reuse the same scratch memory
+    clashScratchRewind(state->scratch, state->scratchMark);
+    state->values.values
+        = clashScratchAlloc(state->scratch, sizeof(ClashStructValue) * command->optionCount);
+    if (state->values.values == 0) {
+        return clashStateError(state, ClashParseErrorKindScratchExhausted, -7, 0, 0);
+    }
+    state->values.count = command->optionCount;
+    for (size_t i = 0; i < state->values.count; ++i) {
+        const char* defaultValue = command->options[i].value;
+        state->values.values[i].count = 0;
+        state->values.values[i].value = defaultValue;
+        state->values.values[i].length = defaultValue == 0 ? 0 : tc_strlen(defaultValue);
+        state->values.values[i].isTerminated = 1;
+        state->values.values[i].tokenIndex = state->tokenIndex;
+        state->values.values[i].list = 0;
+        state->values.values[i].listCapacity = 0;
+    }
+
+    return 0;
+}
+
+static int parseArg(ClashState* state, const char* value, size_t length)
+{
+    if (state->argIndex >= (int)state->command->optionCount) {
+        return clashStateError(state, ClashParseErrorKindTooManyArguments, -1, 0, 0);
+    }
+
+    const ClashOption* nextOption = &state->command->options[state->argIndex];
+    if (!(nextOption->type & ClashTypeArg)) {
+        return clashStateError(state, ClashParseErrorKindNotAnArgument, -2, 0, 0);
+    }
+
+    state->nameOption = nextOption;
+    state->nameOptionIndex = state->argIndex;
+    // A list argument takes all the remaining arguments
+    if (!(nextOption->type & ClashTypeList)) {
+        state->argIndex++;
+    }
+
+    return parseNameOptionValue(state, value, length);
+}
+
+static int parseSubCommand(struct ClashState* state, const char* commandName, size_t len)
+{
+    if (state->command == 0) {
+        return clashStateError(state, ClashParseErrorKindNoCommand, -2, "command", 0);
+    }
+
+    if (state->command->subCommands == 0) {
+        return clashStateError(state, ClashParseErrorKindNoSubCommands, -4, 0, 0);
+    }
+
+    if (state->index != 0) {
+        int foundNodeIndex
+            = clashIndexFindChild(state->index, state->nodeIndex, commandName, len);
+        if (foundNodeIndex < 0) {
+            return unknownNameError(state, ClashParseErrorKindUnknownSubCommand, -5,
+                "sub command", commandName, len, 0);
+        }
+        const ClashCommand* foundCommand = state->index->nodeInfos[foundNodeIndex].command;
+        return selectCommand(state, foundCommand, (size_t)foundNodeIndex);
+    }
+
+    int foundIndex = clashCommandFindSubCommand(state->command, commandName, len);
+    if (foundIndex < 0) {
+        return unknownNameError(state, ClashParseErrorKindUnknownSubCommand, -5, "sub command",
+            commandName, len, 0);
+    }
+
+    const ClashCommand* foundCommand = &state->command->subCommands[foundIndex];
+
+    return selectCommand(state, foundCommand, 0);
+}
+
+static int parseOption(ClashState* state, const char* s, size_t len)
+{
+    if (len >= 2 && s[0] == '-') {
+        return parseNameOption(state, &s[1], len - 1);
+    }
+
+    return parseShortOptions(state, s, len);
+}
+
+static int parseOptionSetCommandIfNeeded(ClashState* state, const char* s, size_t len)
+{
+    if (state->command == 0) {
+        size_t firstNodeIndex
+            = state->index != 0 ? state->index->nodes[CLASH_INDEX_ROOT].childStart : 0;
+        int errorCode = selectCommand(state, &state->definition->commands[0], firstNodeIndex);
+        if (errorCode < 0) {
+            return errorCode;
+        }
+    }
+
+    return parseOption(state, s, len);
+}
+
+static const ClashCommand* findRootCommand(ClashState* state, const char* name, size_t len)
+{
+    if (state->index == 0) {
+        return clashDefFindCommand(state->definition, name, len);
+    }
+
+    int foundNodeIndex = clashIndexFindChild(state->index, CLASH_INDEX_ROOT, name, len);
+    if (foundNodeIndex < 0) {
+        return 0;
+    }
+    state->nodeIndex = (size_t)foundNodeIndex;
+
+    return state->index->nodeInfos[foundNodeIndex].command;
+}
+
+static int setString(const char** target, const ClashStructValue* item, ClashScratch* scratch)
+{
+    if (item->isTerminated) {
+        *target = item->value;
+        return 0;
+    }
+
+    *target = clashScratchCopyString(scratch, item->value, item->length);
+
+    return *target == 0 ? -1 : 0;
+}
+
+static int convertInt(const ClashOption* option, const ClashStructValue* item, int* target)
+{
+    int errorCode = clashConvertInt(item->value, item->length, target);
+    if (errorCode < 0) {
+        return errorCode;
+    }
+
+    return clashConvertCheckRange(*target, option->minimum, option->maximum);
+}
+
+static int convertUInt64(
+    const ClashOption* option, const ClashStructValue* item, uint64_t* target)
+{
+    int errorCode = clashConvertUInt64(item->value, item->length, target);
+    if (errorCode < 0) {
+        return errorCode;
+    }
+
+    return clashConvertCheckRangeUInt64(*target, option->minimum, option->maximum);
+}
+
+static int convertInt64(const ClashOption* option, const ClashStructValue* item, int64_t* target)
+{
+    int errorCode = (option->type & ClashTypeMask) == ClashTypeDuration
+        ? clashConvertDuration(item->value, item->length, target)
+        : clashConvertInt64(item->value, item->length, target);
+    if (errorCode < 0) {
+        return errorCode;
+    }
+
+    return clashConvertCheckRange(*target, option->minimum, option->maximum);
+}
+
+static int convertDouble(const ClashOption* option, const ClashStructValue* item, double* target)
+{
+    int errorCode = clashConvertDouble(item->value, item->length, target);
+    if (errorCode < 0) {
+        return errorCode;
+    }
+
+    return clashConvertCheckRangeDouble(*target, option->minimum, option->maximum);
+}
+
+/// Converts the text of a value into the field of a command struct.
+/// @param option the option the value is for
+/// @param item the value, its count is zero for a default
+/// @param p the field in the struct
+/// @param scratch receives copies of strings that are not zero terminated
+/// @return negative on error
+int clashStateConvertValue(const ClashOption* option, const ClashStructValue* item, void* p,
+    ClashScratch* scratch)
+{
+    if (option->type & ClashTypeList) {
+        // Defaults are not used, a list that is not given is empty
+        ClashStringList* list = (ClashStringList*)p;
+        list->values = item->count == 0 ? 0 : item->list;
+        list->count = (size_t)item->count;
+        return 0;
+    }
+
+    if (option->type & ClashTypeBool) {
+        // A short option, or a missing default, has no value
+        if (item->length == 0) {
+            *((bool*)p) = item->count != 0;
+            return 0;
+        }
+        return clashConvertBool(item->value, item->length, (bool*)p);
+    }
+
+    switch (option->type & ClashTypeMask) {
+    case ClashTypeString:
+        // Defaults are not checked, an option without a value does not have to be a choice
+        if (item->count != 0
+            && clashConvertCheckChoice(option->choices, item->value, item->length) < 0) {
+            return CLASH_CONVERT_INVALID;
+        }
+        if (option->type & ClashTypeView) {
+            ClashStringView* view = (ClashStringView*)p;
+            view->str = item->value;
+            view->length = item->length;
+        } else if (setString((const char**)p, item, scratch) < 0) {
+            return -7;
+        }
+        return 0;
+    case ClashTypeFlag:
+        *((int*)p) = item->count;
+        return 0;
+    default:
+        break;
+    }
+
+    // An empty default is zero, like before the values were validated
+    if (item->count == 0 && item->length == 0) {
+        return 0;
+    }
+
+    switch (option->type & ClashTypeMask) {
+    case ClashTypeInt:
+        return convertInt(option, item, (int*)p);
+    case ClashTypeUInt64:
+        return convertUInt64(option, item, (uint64_t*)p);
+    case ClashTypeInt64:
+    case ClashTypeDuration:
+        return convertInt64(option, item, (int64_t*)p);
+    case ClashTypeDouble:
+        return convertDouble(option, item, (double*)p);
+    default:
+        return 0;
+    }
+}
+
+static int convertToStruct(ClashState* self, void** out)
+{
+    const ClashCommand* command = self->command;
+    uint8_t* data = clashScratchAlloc(self->scratch, command->structSize);
+    if (data == 0) {
+        return clashStateError(self, ClashParseErrorKindScratchExhausted, -7, 0, 0);
+    }
+    tc_mem_clear(data, command->structSize);
+    *out = data;
+
+    for (size_t i = 0; i < command->optionCount; ++i) {
+        const ClashOption* option = &command->options[i];
+        const ClashStructValue* item = &self->values.values[i];
+        if (i == 0 && item->value == 0) {
+            return 0;
+        }
+
+        int errorCode
+            = clashStateConvertValue(option, item, data + option->structOffset, self->scratch);
+        if (errorCode < 0) {
+            return clashParseErrorSet(&self->error, clashConvertErrorKind(errorCode), errorCode,
+                clashConvertExpectedValue(option), item->tokenIndex, item->value, item->length, 0);
+        }
+    }
+
+    return 0;
+}
+
+/// Prepares the state for a new command line
+/// @param self the state
+/// @param definition the definition to parse against
+/// @param scratch temporary memory for the values and the converted struct
+/// @param flags a combination of the ClashStateFlag values
+void clashStateInit(ClashState* self, const ClashDefinition* definition, ClashScratch* scratch,
+    int flags)
+{
+    tc_mem_clear_type(self);
+    self->definition = definition;
+    self->index = definition->index;
+    self->nodeIndex = CLASH_INDEX_ROOT;
+    self->scratch = scratch;
+    self->scratchMark = scratch->pos;
+    self->flags = flags;
+}
+
+/// Makes the state ready for the next command line, reusing the same scratch memory.
+void clashStateReset(ClashState* self)
+{
+    clashScratchRewind(self->scratch, self->scratchMark);
+    clashStateInit(self, self->definition, self->scratch, self->flags);
+}
+
+static int isNegativeNumberValue(const ClashState* self, const char* token, size_t len)
+{
+    return self->nameOption != 0
+        && clashConvertIsNegativeNumber(self->nameOption->type, token, len);
+}
+
+/// Feeds the next token of the command line.
+/// @param self the state
+/// @param token the token, it must stay valid until the command has been dispatched
+/// @param len octet count of the token
+/// @return negative on error
+int clashStateFeed(ClashState* self, const char* token, size_t len)
+{
+    int errorCode;
+
+    self->token = token;
+    self->tokenLength = len;
+
+#if defined CLASH_STATS
+    if (self->tokenIndex == 0 && self->index != 0 && self->index->stats != 0
+        && (self->flags & ClashStateFlagCompleting) == 0) {
+        self->statsStartTime = clashStatsParseStarted(self->index->stats);
+    }
+#endif
+
+    if (token == 0) {
+        errorCode = clashStateError(self, ClashParseErrorKindNullArgument, -2, 0, 0);
+    } else if (len != 0 && token[0] == '-' && !isNegativeNumberValue(self, token, len)) {
+        if (self->nameOption != 0) {
+            errorCode = clashStateError(
+                self, ClashParseErrorKindExpectedOptionValue, -6, self->nameOption->name, 0);
+        } else {
+            errorCode = parseOptionSetCommandIfNeeded(self, &token[1], len - 1);
+        }
+    } else if (self->nameOption != 0) {
+        errorCode = parseNameOptionValue(self, token, len);
+    } else if (self->command == 0) {
+        const ClashCommand* foundCommand = findRootCommand(self, token, len);
+        if (foundCommand == 0) {
+            errorCode = unknownNameError(
+                self, ClashParseErrorKindUnknownCommand, -4, "command", token, len, 0);
+        } else {
+            errorCode = selectCommand(self, foundCommand, self->nodeIndex);
+        }
+    } else if (self->command->subCommands != 0) {
+        errorCode = parseSubCommand(self, token, len);
+    } else {
+        errorCode = parseArg(self, token, len);
+    }
+
+    self->tokenIndex++;
+
+    return errorCode < 0 ? errorCode : 0;
+}
+
+/// Tokenizes a line in place and feeds each token.
+/// @param self the state
+/// @param start first character of the line
+/// @param end one past the last character of the line
+/// @return number of tokens fed, or negative on error
+int clashStateFeedLine(ClashState* self, const char* start, const char* end)
+{
+    const char* cursor = start;
+    ClashStringView token;
+    int tokenCount = 0;
+    self->text.lineStart = start;
+    self->text.lineEnd = end;
+
+    while (1) {
+        int found = clashTokenizerNext(&cursor, end, &token);
+        if (found == 0) {
+            break;
+        }
+        if (found < 0) {
+            self->token = token.str;
+            self->tokenLength = token.length;
+            return clashStateError(self, ClashParseErrorKindUnterminatedQuote, -1, "\"", 0);
+        }
+
+        int errorCode = clashStateFeed(self, token.str, token.length);
+        if (errorCode < 0) {
+            return errorCode;
+        }
+        tokenCount++;
+    }
+
+    return tokenCount;
+}
+
+/// Converts the parsed values of the selected command into its struct, allocated from the scratch.
+/// @param self the state
+/// @param structData receives the struct, NULL if no command with a ClashFn was selected
+/// @return negative on error
+int clashStateConvert(ClashState* self, void** structData)
+{
+    *structData = 0;
+    int errorCode = 0;
+    if (self->nameOption != 0) {
+        // The line ended with an option that is still waiting for its value
+        errorCode = clashParseErrorSet(&self->error, ClashParseErrorKindExpectedOptionValue, -6,
+            self->nameOption->name, self->tokenIndex - 1, self->token, self->tokenLength, 0);
+    } else if (self->command != 0 && self->command->fn != 0) {
+        errorCode = convertToStruct(self, structData);
+    }
+#if defined CLASH_STATS
+    if (errorCode < 0) {
+        recordError(self, errorCode);
+    }
+#endif
+
+    return errorCode;
+}
+
+static void recordHistory(const ClashCall* self)
+{
+    ClashHistory* history = self->index == 0 ? 0 : self->index->history;
+    const ClashCallText* text = &self->text;
+    if (history == 0) {
+        return;
+    }
+
+    if (text->lineStart != 0) {
+        clashHistoryAppendLine(history, self->nodeIndex, text->lineStart, text->lineEnd);
+    } else if (text->argv != 0) {
+        clashHistoryAppend(history, self->nodeIndex, text->argv, text->argc);
+    } else if (text->tokens != 0) {
+        clashHistoryAppendTokens(
+            history, self->nodeIndex, text->tokens, text->tokensOctetCount, text->tokenCount);
+    }
+}
+
+/// Calls the ClashFn of the command, counts the call in the CLASH_STATS and appends the text of
+/// the call to the history. Nothing is done for a command without a ClashFn.
+/// @param self the command and its converted struct
+/// @param userData passed to the ClashFn
+/// @param response the response, its color is reset afterwards
+void clashCallResponse(const ClashCall* self, void* userData, ClashResponse* response)
+{
+    if (self->command == 0 || self->command->fn == 0) {
+        return;
+    }
+
+#if defined CLASH_STATS
+    ClashStats* stats = self->index == 0 ? 0 : self->index->stats;
+    if (stats != 0) {
+        ClashCommandStats* counters = &stats->commands[self->nodeIndex];
+        clashStatsRecordInvocation(counters);
+        uint64_t startTime
+            = self->isParsedEarlier ? clashStatsParseStarted(stats) : self->statsStartTime;
+        if (startTime != 0) {
+            uint64_t callTime = clashStatsTicks();
+            self->command->fn(userData, self->structData, response);
+            uint64_t callbackTicks = clashStatsTicks() - callTime;
+            if (self->isParsedEarlier) {
+                clashStatsRecordCallbackDuration(counters, callbackTicks);
+            } else {
+                clashStatsRecordDurations(counters, callTime - startTime, callbackTicks);
+            }
+            clashResponseResetColor(response);
+            recordHistory(self);
+            return;
+        }
+    }
+#endif
+
+    self->command->fn(userData, self->structData, response);
+    clashResponseResetColor(response);
+    recordHistory(self);
+}
+
+/// Like clashCallResponse(), but writes to a stream and ends the response with a zero terminator.
+/// @param self the command and its converted struct
+/// @param userData passed to the ClashFn
+/// @param responseStream the response output
+void clashCall(const ClashCall* self, void* userData, FldOutStream* responseStream)
+{
+    ClashResponse response;
+    clashResponseInit(&response, responseStream);
+    clashCallResponse(self, userData, &response);
+    fldOutStreamWriteUInt8(responseStream, 0);
+}
+
+/// Converts the parsed values and calls the ClashFn of the selected command.
+/// @param self the state
+/// @param userData passed to the ClashFn
+/// @param response the response, nothing is written to it if the conversion fails
+/// @return negative on error
+int clashStateDispatchResponse(ClashState* self, void* userData, ClashResponse* response)
+{
+#if defined CLASH_DEBUG_OUTPUT
+
+    if (self->command != 0) {
+        valuesDebugOutput(&self->values, self->command);
+    }
+
+#endif
+    void* structData;
+    int errorCode = clashStateConvert(self, &structData);
+    if (errorCode < 0) {
+        return errorCode;
+    }
+
+    ClashCall call = { self->index, self->nodeIndex, self->command, structData,
+        self->statsStartTime, 0, self->text };
+    clashCallResponse(&call, userData, response);
+
+    return 0;
+}
+
+/// Converts the parsed values and calls the ClashFn of the selected command.
+/// The zero terminator is written to the response stream if the ClashFn was called.
+/// @param self the state
+/// @param userData passed to the ClashFn
+/// @param responseStream the response output
+/// @return negative on error
+int clashStateDispatch(ClashState* self, void* userData, FldOutStream* responseStream)
+{
+    ClashResponse response;
+    clashResponseInit(&response, responseStream);
+
+    int errorCode = clashStateDispatchResponse(self, userData, &response);
+    if (errorCode < 0) {
+        return errorCode;
+    }
+    fldOutStreamWriteUInt8(responseStream, 0);
+
+    return 0;
+}
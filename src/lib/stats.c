@@ -0,0 +1,343 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#if !defined _WIN32
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include <clash/clash.h>
+#include <clash/index.h>
+#include <clash/stats.h>
+#include <flood/out_stream.h>
+#include <tiny-libc/tiny_libc.h>
+
+#if defined _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#if defined _MSC_VER
+#include <intrin.h>
+#elif defined __x86_64__ || defined __i386__
+#include <x86intrin.h>
+#endif
+
+#define CLASH_STATS_MAX_DEPTH (32)
+
+/// Allocates the counters, all set to zero.
+/// @param self the stats
+/// @param commandCount number of nodes in the index
+/// @return negative on error
+int clashStatsInit(ClashStats* self, size_t commandCount)
+{
+    size_t octetCount = sizeof(ClashCommandStats) * commandCount;
+    self->commands = tc_malloc(octetCount);
+    if (self->commands == 0) {
+        return -1;
+    }
+    tc_mem_clear(self->commands, octetCount);
+    self->commandCount = commandCount;
+    self->startTicks = clashStatsTicks();
+    self->startNanoseconds = clashStatsNanoseconds();
+    self->parseCount = 0;
+
+    return 0;
+}
+
+void clashStatsDestroy(ClashStats* self)
+{
+    tc_free(self->commands);
+    self->commands = 0;
+    self->commandCount = 0;
+}
+
+/// Sets all the counters of a compiled definition to zero.
+/// Should not be called while the definition is used from other threads.
+/// @param definition the compiled definition
+void clashStatsClear(ClashDefinition* definition)
+{
+    if (definition->index == 0 || definition->index->stats == 0) {
+        return;
+    }
+
+    ClashStats* stats = definition->index->stats;
+    tc_mem_clear(stats->commands, sizeof(ClashCommandStats) * stats->commandCount);
+}
+
+/// Monotonic wall clock time.
+/// @return nanoseconds since an arbitrary point in time
+uint64_t clashStatsNanoseconds(void)
+{
+#if defined _WIN32
+    LARGE_INTEGER counter;
+    LARGE_INTEGER frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    uint64_t ticks = (uint64_t)counter.QuadPart;
+    uint64_t ticksPerSecond = (uint64_t)frequency.QuadPart;
+
+    return ticks / ticksPerSecond * 1000000000u
+        + ticks % ticksPerSecond * 1000000000u / ticksPerSecond;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#endif
+}
+
+/// The cheapest monotonic counter available, the time stamp counter on x86 and the virtual
+/// counter on arm64, otherwise nanoseconds.
+/// @return ticks since an arbitrary point in time
+uint64_t clashStatsTicks(void)
+{
+#if defined _MSC_VER && (defined _M_X64 || defined _M_IX86)
+    return __rdtsc();
+#elif defined __x86_64__ || defined __i386__
+    return __rdtsc();
+#elif defined __aarch64__ && (defined __GNUC__ || defined __clang__)
+    uint64_t ticks;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    return clashStatsNanoseconds();
+#endif
+}
+
+static uint64_t addRelaxed(uint64_t* counter, uint64_t value)
+{
+#if defined _MSC_VER
+    return (uint64_t)_InterlockedExchangeAdd64((volatile __int64*)counter, (__int64)value);
+#else
+    return __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+#endif
+}
+
+static uint64_t loadRelaxed(const uint64_t* counter)
+{
+#if defined _MSC_VER
+    return *(const volatile uint64_t*)counter;
+#else
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+#endif
+}
+
+/// The histogram bucket for a duration, the base two logarithm rounded down.
+/// @param ticks the duration
+/// @return the bucket index
+size_t clashStatsBucket(uint64_t ticks)
+{
+    size_t bucket;
+#if defined _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, ticks | 1);
+    bucket = (size_t)index;
+#else
+    bucket = (size_t)(63 - __builtin_clzll(ticks | 1));
+#endif
+
+    return bucket < CLASH_STATS_BUCKET_COUNT ? bucket : CLASH_STATS_BUCKET_COUNT - 1;
+}
+
+/// Called when the first token of a parse is fed, or when a command that was parsed earlier is
+/// called, so the same share of both is sampled.
+/// @param self the stats
+/// @return the start time if the parse is sampled, otherwise zero
+uint64_t clashStatsParseStarted(ClashStats* self)
+{
+    if ((addRelaxed(&self->parseCount, 1) & (CLASH_STATS_SAMPLE_INTERVAL - 1)) != 0) {
+        return 0;
+    }
+
+    uint64_t ticks = clashStatsTicks();
+
+    return ticks == 0 ? 1 : ticks;
+}
+
+/// Counts a failed parse.
+/// @param self the stats of the command that was selected when the parse failed
+/// @param code the negative error code, codes that do not fit are counted as the last code
+void clashStatsRecordError(ClashCommandStats* self, int code)
+{
+    size_t codeIndex = code < 0 ? (size_t)(-(code + 1)) : 0;
+    if (codeIndex >= CLASH_STATS_ERROR_CODE_COUNT) {
+        codeIndex = CLASH_STATS_ERROR_CODE_COUNT - 1;
+    }
+
+    addRelaxed(&self->errorCounts[codeIndex], 1);
+}
+
+/// Counts a successful parse, before the ClashFn is called.
+/// @param self the stats of the command
+void clashStatsRecordInvocation(ClashCommandStats* self)
+{
+    addRelaxed(&self->invocationCount, 1);
+}
+
+/// Adds the durations of a sampled parse to the histograms.
+/// @param self the stats of the command
+/// @param parseTicks time from the first token until the values were converted
+/// @param callbackTicks time spent in the ClashFn
+void clashStatsRecordDurations(
+    ClashCommandStats* self, uint64_t parseTicks, uint64_t callbackTicks)
+{
+    addRelaxed(&self->parseTicks[clashStatsBucket(parseTicks)], 1);
+    addRelaxed(&self->callbackTicks[clashStatsBucket(callbackTicks)], 1);
+}
+
+/// Adds the callback duration of a sampled call of a command that was parsed earlier, e.g. a
+/// compiled or binary command, which has no parse time.
+/// @param self the stats of the command
+/// @param callbackTicks time spent in the ClashFn
+void clashStatsRecordCallbackDuration(ClashCommandStats* self, uint64_t callbackTicks)
+{
+    addRelaxed(&self->callbackTicks[clashStatsBucket(callbackTicks)], 1);
+}
+
+typedef struct Dump {
+    const ClashStats* stats;
+    double nanosecondsPerTick;
+    FldOutStream* outStream;
+} Dump;
+
+static uint64_t sum(const uint64_t* counters, size_t count)
+{
+    uint64_t total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        total += loadRelaxed(&counters[i]);
+    }
+
+    return total;
+}
+
+static unsigned long long bucketStart(const Dump* self, size_t bucket)
+{
+    return (unsigned long long)((double)((uint64_t)1 << bucket) * self->nanosecondsPerTick);
+}
+
+/// The start of the bucket after the one that holds the percentile, in nanoseconds.
+static unsigned long long percentile(
+    const Dump* self, const uint64_t* buckets, uint64_t total, uint64_t percent)
+{
+    uint64_t target = (total * percent + 99) / 100;
+    uint64_t count = 0;
+    size_t i = 0;
+    for (; i < CLASH_STATS_BUCKET_COUNT - 1; ++i) {
+        count += loadRelaxed(&buckets[i]);
+        if (count >= target) {
+            break;
+        }
+    }
+
+    return bucketStart(self, i + 1);
+}
+
+static int dumpHistogram(
+    const Dump* self, const uint64_t* buckets, uint64_t total, const char* name)
+{
+    int result = fldOutStreamWritef(self->outStream,
+        "  %-8s p50<%llu p99<%llu ns (%llu sampled) |", name, percentile(self, buckets, total, 50),
+        percentile(self, buckets, total, 99), (unsigned long long)total);
+    for (size_t i = 0; i < CLASH_STATS_BUCKET_COUNT && result >= 0; ++i) {
+        uint64_t count = loadRelaxed(&buckets[i]);
+        if (count != 0) {
+            result = fldOutStreamWritef(
+                self->outStream, " %llu:%llu", bucketStart(self, i), (unsigned long long)count);
+        }
+    }
+    if (result < 0) {
+        return result;
+    }
+
+    return fldOutStreamWritef(self->outStream, "\n");
+}
+
+static int dumpCommand(
+    const Dump* self, const ClashCommandStats* stats, const char* const* path, size_t depth)
+{
+    uint64_t invocationCount = loadRelaxed(&stats->invocationCount);
+    uint64_t errorCount = sum(stats->errorCounts, CLASH_STATS_ERROR_CODE_COUNT);
+    if (invocationCount == 0 && errorCount == 0) {
+        return 0;
+    }
+
+    FldOutStream* outStream = self->outStream;
+    int result = fldOutStreamWritef(outStream, "%s", depth == 0 ? "(no command)" : path[0]);
+    for (size_t i = 1; i < depth && result >= 0; ++i) {
+        result = fldOutStreamWritef(outStream, " %s", path[i]);
+    }
+    if (result >= 0) {
+        result = fldOutStreamWritef(outStream, " calls:%llu errors:%llu",
+            (unsigned long long)invocationCount, (unsigned long long)errorCount);
+    }
+    for (size_t i = 0; i < CLASH_STATS_ERROR_CODE_COUNT && result >= 0; ++i) {
+        uint64_t count = loadRelaxed(&stats->errorCounts[i]);
+        if (count != 0) {
+            result = fldOutStreamWritef(
+                outStream, " %d:%llu", -(int)(i + 1), (unsigned long long)count);
+        }
+    }
+    if (result >= 0) {
+        result = fldOutStreamWritef(outStream, "\n");
+    }
+    // Commands parsed earlier, e.g. compiled or binary, only sample their callback
+    uint64_t parseSampleCount = sum(stats->parseTicks, CLASH_STATS_BUCKET_COUNT);
+    if (result >= 0 && parseSampleCount != 0) {
+        result = dumpHistogram(self, stats->parseTicks, parseSampleCount, "parse");
+    }
+    uint64_t callbackSampleCount = sum(stats->callbackTicks, CLASH_STATS_BUCKET_COUNT);
+    if (result >= 0 && callbackSampleCount != 0) {
+        result = dumpHistogram(self, stats->callbackTicks, callbackSampleCount, "callback");
+    }
+
+    return result;
+}
+
+static int dumpNode(
+    const Dump* self, const ClashIndex* index, size_t nodeIndex, const char** path, size_t depth)
+{
+    const ClashIndexNode* node = &index->nodes[nodeIndex];
+    if (depth > 0) {
+        path[depth - 1] = index->nodeInfos[nodeIndex].command->name;
+    }
+
+    int result = dumpCommand(self, &self->stats->commands[nodeIndex], path, depth);
+    if (depth == CLASH_STATS_MAX_DEPTH) {
+        return result;
+    }
+
+    for (size_t i = 0; i < node->childCount && result >= 0; ++i) {
+        result = dumpNode(self, index, node->childStart + i, path, depth + 1);
+    }
+
+    return result;
+}
+
+/// Writes the counters of every command that has been executed, one line per command followed by
+/// the parse histogram of the sampled parses and the callback histogram of the sampled calls in
+/// nanoseconds. A command only executed after being parsed earlier, e.g. compiled or binary, has
+/// no parse histogram. Failed parses before a command was selected are counted for "(no command)".
+/// @param definition the compiled definition
+/// @param outStream stream to write to
+/// @return negative on error, or if stats are not collected (not compiled or no CLASH_STATS)
+int clashStatsDump(const ClashDefinition* definition, FldOutStream* outStream)
+{
+    const ClashIndex* index = definition->index;
+    if (index == 0 || index->stats == 0) {
+        return -1;
+    }
+
+    // The length of a tick is measured over the whole time the stats have been collected
+    const ClashStats* stats = index->stats;
+    uint64_t elapsedTicks = clashStatsTicks() - stats->startTicks;
+    uint64_t elapsedNanoseconds = clashStatsNanoseconds() - stats->startNanoseconds;
+    double nanosecondsPerTick
+        = elapsedTicks == 0 ? 1.0 : (double)elapsedNanoseconds / (double)elapsedTicks;
+
+    Dump dump = { stats, nanosecondsPerTick, outStream };
+    const char* path[CLASH_STATS_MAX_DEPTH];
+
+    return dumpNode(&dump, index, CLASH_INDEX_ROOT, path, 0);
+}
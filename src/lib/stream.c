@@ -0,0 +1,243 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clash/clash.h>
+#include <clash/scan.h>
+#include <clash/stream.h>
+#include <string.h>
+#include <tiny-libc/tiny_libc.h>
+
+/// Initializes a stream parser, usually one for each connection.
+/// @param self the parser
+/// @param definition the definition to parse against
+/// @param memory scratch memory owned by the parser. It must hold the values and the struct of a
+/// command (see clashDefinitionScratchOctetCount()) and the characters of all tokens on a line.
+/// If the definition has list options, half of what is left after the command is used for the
+/// list values.
+/// @param octetCount octet count of memory
+/// @param userData passed to the ClashFn and to lineDone
+/// @param responseStream the response output
+/// @param lineDone optional, called after every line that has tokens
+void clashStreamParserInit(ClashStreamParser* self, const struct ClashDefinition* definition,
+    uint8_t* memory, size_t octetCount, void* userData, struct FldOutStream* responseStream,
+    ClashStreamLineFn lineDone)
+{
+    // The state rewinds its scratch when a command is selected, so the tokens are stored after it
+    size_t stateOctetCount = clashDefinitionScratchOctetCount(definition);
+    if (stateOctetCount > octetCount) {
+        stateOctetCount = octetCount;
+    }
+    // The views of list values are stored by the state, it gets half of the rest for them
+    if (clashDefinitionHasListOptions(definition)) {
+        stateOctetCount += (octetCount - stateOctetCount) / 2;
+    }
+    clashScratchInit(&self->scratch, memory, stateOctetCount);
+    clashScratchInit(&self->tokens, memory + stateOctetCount, octetCount - stateOctetCount);
+    clashStateInit(&self->state, definition, &self->scratch, ClashStateFlagTerminatedTokens);
+    self->mode = ClashStreamModeBetweenTokens;
+    self->tokenStart = 0;
+    self->lineTokenCount = 0;
+    self->hasPendingCarriageReturn = 0;
+    self->userData = userData;
+    self->responseStream = responseStream;
+    self->lineDone = lineDone;
+}
+
+static void beginToken(ClashStreamParser* self, ClashStreamMode mode)
+{
+    self->mode = mode;
+    self->tokenStart = self->tokens.pos;
+}
+
+static void tokensExhausted(ClashStreamParser* self, const char* token, size_t length)
+{
+    self->state.token = token;
+    self->state.tokenLength = length;
+    clashStateError(&self->state, ClashParseErrorKindScratchExhausted, -7, 0, 0);
+    self->mode = ClashStreamModeSkipLine;
+}
+
+static void appendToToken(ClashStreamParser* self, const char* start, const char* end)
+{
+    size_t octetCount = (size_t)(end - start);
+    if (octetCount == 0) {
+        return;
+    }
+
+    uint8_t* target = clashScratchAllocOctets(&self->tokens, octetCount);
+    if (target == 0) {
+        tokensExhausted(self, (const char*)self->tokens.memory + self->tokenStart,
+            self->tokens.pos - self->tokenStart);
+        return;
+    }
+    tc_memcpy_octets(target, start, octetCount);
+}
+
+static void endToken(ClashStreamParser* self)
+{
+    const char* token = (const char*)self->tokens.memory + self->tokenStart;
+    size_t length = self->tokens.pos - self->tokenStart;
+    self->mode = ClashStreamModeBetweenTokens;
+
+    char* terminator = clashScratchAllocOctets(&self->tokens, 1);
+    if (terminator == 0) {
+        tokensExhausted(self, token, length);
+        return;
+    }
+    *terminator = 0;
+
+    self->lineTokenCount++;
+    if (clashStateFeed(&self->state, token, length) < 0) {
+        self->mode = ClashStreamModeSkipLine;
+    }
+}
+
+static const char* feedToken(ClashStreamParser* self, const char* p, const char* end)
+{
+    const char* tokenEnd = clashScanToWhitespace(p, end);
+    appendToToken(self, p, tokenEnd);
+    if (tokenEnd != end && self->mode == ClashStreamModeToken) {
+        endToken(self);
+    }
+
+    return tokenEnd;
+}
+
+static const char* feedQuotedToken(ClashStreamParser* self, const char* p, const char* end)
+{
+    const char* close = clashScanToQuotation(p, end);
+    appendToToken(self, p, close);
+    if (close == end) {
+        return end;
+    }
+    if (self->mode == ClashStreamModeQuotedToken) {
+        endToken(self);
+    }
+
+    return close + 1;
+}
+
+static const char* feedBetweenTokens(ClashStreamParser* self, const char* p, const char* end)
+{
+    p = clashScanSkipWhitespace(p, end);
+    if (p == end) {
+        return end;
+    }
+
+    if (*p == '\"') {
+        beginToken(self, ClashStreamModeQuotedToken);
+        return p + 1;
+    }
+    beginToken(self, ClashStreamModeToken);
+
+    return p;
+}
+
+/// Tokenizes characters up to, but not including, a line terminator.
+static void feedSegment(ClashStreamParser* self, const char* p, const char* end)
+{
+    while (p != end) {
+        switch (self->mode) {
+        case ClashStreamModeBetweenTokens:
+            p = feedBetweenTokens(self, p, end);
+            break;
+        case ClashStreamModeToken:
+            p = feedToken(self, p, end);
+            break;
+        case ClashStreamModeQuotedToken:
+            p = feedQuotedToken(self, p, end);
+            break;
+        case ClashStreamModeSkipLine:
+            return;
+        }
+    }
+}
+
+/// Executes the line, reports it to lineDone and makes the parser ready for the next line.
+static void endLine(ClashStreamParser* self)
+{
+    if (self->mode == ClashStreamModeToken) {
+        endToken(self);
+    } else if (self->mode == ClashStreamModeQuotedToken) {
+        self->state.token = (const char*)self->tokens.memory + self->tokenStart;
+        self->state.tokenLength = self->tokens.pos - self->tokenStart;
+        clashStateError(&self->state, ClashParseErrorKindUnterminatedQuote, -1, "\"", 0);
+        self->mode = ClashStreamModeSkipLine;
+    }
+
+    int isEmpty = self->lineTokenCount == 0 && self->mode != ClashStreamModeSkipLine;
+    int errorCode = 0;
+    if (self->mode == ClashStreamModeSkipLine) {
+        errorCode = self->state.error.code;
+    } else if (!isEmpty) {
+        self->state.text.tokens = (const char*)self->tokens.memory;
+        self->state.text.tokensOctetCount = self->tokens.pos;
+        self->state.text.tokenCount = self->lineTokenCount;
+        errorCode = clashStateDispatch(&self->state, self->userData, self->responseStream);
+    }
+
+    if (!isEmpty && self->lineDone != 0) {
+        self->lineDone(self->userData, errorCode, &self->state.error);
+    }
+
+    clashStateReset(&self->state);
+    clashScratchRewind(&self->tokens, 0);
+    self->mode = ClashStreamModeBetweenTokens;
+    self->lineTokenCount = 0;
+}
+
+/// Feeds the next fragment of the input. Every line that is terminated by `\n` in the fragment is
+/// executed before returning, a `\r` before the `\n` is ignored.
+/// @param self the parser
+/// @param octets the fragment, it does not have to be kept after the call
+/// @param octetCount octet count of the fragment
+/// @return number of lines that were completed
+int clashStreamFeed(ClashStreamParser* self, const char* octets, size_t octetCount)
+{
+    const char* p = octets;
+    const char* end = octets + octetCount;
+    int lineCount = 0;
+
+    if (self->hasPendingCarriageReturn && p != end) {
+        self->hasPendingCarriageReturn = 0;
+        if (*p != '\n') {
+            static const char carriageReturn = '\r';
+            feedSegment(self, &carriageReturn, &carriageReturn + 1);
+        }
+    }
+
+    while (p != end) {
+        const char* newLine = memchr(p, '\n', (size_t)(end - p));
+        const char* segmentEnd = newLine == 0 ? end : newLine;
+        if (segmentEnd != p && segmentEnd[-1] == '\r') {
+            // Only part of a line terminator if the next character is a `\n`
+            segmentEnd--;
+            self->hasPendingCarriageReturn = newLine == 0;
+        }
+        feedSegment(self, p, segmentEnd);
+        if (newLine == 0) {
+            break;
+        }
+        endLine(self);
+        lineCount++;
+        p = newLine + 1;
+    }
+
+    return lineCount;
+}
+
+/// Executes the last line if the input ended without a line terminator.
+/// @param self the parser
+/// @return number of lines that were completed, zero or one
+int clashStreamEnd(ClashStreamParser* self)
+{
+    self->hasPendingCarriageReturn = 0;
+    if (self->mode == ClashStreamModeBetweenTokens && self->lineTokenCount == 0) {
+        return 0;
+    }
+
+    endLine(self);
+
+    return 1;
+}
@@ -0,0 +1,253 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clash/clash.h>
+#include <clash/index.h>
+#include <clash/state.h>
+#include <clash/suggest.h>
+#include <tiny-libc/tiny_libc.h>
+
+/// The largest number of edits for a name to still count as a typo of a word.
+/// @param length octet count of the word
+/// @return the maximum distance
+size_t clashSuggestMaxDistance(size_t length)
+{
+    if (length <= 4) {
+        return 1;
+    }
+
+    return length <= 8 ? 2 : 3;
+}
+
+static int characterBit(char c)
+{
+    if (c >= 'a' && c <= 'z') {
+        return c - 'a';
+    }
+    if (c >= 'A' && c <= 'Z') {
+        return c - 'A';
+    }
+    if (c >= '0' && c <= '9') {
+        return 26 + (c - '0');
+    }
+
+    return 36 + (int)((uint8_t)c % 28);
+}
+
+/// A bit for each kind of character in the string. Upper and lower case letters share a bit.
+/// @param s the string
+/// @param length octet count of s
+/// @return the mask
+uint64_t clashSuggestCharacterMask(const char* s, size_t length)
+{
+    uint64_t mask = 0;
+    for (size_t i = 0; i < length; ++i) {
+        mask |= (uint64_t)1 << characterBit(s[i]);
+    }
+
+    return mask;
+}
+
+static size_t bitCount(uint64_t bits)
+{
+    bits = bits - ((bits >> 1) & UINT64_C(0x5555555555555555));
+    bits = (bits & UINT64_C(0x3333333333333333)) + ((bits >> 2) & UINT64_C(0x3333333333333333));
+    bits = (bits + (bits >> 4)) & UINT64_C(0x0f0f0f0f0f0f0f0f);
+
+    return (size_t)((bits * UINT64_C(0x0101010101010101)) >> 56);
+}
+
+/// A lower bound of the edit distance, from the character masks alone. Every kind of character
+/// that only one of the strings has needs at least one edit.
+/// @param maskA clashSuggestCharacterMask() of the first string
+/// @param maskB clashSuggestCharacterMask() of the second string
+/// @return the lower bound
+size_t clashSuggestMinDistance(uint64_t maskA, uint64_t maskB)
+{
+    size_t onlyA = bitCount(maskA & ~maskB);
+    size_t onlyB = bitCount(maskB & ~maskA);
+
+    return onlyA > onlyB ? onlyA : onlyB;
+}
+
+static size_t minimum(size_t a, size_t b)
+{
+    return a < b ? a : b;
+}
+
+/// Edit distance where an insertion, deletion, substitution or swap of two neighbouring characters
+/// is one edit (optimal string alignment). Only the cells within maxDistance of the diagonal are
+/// calculated, and it stops as soon as a whole row is over maxDistance.
+/// @param a first string
+/// @param aLength octet count of a
+/// @param b second string
+/// @param bLength octet count of b
+/// @param maxDistance largest distance that is of interest
+/// @return the distance, or maxDistance + 1 if it is larger than maxDistance
+size_t clashSuggestDistance(
+    const char* a, size_t aLength, const char* b, size_t bLength, size_t maxDistance)
+{
+    size_t over = maxDistance + 1;
+    size_t lengthDifference = aLength > bLength ? aLength - bLength : bLength - aLength;
+    if (lengthDifference > maxDistance || aLength > CLASH_SUGGEST_MAX_LENGTH
+        || bLength > CLASH_SUGGEST_MAX_LENGTH) {
+        return over;
+    }
+
+    size_t rows[3][CLASH_SUGGEST_MAX_LENGTH + 2];
+    size_t* before = rows[0];
+    size_t* previous = rows[1];
+    size_t* current = rows[2];
+
+    for (size_t j = 0; j <= bLength; ++j) {
+        previous[j] = minimum(j, over);
+    }
+
+    for (size_t i = 1; i <= aLength; ++i) {
+        size_t first = i > maxDistance ? i - maxDistance : 1;
+        size_t last = minimum(i + maxDistance, bLength);
+        current[first - 1] = first == 1 ? minimum(i, over) : over;
+        size_t rowMinimum = current[first - 1];
+
+        for (size_t j = first; j <= last; ++j) {
+            size_t cost = a[i - 1] == b[j - 1] ? 0 : 1;
+            size_t value
+                = minimum(previous[j - 1] + cost, minimum(previous[j], current[j - 1]) + 1);
+            if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1]) {
+                value = minimum(value, before[j - 2] + 1);
+            }
+            current[j] = minimum(value, over);
+            rowMinimum = minimum(rowMinimum, current[j]);
+        }
+        if (last < bLength) {
+            current[last + 1] = over;
+        }
+
+        if (rowMinimum > maxDistance) {
+            return over;
+        }
+
+        size_t* oldest = before;
+        before = previous;
+        previous = current;
+        current = oldest;
+    }
+
+    return previous[bLength];
+}
+
+typedef struct Suggestion {
+    const char* word;
+    size_t length;
+    uint64_t characterMask;
+    const char* name;
+    size_t distance;
+} Suggestion;
+
+static void consider(
+    Suggestion* self, const char* name, size_t nameLength, uint64_t nameCharacterMask)
+{
+    // Only a strictly closer name can replace the best one so far
+    if (clashSuggestMinDistance(self->characterMask, nameCharacterMask) >= self->distance) {
+        return;
+    }
+
+    size_t distance
+        = clashSuggestDistance(self->word, self->length, name, nameLength, self->distance - 1);
+    if (distance < self->distance) {
+        self->name = name;
+        self->distance = distance;
+    }
+}
+
+/// Only the names with a length that is close enough can be a typo, and those are next to each
+/// other in names sorted by length.
+static void considerByLength(Suggestion* self, const ClashIndexName* names, size_t count)
+{
+    size_t maxDistance = self->distance - 1;
+    size_t minimumLength = self->length > maxDistance ? self->length - maxDistance : 0;
+    size_t first;
+    size_t rangeCount = clashIndexFindLengthRange(
+        names, count, minimumLength, self->length + maxDistance, &first);
+    for (size_t i = 0; i < rangeCount && self->distance > 1; ++i) {
+        const ClashIndexName* name = &names[first + i];
+        consider(self, name->name, name->length, name->characterMask);
+    }
+}
+
+static void considerCommands(Suggestion* self, const ClashCommand* commands, size_t count)
+{
+    for (size_t i = 0; i < count && self->distance > 1; ++i) {
+        const char* name = commands[i].name;
+        if (name != 0) {
+            size_t length = tc_strlen(name);
+            consider(self, name, length, clashSuggestCharacterMask(name, length));
+        }
+    }
+}
+
+static void considerOptions(Suggestion* self, const ClashCommand* command)
+{
+    for (size_t i = 0; i < command->optionCount && self->distance > 1; ++i) {
+        const char* name = command->options[i].name;
+        if (name != 0) {
+            size_t length = tc_strlen(name);
+            consider(self, name, length, clashSuggestCharacterMask(name, length));
+        }
+    }
+}
+
+static void considerIndexed(Suggestion* self, const ClashState* state, ClashParseErrorKind kind)
+{
+    const ClashIndex* index = state->index;
+    if (kind == ClashParseErrorKindUnknownOption) {
+        const ClashIndexNode* node = &index->nodes[state->nodeIndex];
+        considerByLength(
+            self, &index->optionNamesByLength[node->optionStart], state->command->optionCount);
+        return;
+    }
+
+    size_t nodeIndex
+        = kind == ClashParseErrorKindUnknownCommand ? CLASH_INDEX_ROOT : state->nodeIndex;
+    const ClashIndexNode* node = &index->nodes[nodeIndex];
+    considerByLength(self, &index->childNamesByLength[node->childStart], node->childCount);
+}
+
+/// Finds the name that is closest to an unknown command, sub command or long option, so a typo
+/// can be reported with a "did you mean". Names with too many characters that the word does not
+/// have are skipped before the distance is calculated, and a compiled definition only looks at
+/// the names with a length close to the word.
+/// @param state the state when the word was not found
+/// @param kind ClashParseErrorKindUnknownCommand, ClashParseErrorKindUnknownSubCommand or
+/// ClashParseErrorKindUnknownOption
+/// @param word the unknown word, without the dashes of an option
+/// @param length octet count of word
+/// @return the closest name, or NULL if no name is close enough
+const char* clashSuggestName(
+    const ClashState* state, ClashParseErrorKind kind, const char* word, size_t length)
+{
+    if (length == 0 || length > CLASH_SUGGEST_MAX_LENGTH) {
+        return 0;
+    }
+    if (kind != ClashParseErrorKindUnknownCommand && state->command == 0) {
+        return 0;
+    }
+
+    Suggestion suggestion = { word, length, clashSuggestCharacterMask(word, length), 0,
+        clashSuggestMaxDistance(length) + 1 };
+
+    if (state->index != 0) {
+        considerIndexed(&suggestion, state, kind);
+    } else if (kind == ClashParseErrorKindUnknownOption) {
+        considerOptions(&suggestion, state->command);
+    } else if (kind == ClashParseErrorKindUnknownSubCommand) {
+        considerCommands(
+            &suggestion, state->command->subCommands, state->command->subCommandsCount);
+    } else {
+        considerCommands(
+            &suggestion, state->definition->commands, state->definition->commandCount);
+    }
+
+    return suggestion.name;
+}
@@ -0,0 +1,45 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clash/scan.h>
+#include <clash/tokenizer.h>
+
+/// Finds the next token without copying it. A token is either a run of non whitespace characters
+/// or everything between two quotation marks.
+/// @param cursor where to start scanning, advanced past the token
+/// @param end one past the last character that may be scanned
+/// @param token receives a view into the scanned characters
+/// @return 1 if a token was found, 0 at the end and -1 if a quotation is not terminated
+int clashTokenizerNext(const char** cursor, const char* end, ClashStringView* token)
+{
+    const char* p = clashScanSkipWhitespace(*cursor, end);
+
+    if (p == end) {
+        *cursor = p;
+        return 0;
+    }
+
+    if (*p == '\"') {
+        const char* start = p + 1;
+        const char* close = clashScanToQuotation(start, end);
+        if (close == end) {
+            token->str = p;
+            token->length = (size_t)(end - p);
+            return -1;
+        }
+        token->str = start;
+        token->length = (size_t)(close - start);
+        *cursor = close + 1;
+        return 1;
+    }
+
+    const char* start = p;
+    p = clashScanToWhitespace(p, end);
+
+    token->str = start;
+    token->length = (size_t)(p - start);
+    *cursor = p;
+
+    return 1;
+}
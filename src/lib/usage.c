@@ -0,0 +1,236 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clash/clash.h>
+#include <clash/index.h>
+#include <clash/usage.h>
+#include <flood/out_stream.h>
+#include <tiny-libc/tiny_libc.h>
+
+#define CLASH_USAGE_INITIAL_OCTET_COUNT (1024)
+
+static int insertIndentation(FldOutStream* stream, size_t indentation)
+{
+    for (size_t i = 0; i < indentation; ++i) {
+        int errorCode = fldOutStreamWrites(stream, "    ");
+        if (errorCode < 0) {
+            return errorCode;
+        }
+    }
+
+    return 0;
+}
+
+static int usageOptions(FldOutStream* stream, const struct ClashCommand* cmd, size_t indentation)
+{
+    int errorCode = 0;
+
+    for (size_t i = 0; i < cmd->optionCount; ++i) {
+        const ClashOption* option = &cmd->options[i];
+        if (option->type & ClashTypeArg) {
+            const char* more = (option->type & ClashTypeList) ? "..." : "";
+            errorCode |= fldOutStreamWritef(stream, " [%s%s]", option->name, more);
+        } else {
+            errorCode |= fldOutStreamWritef(stream, " [options]");
+            break;
+        }
+    }
+
+    errorCode |= fldOutStreamWritef(stream, "\n");
+
+    for (size_t j = 0; j < cmd->optionCount; ++j) {
+        errorCode |= insertIndentation(stream, indentation + 1);
+        const ClashOption* option = &cmd->options[j];
+        if (option->type & ClashTypeArg) {
+            errorCode |= fldOutStreamWritef(stream, "   %-10s", option->name);
+        } else {
+            if (option->shortName != ' ' && option->shortName != 0) {
+                errorCode |= fldOutStreamWritef(stream, "   -%c", option->shortName);
+            }
+
+            if (option->name != 0) {
+                errorCode |= fldOutStreamWritef(stream, "   --%s", option->name);
+            }
+        }
+        if (option->value != 0 && tc_strlen(option->value) > 0) {
+            errorCode |= fldOutStreamWritef(stream, " default: '%s'", option->value);
+        }
+
+        errorCode |= fldOutStreamWritef(stream, "   %s\n", option->description);
+    }
+
+    return errorCode < 0 ? -1 : 0;
+}
+
+/// Renders the usage of a command and all of its sub commands.
+/// If index is set, the offsets of each rendered command are recorded in the index nodes.
+static int usageCommand(FldOutStream* stream, const struct ClashCommand* cmd, size_t indentation,
+    ClashIndex* index, size_t nodeIndex)
+{
+    size_t start = stream->pos;
+
+    int errorCode = fldOutStreamWritef(stream, "\n");
+    errorCode |= insertIndentation(stream, indentation);
+    errorCode |= fldOutStreamWritef(stream, "%s", cmd->name);
+    if (errorCode < 0) {
+        return -1;
+    }
+
+    if (cmd->subCommands != 0) {
+        errorCode = fldOutStreamWritef(stream, "\n");
+        for (size_t i = 0; i < cmd->subCommandsCount && errorCode >= 0; ++i) {
+            size_t childIndex = index == 0 ? 0 : index->nodes[nodeIndex].childStart + i;
+            errorCode
+                = usageCommand(stream, &cmd->subCommands[i], indentation + 1, index, childIndex);
+        }
+    } else {
+        errorCode = usageOptions(stream, cmd, indentation);
+    }
+
+    if (index != 0) {
+        index->nodeInfos[nodeIndex].usageStart = start;
+        index->nodeInfos[nodeIndex].usageEnd = stream->pos;
+    }
+
+    return errorCode;
+}
+
+static int usageCommands(FldOutStream* stream, const struct ClashCommand* commands, size_t count,
+    ClashIndex* index, size_t childStart)
+{
+    for (size_t i = 0; i < count; ++i) {
+        int errorCode = usageCommand(stream, &commands[i], 0, index, childStart + i);
+        if (errorCode < 0) {
+            return errorCode;
+        }
+    }
+
+    return 0;
+}
+
+/// Renders the usage text for the whole definition once into a heap buffer owned by the index,
+/// and records the slice each command occupies, so the usage functions can copy instead of format.
+/// @param index the index of the definition, must be initialized
+/// @param definition the definition
+/// @return negative on error
+int clashUsageRender(ClashIndex* index, const ClashDefinition* definition)
+{
+    ClashIndexNodeInfo* root = &index->nodeInfos[CLASH_INDEX_ROOT];
+
+    for (size_t capacity = CLASH_USAGE_INITIAL_OCTET_COUNT;; capacity *= 2) {
+        char* text = tc_malloc(capacity);
+        if (text == 0) {
+            return -1;
+        }
+
+        FldOutStream stream;
+        fldOutStreamInit(&stream, (uint8_t*)text, capacity);
+        int errorCode = usageCommands(
+            &stream, definition->commands, definition->commandCount, index,
+            index->nodes[CLASH_INDEX_ROOT].childStart);
+        if (errorCode >= 0) {
+            index->usage = text;
+            index->usageOctetCount = stream.pos;
+            index->heapOctetCount += capacity;
+            root->usageStart = 0;
+            root->usageEnd = stream.pos;
+            return 0;
+        }
+
+        tc_free(text);
+    }
+}
+
+static int writeUsageSlice(
+    const ClashIndex* index, const ClashIndexNodeInfo* node, FldOutStream* outStream)
+{
+    const uint8_t* octets = (const uint8_t*)&index->usage[node->usageStart];
+    int errorCode = fldOutStreamWriteOctets(outStream, octets, node->usageEnd - node->usageStart);
+    if (errorCode < 0) {
+        return errorCode;
+    }
+
+    return fldOutStreamWriteUInt8(outStream, 0);
+}
+
+void clashUsageToStream(const ClashDefinition* definition, FldOutStream* outStream)
+{
+    if (definition->index != 0 && definition->index->usage != 0) {
+        writeUsageSlice(
+            definition->index, &definition->index->nodeInfos[CLASH_INDEX_ROOT], outStream);
+        return;
+    }
+
+    usageCommands(outStream, definition->commands, definition->commandCount, 0, 0);
+
+    fldOutStreamWriteUInt8(outStream, 0);
+}
+
+const char* clashUsage(const ClashDefinition* definition, char* buf, size_t maxCount)
+{
+    FldOutStream outStream;
+    fldOutStreamInit(&outStream, (uint8_t*)buf, maxCount);
+
+    clashUsageToStream(definition, &outStream);
+
+    return buf;
+}
+
+static const ClashCommand* findCommand(
+    const ClashCommand* commands, size_t count, const char* name)
+{
+    for (size_t i = 0; i < count; ++i) {
+        if (tc_str_equal(commands[i].name, name)) {
+            return &commands[i];
+        }
+    }
+
+    return 0;
+}
+
+/// Writes the usage for a single command (and its sub commands), e.g. for `help record start`.
+/// On a compiled definition this is a copy of the pre-rendered text.
+/// @param definition the definition
+/// @param path the command names, from the top level command and down
+/// @param pathCount number of names in path
+/// @param outStream receives the zero terminated usage text
+/// @return negative on error, -4 if the command is not found, -5 if a sub command is not found
+int clashUsageCommandToStream(const ClashDefinition* definition, const char** path,
+    size_t pathCount, FldOutStream* outStream)
+{
+    const ClashIndex* index = definition->index;
+    if (index != 0 && index->usage != 0) {
+        size_t nodeIndex = CLASH_INDEX_ROOT;
+        for (size_t i = 0; i < pathCount; ++i) {
+            int foundIndex = clashIndexFindChild(index, nodeIndex, path[i], tc_strlen(path[i]));
+            if (foundIndex < 0) {
+                return i == 0 ? -4 : -5;
+            }
+            nodeIndex = (size_t)foundIndex;
+        }
+
+        return writeUsageSlice(index, &index->nodeInfos[nodeIndex], outStream);
+    }
+
+    const ClashCommand* commands = definition->commands;
+    size_t commandCount = definition->commandCount;
+    const ClashCommand* command = 0;
+    for (size_t i = 0; i < pathCount; ++i) {
+        command = findCommand(commands, commandCount, path[i]);
+        if (command == 0) {
+            return i == 0 ? -4 : -5;
+        }
+        commands = command->subCommands;
+        commandCount = command->subCommandsCount;
+    }
+
+    int errorCode = command == 0
+        ? usageCommands(outStream, definition->commands, definition->commandCount, 0, 0)
+        : usageCommand(outStream, command, pathCount - 1, 0, 0);
+    if (errorCode < 0) {
+        return errorCode;
+    }
+
+    return fldOutStreamWriteUInt8(outStream, 0);
+}
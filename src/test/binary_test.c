@@ -0,0 +1,236 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include "test.h"
+#include <clash/async.h>
+#include <clash/binary.h>
+#include <clash/clash.h>
+#include <clash/history.h>
+#include <clash/scratch.h>
+#include <flood/out_stream.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+// A command executed from its binary encoding must get exactly the struct that parsing the text
+// gives, for every option type. Views and lists only live during the ClashFn, so the ClashFn
+// formats the struct and the formatted text is compared.
+
+#define BINARY_TEST_TEXT_OCTETS (512)
+#define BINARY_TEST_HISTORY_PATH "clash-binary-test.history"
+
+typedef struct AllTypes {
+    const char* name;
+    int count;
+    int64_t offset;
+    uint64_t size;
+    double ratio;
+    int64_t timeout;
+    bool enabled;
+    int verbose;
+    ClashStringView label;
+    ClashStringList tags;
+    const char* mode;
+} AllTypes;
+
+static const char* const g_modes[] = { "fast", "safe", 0 };
+
+static const ClashOption g_allOptions[] = {
+    { "name", 'n', "", ClashTypeString | ClashTypeArg, "none", offsetof(AllTypes, name), 0, 0, 0 },
+    { "count", 'c', "", ClashTypeInt, "7", offsetof(AllTypes, count), -10, 10, 0 },
+    { "offset", 'o', "", ClashTypeInt64, "0", offsetof(AllTypes, offset), 0, 0, 0 },
+    { "size", 's', "", ClashTypeUInt64, "0", offsetof(AllTypes, size), 0, 0, 0 },
+    { "ratio", 'r', "", ClashTypeDouble, "0.5", offsetof(AllTypes, ratio), 0, 0, 0 },
+    { "timeout", 't', "", ClashTypeDuration, "2s", offsetof(AllTypes, timeout), 0, 0, 0 },
+    { "enabled", 'e', "", ClashTypeBool, "", offsetof(AllTypes, enabled), 0, 0, 0 },
+    { "verbose", 'v', "", ClashTypeFlag, "", offsetof(AllTypes, verbose), 0, 0, 0 },
+    { "label", 'l', "", ClashTypeString | ClashTypeView, "", offsetof(AllTypes, label), 0, 0, 0 },
+    { "tag", 'g', "", ClashTypeString | ClashTypeList, "", offsetof(AllTypes, tags), 0, 0, 0 },
+    { "mode", 'm', "", ClashTypeString, "safe", offsetof(AllTypes, mode), 0, 0, g_modes },
+};
+
+#define BINARY_TEST_OPTION_COUNT (sizeof(g_allOptions) / sizeof(g_allOptions[0]))
+
+static void formatAll(void* userData, const void* data, struct ClashResponse* response);
+
+static const ClashCommand g_commands[] = {
+    { "all", "", sizeof(AllTypes), g_allOptions, BINARY_TEST_OPTION_COUNT, 0, 0, formatAll, 0 },
+    { "later", "", sizeof(AllTypes), g_allOptions, BINARY_TEST_OPTION_COUNT, 0, 0, formatAll,
+        ClashCommandFlagAsync },
+};
+
+/// Formats every field, doubles with all their digits
+static void formatAll(void* userData, const void* data, struct ClashResponse* response)
+{
+    (void)response;
+    const AllTypes* all = data;
+    char* text = userData;
+    int length = snprintf(text, BINARY_TEST_TEXT_OCTETS,
+        "%s|%d|%" PRId64 "|%" PRIu64 "|%.17g|%" PRId64 "|%d|%d|%.*s|%s|", all->name, all->count,
+        all->offset, all->size, all->ratio, all->timeout, all->enabled, all->verbose,
+        (int)all->label.length, all->label.str == 0 ? "" : all->label.str, all->mode);
+    for (size_t i = 0; i < all->tags.count && length > 0; ++i) {
+        length += snprintf(text + length, BINARY_TEST_TEXT_OCTETS - (size_t)length, "%.*s,",
+            (int)all->tags.values[i].length, all->tags.values[i].str);
+    }
+}
+
+static void asyncDone(void* context, struct FldOutStream* responseStream)
+{
+    (void)context;
+    (void)responseStream;
+}
+
+typedef struct BinaryTest {
+    ClashDefinition definition;
+    ClashHistory history;
+    int hasHistory;
+    size_t historyOffset;
+    uint8_t memory[2048];
+    ClashScratch scratch;
+    uint8_t responseBuffer[64];
+    FldOutStream responseStream;
+} BinaryTest;
+
+static void resetStreams(BinaryTest* self)
+{
+    clashScratchInit(&self->scratch, self->memory, sizeof(self->memory));
+    fldOutStreamInit(&self->responseStream, self->responseBuffer, sizeof(self->responseBuffer));
+}
+
+/// The binary command is recorded as text, which must parse to the same struct again
+static void replayRecorded(BinaryTest* self, const char* expected)
+{
+    ClashHistoryRecord record;
+    const char* argv[32];
+    char replayed[BINARY_TEST_TEXT_OCTETS] = "";
+
+    CLASH_TEST_CHECK(clashHistoryNext(&self->history, &self->historyOffset, &record) == 1);
+    int argc = clashHistoryRecordArgv(&record, argv, 32);
+    CLASH_TEST_CHECK(argc > 0);
+
+    resetStreams(self);
+    int result = clashParseEx(
+        &self->definition, argv, argc, replayed, &self->responseStream, &self->scratch, 0);
+    CLASH_TEST_CHECK(result == 0);
+    CLASH_TEST_CHECK(strcmp(expected, replayed) == 0);
+}
+
+static void roundTrip(BinaryTest* self, const char* line)
+{
+    char parsed[BINARY_TEST_TEXT_OCTETS] = "";
+    char decoded[BINARY_TEST_TEXT_OCTETS] = "";
+    uint8_t encoded[256];
+    FldOutStream encodedStream;
+
+    resetStreams(self);
+    int result = clashParseStringEx(
+        &self->definition, line, parsed, &self->responseStream, &self->scratch, 0);
+    CLASH_TEST_CHECK(result == 0);
+
+    fldOutStreamInit(&encodedStream, encoded, sizeof(encoded));
+    int octetCount
+        = clashBinaryEncodeString(&self->definition, line, &encodedStream, &self->scratch, 0);
+    CLASH_TEST_CHECK(octetCount > 0);
+    // Only the binary command is recorded
+    clashDefinitionSetHistory(&self->definition, self->hasHistory ? &self->history : 0);
+    result = clashBinaryExecute(&self->definition, encoded, (size_t)octetCount, decoded,
+        &self->responseStream, &self->scratch, 0);
+    clashDefinitionSetHistory(&self->definition, 0);
+    CLASH_TEST_CHECK(result == 0);
+    if (!CLASH_TEST_CHECK(strcmp(parsed, decoded) == 0)) {
+        printf("  %s\n  parsed  %s\n  decoded %s\n", line, parsed, decoded);
+    }
+
+    if (self->hasHistory) {
+        replayRecorded(self, parsed);
+    }
+}
+
+/// A struct filled in directly, with values that text rarely produces
+static void encodeCommand(BinaryTest* self)
+{
+    static const ClashStringView tags[] = { { "x", 1 }, { "", 0 }, { "y z", 3 } };
+    AllTypes all = { "direct", -10, INT64_MIN, UINT64_MAX, -0.0, INT64_MAX, true, 300,
+        { "view", 4 }, { tags, 3 }, "fast" };
+    char expected[BINARY_TEST_TEXT_OCTETS];
+    char decoded[BINARY_TEST_TEXT_OCTETS] = "";
+    uint8_t encoded[256];
+    FldOutStream encodedStream;
+
+    formatAll(expected, &all, 0);
+    resetStreams(self);
+    fldOutStreamInit(&encodedStream, encoded, sizeof(encoded));
+    int octetCount
+        = clashBinaryEncodeCommand(&self->definition, &g_commands[0], &all, &encodedStream);
+    CLASH_TEST_CHECK(octetCount > 0);
+    int result = clashBinaryExecute(&self->definition, encoded, (size_t)octetCount, decoded,
+        &self->responseStream, &self->scratch, 0);
+    CLASH_TEST_CHECK(result == 0);
+    CLASH_TEST_CHECK(strcmp(expected, decoded) == 0);
+
+    // A value outside the bounds is rejected like in text
+    all.count = 11;
+    fldOutStreamInit(&encodedStream, encoded, sizeof(encoded));
+    octetCount = clashBinaryEncodeCommand(&self->definition, &g_commands[0], &all, &encodedStream);
+    result = clashBinaryExecute(&self->definition, encoded, (size_t)octetCount, decoded,
+        &self->responseStream, &self->scratch, 0);
+    CLASH_TEST_CHECK(result < 0);
+}
+
+/// An async command is queued by clashAsyncBinaryExecute() and gets the same struct
+static void asyncRoundTrip(BinaryTest* self)
+{
+    static const char* line = "later q --count=-1 --ratio=3.25 -vv --tag=t --mode=fast";
+    char parsed[BINARY_TEST_TEXT_OCTETS] = "";
+    char decoded[BINARY_TEST_TEXT_OCTETS] = "";
+    uint8_t encoded[256];
+    FldOutStream encodedStream;
+
+    resetStreams(self);
+    clashParseStringEx(&self->definition, line, parsed, &self->responseStream, &self->scratch, 0);
+    fldOutStreamInit(&encodedStream, encoded, sizeof(encoded));
+    int octetCount
+        = clashBinaryEncodeString(&self->definition, line, &encodedStream, &self->scratch, 0);
+    CLASH_TEST_CHECK(octetCount > 0);
+
+    ClashAsync async;
+    CLASH_TEST_CHECK(clashAsyncInit(&async, &self->definition, 2, 128, 64, asyncDone) == 0);
+    int result = clashAsyncBinaryExecute(
+        &async, encoded, (size_t)octetCount, decoded, 0, &self->responseStream, 0);
+    CLASH_TEST_CHECK(result == CLASH_ASYNC_QUEUED);
+    CLASH_TEST_CHECK(decoded[0] == 0);
+    CLASH_TEST_CHECK(clashAsyncExecuteNext(&async) == 1);
+    CLASH_TEST_CHECK(strcmp(parsed, decoded) == 0);
+    clashAsyncDestroy(&async);
+}
+
+void testBinary(void)
+{
+    static const char* const lines[] = {
+        "all",
+        "all first --count=-5 --offset -9000000000 --size 18446744073709551615 --ratio 0.1"
+        " --timeout 1500ms --enabled=true -vvv --label=lab --tag a --tag \"b c\" --mode fast",
+        "all second --ratio=-2.5e-3 --enabled=no --tag=z --size=0x10 --timeout=3m -c 10",
+        "all third -e --label= --offset=-1 --ratio 1e300",
+    };
+
+    static BinaryTest test;
+    test.definition.commands = g_commands;
+    test.definition.commandCount = sizeof(g_commands) / sizeof(g_commands[0]);
+    CLASH_TEST_CHECK(clashDefinitionCompile(&test.definition) == 0);
+    // The history is only supported where files can be memory mapped
+    test.hasHistory = clashHistoryCreate(&test.history, BINARY_TEST_HISTORY_PATH, 64 * 1024) >= 0;
+
+    for (size_t i = 0; i < sizeof(lines) / sizeof(lines[0]); ++i) {
+        roundTrip(&test, lines[i]);
+    }
+    encodeCommand(&test);
+    asyncRoundTrip(&test);
+    clashHistoryClose(&test.history);
+    remove(BINARY_TEST_HISTORY_PATH);
+
+    clashDefinitionDestroy(&test.definition);
+}
@@ -0,0 +1,67 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include "test.h"
+#include <clash/convert.h>
+#include <locale.h>
+#include <stdio.h>
+#include <string.h>
+
+// The exponent of a double is plain decimal, and the strtod() fallback must use the whole value
+// and must not depend on the decimal point of the locale.
+
+typedef struct ConvertDoubleCase {
+    const char* text;
+    int errorCode;
+    double value;
+} ConvertDoubleCase;
+
+static const ConvertDoubleCase g_doubleCases[] = {
+    { "1e10", 0, 1e10 },
+    { "-2.5e-3", 0, -2.5e-3 },
+    { "1e+300", 0, 1e300 },
+    { "1_000.25E2", 0, 100025.0 },
+    { "12345678901234567890e-5", 0, 123456789012345.67890 },
+    { "3.14159265358979323", 0, 3.14159265358979323 },
+    { "-1.5e40", 0, -1.5e40 },
+    { "2.5E-30", 0, 2.5e-30 },
+    { "1e0x10", CLASH_CONVERT_INVALID, 0 },
+    { "1e0x30", CLASH_CONVERT_INVALID, 0 },
+    { "1e0b11", CLASH_CONVERT_INVALID, 0 },
+    { "1e1_0", CLASH_CONVERT_INVALID, 0 },
+    { "1e", CLASH_CONVERT_INVALID, 0 },
+    { "1e-", CLASH_CONVERT_INVALID, 0 },
+    { "1e5x", CLASH_CONVERT_INVALID, 0 },
+    { "12345678901234567890e0x30", CLASH_CONVERT_INVALID, 0 },
+    { "1e999999", CLASH_CONVERT_INVALID, 0 },
+    { "3,14159265358979323", CLASH_CONVERT_INVALID, 0 },
+};
+
+static void checkDoubles(void)
+{
+    for (size_t i = 0; i < sizeof(g_doubleCases) / sizeof(g_doubleCases[0]); ++i) {
+        const ConvertDoubleCase* c = &g_doubleCases[i];
+        double value = 0;
+        int errorCode = clashConvertDouble(c->text, strlen(c->text), &value);
+        if (!CLASH_TEST_CHECK(errorCode == c->errorCode && (errorCode < 0 || value == c->value))) {
+            printf("  %s gave %d %.17g\n", c->text, errorCode, value);
+        }
+    }
+}
+
+void testConvert(void)
+{
+    checkDoubles();
+
+    // Only checked where a locale with a decimal comma is installed
+    static const char* const commaLocales[] = { "de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8",
+        "sv_SE.UTF-8", "German_Germany.1252" };
+    for (size_t i = 0; i < sizeof(commaLocales) / sizeof(commaLocales[0]); ++i) {
+        if (setlocale(LC_NUMERIC, commaLocales[i]) != 0) {
+            checkDoubles();
+            break;
+        }
+    }
+    setlocale(LC_NUMERIC, "C");
+}
@@ -0,0 +1,165 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include "test.h"
+#include <clash/async.h>
+#include <clash/binary.h>
+#include <clash/clash.h>
+#include <clash/compiled.h>
+#include <clash/history.h>
+#include <clash/scratch.h>
+#include <flood/out_stream.h>
+#include <stdio.h>
+#include <string.h>
+
+// Every way of executing a command must record it, and the recorded text must parse back to the
+// same command.
+
+#define HISTORY_TEST_PATH "clash-test.history"
+
+typedef struct PutCommand {
+    const char* name;
+    int verbose;
+    int count;
+} PutCommand;
+
+static void onPut(void* userData, const void* data, struct ClashResponse* response)
+{
+    (void)response;
+    if (userData != 0) {
+        *(PutCommand*)userData = *(const PutCommand*)data;
+    }
+}
+
+static const ClashOption g_putOptions[] = {
+    { "name", 'n', "the name", ClashTypeString | ClashTypeArg, "", offsetof(PutCommand, name), 0, 0,
+        0 },
+    { "verbose", 'v', "more output", ClashTypeFlag, "", offsetof(PutCommand, verbose), 0, 0, 0 },
+    { "count", 'c', "how many", ClashTypeInt, "0", offsetof(PutCommand, count), 0, 0, 0 },
+};
+
+static const ClashCommand g_commands[] = {
+    { "put", "puts", sizeof(PutCommand), g_putOptions,
+        sizeof(g_putOptions) / sizeof(g_putOptions[0]), 0, 0, onPut, 0 },
+    { "slow", "puts later", sizeof(PutCommand), g_putOptions,
+        sizeof(g_putOptions) / sizeof(g_putOptions[0]), 0, 0, onPut, ClashCommandFlagAsync },
+};
+
+static void onAsyncDone(void* context, struct FldOutStream* responseStream)
+{
+    (void)context;
+    (void)responseStream;
+}
+
+static void executeAll(ClashDefinition* definition, FldOutStream* responseStream)
+{
+    // A parse cache miss and then a hit
+    CLASH_TEST_CHECK(clashParseString(definition, "put a --count 1", 0, responseStream) == 0);
+    CLASH_TEST_CHECK(clashParseString(definition, "put a --count 1", 0, responseStream) == 0);
+
+    ClashCompiledCommand* compiled = clashCompileCommand(definition, "put b -v", 0);
+    CLASH_TEST_CHECK(compiled != 0);
+    if (compiled != 0) {
+        CLASH_TEST_CHECK(clashExecuteCompiled(compiled, 0, responseStream) == 0);
+        clashCompiledCommandDestroy(compiled);
+    }
+
+    uint8_t memory[1024];
+    uint8_t encoded[128];
+    ClashScratch scratch;
+    FldOutStream encodedStream;
+    clashScratchInit(&scratch, memory, sizeof(memory));
+    fldOutStreamInit(&encodedStream, encoded, sizeof(encoded));
+    int octetCount = clashBinaryEncodeString(
+        definition, "put \"c d\" --count=3 -vv", &encodedStream, &scratch, 0);
+    CLASH_TEST_CHECK(octetCount > 0);
+    int result = clashBinaryExecute(
+        definition, encoded, (size_t)octetCount, 0, responseStream, &scratch, 0);
+    CLASH_TEST_CHECK(result == 0);
+
+    ClashAsync async;
+    CLASH_TEST_CHECK(clashAsyncInit(&async, definition, 2, 64, 64, onAsyncDone) == 0);
+    CLASH_TEST_CHECK(
+        clashAsyncParseString(&async, "slow e", 0, 0, responseStream, 0) == CLASH_ASYNC_QUEUED);
+    CLASH_TEST_CHECK(clashAsyncExecuteNext(&async) == 1);
+    clashAsyncDestroy(&async);
+}
+
+typedef struct ExpectedRecord {
+    const char* text;
+    PutCommand command;
+} ExpectedRecord;
+
+static void checkRecord(const ClashHistory* history, size_t* offset,
+    const ClashDefinition* definition, const ExpectedRecord* expected)
+{
+    ClashHistoryRecord record;
+    const char* argv[16];
+    char text[128];
+    size_t length = 0;
+
+    CLASH_TEST_CHECK(clashHistoryNext(history, offset, &record) == 1);
+    int argc = clashHistoryRecordArgv(&record, argv, 16);
+    CLASH_TEST_CHECK(argc > 0);
+    for (int i = 0; i < argc; ++i) {
+        length += (size_t)snprintf(text + length, sizeof(text) - length, i == 0 ? "%s" : " %s",
+            argv[i]);
+    }
+    CLASH_TEST_CHECK(strcmp(text, expected->text) == 0);
+
+    // The recorded text must execute the same command again
+    uint8_t memory[1024];
+    uint8_t responseBuffer[64];
+    ClashScratch scratch;
+    FldOutStream responseStream;
+    PutCommand command;
+    clashScratchInit(&scratch, memory, sizeof(memory));
+    fldOutStreamInit(&responseStream, responseBuffer, sizeof(responseBuffer));
+    memset(&command, 0, sizeof(command));
+    CLASH_TEST_CHECK(
+        clashParseEx(definition, argv, argc, &command, &responseStream, &scratch, 0) == 0);
+    CLASH_TEST_CHECK(command.name != 0 && strcmp(command.name, expected->command.name) == 0);
+    CLASH_TEST_CHECK(command.verbose == expected->command.verbose);
+    CLASH_TEST_CHECK(command.count == expected->command.count);
+}
+
+void testHistory(void)
+{
+    ClashDefinition definition = { g_commands, sizeof(g_commands) / sizeof(g_commands[0]), 0, 0 };
+    CLASH_TEST_CHECK(clashDefinitionCompile(&definition) == 0);
+    CLASH_TEST_CHECK(clashDefinitionEnableParseCache(&definition, 4096) == 0);
+
+    ClashHistory history;
+    if (clashHistoryCreate(&history, HISTORY_TEST_PATH, 64 * 1024) < 0) {
+        // Only supported where files can be memory mapped
+        clashDefinitionDestroy(&definition);
+        return;
+    }
+    clashDefinitionSetHistory(&definition, &history);
+
+    uint8_t responseBuffer[64];
+    FldOutStream responseStream;
+    fldOutStreamInit(&responseStream, responseBuffer, sizeof(responseBuffer));
+    executeAll(&definition, &responseStream);
+    // The checks below parse the recorded commands again, they must not be recorded
+    clashDefinitionSetHistory(&definition, 0);
+
+    static const ExpectedRecord expected[] = {
+        { "put a --count 1", { "a", 0, 1 } },
+        { "put a --count 1", { "a", 0, 1 } },
+        { "put b -v", { "b", 1, 0 } },
+        { "put --name=c d --verbose --verbose --count=3", { "c d", 2, 3 } },
+        { "slow e", { "e", 0, 0 } },
+    };
+    size_t offset = 0;
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); ++i) {
+        checkRecord(&history, &offset, &definition, &expected[i]);
+    }
+    ClashHistoryRecord record;
+    CLASH_TEST_CHECK(clashHistoryNext(&history, &offset, &record) == 0);
+
+    clashHistoryClose(&history);
+    remove(HISTORY_TEST_PATH);
+    clashDefinitionDestroy(&definition);
+}
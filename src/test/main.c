@@ -0,0 +1,56 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include "test.h"
+#include <stdio.h>
+
+static size_t g_checkCount;
+static size_t g_failedCount;
+static uint32_t g_randomState = 0x9e3779b9u;
+
+int testCheck(int isTrue, const char* text, const char* file, int line)
+{
+    g_checkCount++;
+    if (!isTrue) {
+        g_failedCount++;
+        printf("%s:%d: check failed: %s\n", file, line, text);
+    }
+
+    return isTrue;
+}
+
+/// xorshift32, so every run uses the same sequence
+uint32_t testRandom(void)
+{
+    uint32_t x = g_randomState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    g_randomState = x;
+
+    return x;
+}
+
+typedef struct TestGroup {
+    const char* name;
+    void (*fn)(void);
+} TestGroup;
+
+int main(void)
+{
+    static const TestGroup groups[] = { { "binary", testBinary }, { "convert", testConvert },
+        { "history", testHistory }, { "scan", testScan },
+        { "state", testState }, { "stats", testStats },
+        { "threads", testThreads } };
+
+    for (size_t i = 0; i < sizeof(groups) / sizeof(groups[0]); ++i) {
+        size_t failedBefore = g_failedCount;
+        groups[i].fn();
+        printf("%-10s %s\n", groups[i].name, g_failedCount == failedBefore ? "ok" : "FAILED");
+    }
+
+    printf("%zu checks, %zu failed\n", g_checkCount, g_failedCount);
+
+    return g_failedCount == 0 ? 0 : 1;
+}
@@ -0,0 +1,90 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include "test.h"
+#include <clash/scan.h>
+
+// The block scanners must find exactly what the scalar loops find, for every start and end, so
+// each block size (16 and 32) is crossed with the match before, on and after the boundary.
+
+#define SCAN_TEST_OCTETS (160)
+
+typedef const char* (*ScanFn)(const char* p, const char* end);
+
+static char randomCharacter(int isMostlyWhitespace)
+{
+    static const char whitespace[] = { ' ', '\t', '\n', '\r', '\v', '\f' };
+    static const char other[] = { 'a', 'Z', '0', '"', '\'', '-', '=', '\\', (char)0x80, (char)0xff,
+        (char)0x1f, (char)0x21 };
+    uint32_t value = testRandom();
+    int isWhitespace = (value % 8u) < (isMostlyWhitespace ? 7u : 1u);
+    value >>= 3;
+
+    return isWhitespace ? whitespace[value % sizeof(whitespace)] : other[value % sizeof(other)];
+}
+
+static void compareAll(const char* buffer, size_t octetCount, ScanFn scan, ScanFn scalar)
+{
+    for (size_t start = 0; start <= octetCount; ++start) {
+        for (size_t end = start; end <= octetCount; ++end) {
+            const char* found = scan(buffer + start, buffer + end);
+            const char* expected = scalar(buffer + start, buffer + end);
+            if (!CLASH_TEST_CHECK(found == expected)) {
+                return;
+            }
+        }
+    }
+}
+
+static void compareScanners(const char* buffer, size_t octetCount)
+{
+    compareAll(buffer, octetCount, clashScanSkipWhitespace, clashScanSkipWhitespaceScalar);
+    compareAll(buffer, octetCount, clashScanToWhitespace, clashScanToWhitespaceScalar);
+    compareAll(buffer, octetCount, clashScanToQuotation, clashScanToQuotationScalar);
+}
+
+/// A single match at every offset, in a run of the other kind of character
+static void testBoundaries(char* buffer)
+{
+    static const char runs[] = { ' ', 'a' };
+    static const char matches[] = { 'a', ' ', '"', '\t' };
+
+    for (size_t r = 0; r < sizeof(runs); ++r) {
+        for (size_t m = 0; m < sizeof(matches); ++m) {
+            for (size_t offset = 0; offset < SCAN_TEST_OCTETS; ++offset) {
+                for (size_t i = 0; i < SCAN_TEST_OCTETS; ++i) {
+                    buffer[i] = runs[r];
+                }
+                buffer[offset] = matches[m];
+                const char* end = buffer + SCAN_TEST_OCTETS;
+                for (size_t start = 0; start <= offset; ++start) {
+                    const char* p = buffer + start;
+                    CLASH_TEST_CHECK(clashScanSkipWhitespace(p, end)
+                        == clashScanSkipWhitespaceScalar(p, end));
+                    CLASH_TEST_CHECK(
+                        clashScanToWhitespace(p, end) == clashScanToWhitespaceScalar(p, end));
+                    CLASH_TEST_CHECK(
+                        clashScanToQuotation(p, end) == clashScanToQuotationScalar(p, end));
+                }
+            }
+        }
+    }
+}
+
+void testScan(void)
+{
+    // One octet extra, so a pointer one past the last tested octet is valid
+    static char buffer[SCAN_TEST_OCTETS + 1];
+
+    for (int round = 0; round < 40; ++round) {
+        size_t octetCount = 1 + testRandom() % SCAN_TEST_OCTETS;
+        int isMostlyWhitespace = round % 2;
+        for (size_t i = 0; i < octetCount; ++i) {
+            buffer[i] = randomCharacter(isMostlyWhitespace);
+        }
+        compareScanners(buffer, octetCount);
+    }
+
+    testBoundaries(buffer);
+}
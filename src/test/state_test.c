@@ -0,0 +1,171 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include "test.h"
+#include <clash/clash.h>
+#include <clash/parse_error.h>
+#include <clash/scratch.h>
+#include <clash/state.h>
+#include <flood/out_stream.h>
+#include <string.h>
+
+typedef struct GoCommand {
+    const char* name;
+    int verbose;
+    int count;
+} GoCommand;
+
+static void onGo(void* userData, const void* data, struct ClashResponse* response)
+{
+    (void)response;
+    *(GoCommand*)userData = *(const GoCommand*)data;
+}
+
+static const ClashOption g_goOptions[] = {
+    { "name", 'n', "the name", ClashTypeString | ClashTypeArg, "", offsetof(GoCommand, name), 0, 0,
+        0 },
+    { "verbose", 'v', "more output", ClashTypeFlag, "", offsetof(GoCommand, verbose), 0, 0, 0 },
+    { "count", 'c', "how many", ClashTypeInt, "0", offsetof(GoCommand, count), 0, 0, 0 },
+};
+
+typedef struct TagCommand {
+    ClashStringList first;
+    ClashStringList second;
+} TagCommand;
+
+static void onTag(void* userData, const void* data, struct ClashResponse* response)
+{
+    (void)response;
+    const TagCommand* tag = data;
+    char* out = userData;
+    for (size_t i = 0; i < tag->first.count; ++i) {
+        strncat(out, tag->first.values[i].str, tag->first.values[i].length);
+    }
+    strcat(out, "|");
+    for (size_t i = 0; i < tag->second.count; ++i) {
+        strncat(out, tag->second.values[i].str, tag->second.values[i].length);
+    }
+}
+
+static const ClashOption g_tagOptions[] = {
+    { "first", 'a', "", ClashTypeString | ClashTypeList, "", offsetof(TagCommand, first), 0, 0, 0 },
+    { "second", 'b', "", ClashTypeString | ClashTypeList, "", offsetof(TagCommand, second), 0, 0,
+        0 },
+};
+
+static const ClashCommand g_commands[] = {
+    { "go", "goes", sizeof(GoCommand), g_goOptions, sizeof(g_goOptions) / sizeof(g_goOptions[0]),
+        0, 0, onGo, 0 },
+    { "tag", "tags", sizeof(TagCommand), g_tagOptions,
+        sizeof(g_tagOptions) / sizeof(g_tagOptions[0]), 0, 0, onTag, 0 },
+};
+
+typedef struct StateTestResult {
+    int errorCode;
+    GoCommand command;
+    ClashParseError error;
+} StateTestResult;
+
+static StateTestResult parse(ClashDefinition* definition, const char* line)
+{
+    uint8_t memory[1024];
+    uint8_t responseBuffer[128];
+    ClashScratch scratch;
+    FldOutStream responseStream;
+    StateTestResult result;
+
+    memset(&result, 0, sizeof(result));
+    result.command.count = -1;
+    clashScratchInit(&scratch, memory, sizeof(memory));
+    fldOutStreamInit(&responseStream, responseBuffer, sizeof(responseBuffer));
+    result.errorCode = clashParseStringEx(
+        definition, line, &result.command, &responseStream, &scratch, &result.error);
+
+    return result;
+}
+
+static int nameIs(const StateTestResult* result, const char* name)
+{
+    return result->command.name != 0 && strcmp(result->command.name, name) == 0;
+}
+
+static const char* suggestionFor(ClashDefinition* definition, int flags)
+{
+    uint8_t memory[512];
+    ClashScratch scratch;
+    ClashState state;
+
+    clashScratchInit(&scratch, memory, sizeof(memory));
+    clashStateInit(&state, definition, &scratch, flags);
+    clashStateFeed(&state, "go", 2);
+    int errorCode = clashStateFeed(&state, "--verbse", 8);
+    CLASH_TEST_CHECK(errorCode == -6);
+    CLASH_TEST_CHECK(state.error.kind == ClashParseErrorKindUnknownOption);
+
+    return state.error.suggestion;
+}
+
+/// Lists that are added to in turn must fit the scratch that clashParseString() reserves
+static void checkListScratch(ClashDefinition* definition)
+{
+    static const char* line
+        = "tag -a1 -bA -a2 -bB -a3 -bC -a4 -bD --first=5 -bE -a6 -bF -a7 -bG -a8 -bH -a9 -bI";
+    size_t length = strlen(line);
+    size_t octetCount = clashDefinitionScratchOctetCount(definition) + length + 1
+        + clashDefinitionListOctetCount(definition, length / 2 + 1);
+    CLASH_TEST_CHECK(octetCount <= CLASH_PARSE_SCRATCH_OCTETS);
+
+    uint8_t memory[CLASH_PARSE_SCRATCH_OCTETS];
+    uint8_t responseBuffer[64];
+    char out[32] = "";
+    ClashScratch scratch;
+    FldOutStream responseStream;
+    clashScratchInit(&scratch, memory, octetCount);
+    fldOutStreamInit(&responseStream, responseBuffer, sizeof(responseBuffer));
+    CLASH_TEST_CHECK(
+        clashParseStringEx(definition, line, out, &responseStream, &scratch, 0) == 0);
+    CLASH_TEST_CHECK(strcmp(out, "123456789|ABCDEFGHI") == 0);
+}
+
+void testState(void)
+{
+    ClashDefinition definition = { g_commands, sizeof(g_commands) / sizeof(g_commands[0]), 0, 0 };
+    CLASH_TEST_CHECK(clashDefinitionCompile(&definition) == 0);
+
+    // A long flag must not take the next token as its value
+    StateTestResult result = parse(&definition, "go --verbose file");
+    CLASH_TEST_CHECK(result.errorCode == 0);
+    CLASH_TEST_CHECK(nameIs(&result, "file"));
+    CLASH_TEST_CHECK(result.command.verbose == 1);
+
+    result = parse(&definition, "go file --verbose");
+    CLASH_TEST_CHECK(result.errorCode == 0);
+    CLASH_TEST_CHECK(nameIs(&result, "file"));
+    CLASH_TEST_CHECK(result.command.verbose == 1);
+
+    result = parse(&definition, "go file --count=3 -c 4");
+    CLASH_TEST_CHECK(result.errorCode == 0);
+    CLASH_TEST_CHECK(result.command.count == 4);
+
+    // A value option at the end of the line is an error, the command is not executed
+    result = parse(&definition, "go file -c");
+    CLASH_TEST_CHECK(result.errorCode == -6);
+    CLASH_TEST_CHECK(result.error.kind == ClashParseErrorKindExpectedOptionValue);
+    CLASH_TEST_CHECK(result.command.count == -1);
+
+    result = parse(&definition, "go file --count");
+    CLASH_TEST_CHECK(result.errorCode == -6);
+    CLASH_TEST_CHECK(result.error.kind == ClashParseErrorKindExpectedOptionValue);
+    CLASH_TEST_CHECK(result.error.expected != 0 && strcmp(result.error.expected, "count") == 0);
+    CLASH_TEST_CHECK(result.command.count == -1);
+
+    // Completion feeds partial lines, so it does not search for suggestions
+    const char* suggestion = suggestionFor(&definition, 0);
+    CLASH_TEST_CHECK(suggestion != 0 && strcmp(suggestion, "verbose") == 0);
+    CLASH_TEST_CHECK(suggestionFor(&definition, ClashStateFlagCompleting) == 0);
+
+    checkListScratch(&definition);
+
+    clashDefinitionDestroy(&definition);
+}
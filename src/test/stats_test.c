@@ -0,0 +1,144 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include "test.h"
+
+#if defined CLASH_STATS
+
+#include <clash/binary.h>
+#include <clash/clash.h>
+#include <clash/compiled.h>
+#include <clash/complete.h>
+#include <clash/index.h>
+#include <clash/scratch.h>
+#include <clash/stats.h>
+#include <flood/out_stream.h>
+#include <string.h>
+#include <tiny-libc/tiny_libc.h>
+
+// Commands that are parsed earlier are counted and their callbacks sampled like parsed commands,
+// and completing a partial line does not count as an error.
+
+#define STATS_TEST_CALL_COUNT (4 * CLASH_STATS_SAMPLE_INTERVAL)
+
+typedef struct RunCommand {
+    int count;
+} RunCommand;
+
+static void onRun(void* userData, const void* data, struct ClashResponse* response)
+{
+    (void)userData;
+    (void)data;
+    (void)response;
+}
+
+static const ClashOption g_runOptions[] = {
+    { "count", 'c', "how many", ClashTypeInt, "0", offsetof(RunCommand, count), 0, 0, 0 },
+};
+
+static const ClashCommand g_commands[] = {
+    { "run", "runs", sizeof(RunCommand), g_runOptions, 1, 0, 0, onRun, 0 },
+};
+
+static uint64_t total(const uint64_t* counters, size_t count)
+{
+    uint64_t sum = 0;
+    for (size_t i = 0; i < count; ++i) {
+        sum += counters[i];
+    }
+
+    return sum;
+}
+
+static const ClashCommandStats* runStats(const ClashDefinition* definition)
+{
+    return &definition->index->stats->commands[1];
+}
+
+static void checkCompiled(ClashDefinition* definition, FldOutStream* responseStream)
+{
+    ClashCompiledCommand* compiled = clashCompileCommand(definition, "run -c 2", 0);
+    CLASH_TEST_CHECK(compiled != 0);
+    if (compiled == 0) {
+        return;
+    }
+    for (int i = 0; i < STATS_TEST_CALL_COUNT; ++i) {
+        fldOutStreamInit(responseStream, responseStream->octets, responseStream->size);
+        clashExecuteCompiled(compiled, 0, responseStream);
+    }
+    clashCompiledCommandDestroy(compiled);
+
+    const ClashCommandStats* stats = runStats(definition);
+    CLASH_TEST_CHECK(stats->invocationCount == STATS_TEST_CALL_COUNT);
+    uint64_t sampledCount = STATS_TEST_CALL_COUNT / CLASH_STATS_SAMPLE_INTERVAL;
+    CLASH_TEST_CHECK(total(stats->callbackTicks, CLASH_STATS_BUCKET_COUNT) == sampledCount);
+    CLASH_TEST_CHECK(total(stats->parseTicks, CLASH_STATS_BUCKET_COUNT) == 0);
+
+    // The callback histogram is dumped without a parse histogram
+    uint8_t dumpBuffer[512];
+    FldOutStream dumpStream;
+    fldOutStreamInit(&dumpStream, dumpBuffer, sizeof(dumpBuffer) - 1);
+    CLASH_TEST_CHECK(clashStatsDump(definition, &dumpStream) >= 0);
+    dumpBuffer[dumpStream.pos] = 0;
+    CLASH_TEST_CHECK(strstr((const char*)dumpBuffer, "\n  callback p50<") != 0);
+    CLASH_TEST_CHECK(strstr((const char*)dumpBuffer, "parse") == 0);
+}
+
+static void checkBinary(ClashDefinition* definition, FldOutStream* responseStream)
+{
+    uint8_t memory[512];
+    uint8_t encoded[64];
+    ClashScratch scratch;
+    FldOutStream encodedStream;
+    clashScratchInit(&scratch, memory, sizeof(memory));
+    fldOutStreamInit(&encodedStream, encoded, sizeof(encoded));
+    int octetCount = clashBinaryEncodeString(definition, "run -c 3", &encodedStream, &scratch, 0);
+    CLASH_TEST_CHECK(octetCount > 0);
+
+    fldOutStreamInit(responseStream, responseStream->octets, responseStream->size);
+    clashBinaryExecute(definition, encoded, (size_t)octetCount, 0, responseStream, &scratch, 0);
+    CLASH_TEST_CHECK(runStats(definition)->invocationCount == 1);
+}
+
+static void checkComplete(ClashDefinition* definition)
+{
+    static const char* const lines[] = { "run --bogus ", "ru x", "run -c" };
+    ClashCompletion candidates[8];
+    size_t wordStart;
+    for (size_t i = 0; i < sizeof(lines) / sizeof(lines[0]); ++i) {
+        clashComplete(definition, lines[i], tc_strlen(lines[i]), candidates, 8, &wordStart);
+    }
+
+    for (size_t i = 0; i < definition->index->stats->commandCount; ++i) {
+        const ClashCommandStats* stats = &definition->index->stats->commands[i];
+        CLASH_TEST_CHECK(total(stats->errorCounts, CLASH_STATS_ERROR_CODE_COUNT) == 0);
+    }
+}
+
+void testStats(void)
+{
+    ClashDefinition definition = { g_commands, 1, 0, 0 };
+    CLASH_TEST_CHECK(clashDefinitionCompile(&definition) == 0);
+    CLASH_TEST_CHECK(definition.index->stats != 0);
+
+    uint8_t responseBuffer[64];
+    FldOutStream responseStream;
+    fldOutStreamInit(&responseStream, responseBuffer, sizeof(responseBuffer));
+
+    checkCompiled(&definition, &responseStream);
+    clashStatsClear(&definition);
+    checkBinary(&definition, &responseStream);
+    clashStatsClear(&definition);
+    checkComplete(&definition);
+
+    clashDefinitionDestroy(&definition);
+}
+
+#else
+
+void testStats(void)
+{
+}
+
+#endif
@@ -0,0 +1,25 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CLASH_TEST_H
+#define CLASH_TEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Reports a failed check with its location, the test keeps running so all failures are listed.
+#define CLASH_TEST_CHECK(condition) testCheck((condition) != 0, #condition, __FILE__, __LINE__)
+
+int testCheck(int isTrue, const char* text, const char* file, int line);
+uint32_t testRandom(void);
+
+void testScan(void);
+void testBinary(void);
+void testConvert(void);
+void testHistory(void);
+void testState(void);
+void testThreads(void);
+void testStats(void);
+
+#endif
@@ -0,0 +1,222 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include "test.h"
+#include <clash/binary.h>
+#include <clash/clash.h>
+#include <clash/compiled.h>
+#include <clash/parser.h>
+#include <clash/response.h>
+#include <flood/out_stream.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined CLASH_TEST_THREADS
+#include <pthread.h>
+#endif
+
+// One compiled definition is shared by every thread, each thread has its own ClashParser and
+// response stream. Every response must be the same as when the lines run on a single thread.
+
+#define THREAD_TEST_THREAD_COUNT (8)
+#define THREAD_TEST_ROUND_COUNT (2000)
+#define THREAD_TEST_RESPONSE_OCTETS (128)
+#define THREAD_TEST_RESULT_OCTETS (THREAD_TEST_RESPONSE_OCTETS + 32)
+
+typedef struct TrackCommand {
+    const char* name;
+    int verbose;
+    int count;
+    double ratio;
+    ClashStringList tags;
+} TrackCommand;
+
+static void onTrack(void* userData, const void* data, struct ClashResponse* response)
+{
+    (void)userData;
+    const TrackCommand* track = data;
+    clashResponseWritef(response, "%s/%d/%d/%g/", track->name, track->verbose, track->count,
+        track->ratio);
+    for (size_t i = 0; i < track->tags.count; ++i) {
+        clashResponseWritef(
+            response, "%.*s,", (int)track->tags.values[i].length, track->tags.values[i].str);
+    }
+}
+
+static const ClashOption g_trackOptions[] = {
+    { "name", 'n', "", ClashTypeString | ClashTypeArg, "def", offsetof(TrackCommand, name), 0, 0,
+        0 },
+    { "verbose", 'v', "", ClashTypeFlag, "", offsetof(TrackCommand, verbose), 0, 0, 0 },
+    { "count", 'c', "", ClashTypeInt, "0", offsetof(TrackCommand, count), 0, 1000, 0 },
+    { "ratio", 'r', "", ClashTypeDouble, "1.5", offsetof(TrackCommand, ratio), 0, 0, 0 },
+    { "tag", 't', "", ClashTypeString | ClashTypeList, "", offsetof(TrackCommand, tags), 0, 0,
+        0 },
+};
+
+#define THREAD_TEST_OPTION_COUNT (sizeof(g_trackOptions) / sizeof(g_trackOptions[0]))
+
+static const ClashCommand g_subCommands[] = {
+    { "start", "", sizeof(TrackCommand), g_trackOptions, THREAD_TEST_OPTION_COUNT, 0, 0, onTrack,
+        0 },
+    { "stop", "", sizeof(TrackCommand), g_trackOptions, THREAD_TEST_OPTION_COUNT, 0, 0, onTrack,
+        0 },
+};
+
+static const ClashCommand g_commands[] = {
+    { "record", "", 0, 0, 0, g_subCommands, 2, 0, 0 },
+    { "play", "", sizeof(TrackCommand), g_trackOptions, THREAD_TEST_OPTION_COUNT, 0, 0, onTrack,
+        0 },
+};
+
+static const char* const g_lines[] = {
+    "record start foo -v",
+    "record stop -vv --count 5 --tag a --tag=b",
+    "play bar -c",
+    "nope",
+    "record start \"a b\" -vvv --count=99 --ratio 0.25",
+    "play --count 12 hello -t x -t y -t z",
+    "play --count 2000",
+    "record sotp",
+};
+
+#define THREAD_TEST_LINE_COUNT (sizeof(g_lines) / sizeof(g_lines[0]))
+
+typedef struct ThreadTest {
+    ClashDefinition definition;
+    ClashCompiledCommand* compiled;
+    uint8_t encoded[128];
+    size_t encodedOctetCount;
+    char expected[THREAD_TEST_LINE_COUNT + 2][THREAD_TEST_RESULT_OCTETS];
+} ThreadTest;
+
+typedef struct ThreadWorker {
+    const ThreadTest* test;
+    size_t mismatchCount;
+} ThreadWorker;
+
+/// The error code and the response, or where the parse failed
+static void parseLine(ClashParser* parser, const char* line, char* out)
+{
+    uint8_t responseBuffer[THREAD_TEST_RESPONSE_OCTETS];
+    FldOutStream responseStream;
+    fldOutStreamInit(&responseStream, responseBuffer, sizeof(responseBuffer));
+    int result = clashParserParseString(parser, line, 0, &responseStream);
+    snprintf(out, THREAD_TEST_RESULT_OCTETS, "%d:%s:%zu", result,
+        result == 0 ? (const char*)responseBuffer : "", parser->error.tokenIndex);
+}
+
+static void executeCompiled(const ThreadTest* test, char* out)
+{
+    uint8_t responseBuffer[THREAD_TEST_RESPONSE_OCTETS];
+    FldOutStream responseStream;
+    fldOutStreamInit(&responseStream, responseBuffer, sizeof(responseBuffer));
+    int result = clashExecuteCompiled(test->compiled, 0, &responseStream);
+    snprintf(out, THREAD_TEST_RESULT_OCTETS, "%d:%s", result, (const char*)responseBuffer);
+}
+
+static void executeBinary(const ThreadTest* test, ClashScratch* scratch, char* out)
+{
+    uint8_t responseBuffer[THREAD_TEST_RESPONSE_OCTETS];
+    FldOutStream responseStream;
+    fldOutStreamInit(&responseStream, responseBuffer, sizeof(responseBuffer));
+    int result = clashBinaryExecute(&test->definition, test->encoded, test->encodedOctetCount, 0,
+        &responseStream, scratch, 0);
+    snprintf(out, THREAD_TEST_RESULT_OCTETS, "%d:%s", result, (const char*)responseBuffer);
+}
+
+/// Runs every line in order, so the results can be compared with test->expected
+static void runAll(
+    const ThreadTest* test, ClashParser* parser, char (*out)[THREAD_TEST_RESULT_OCTETS])
+{
+    for (size_t i = 0; i < THREAD_TEST_LINE_COUNT; ++i) {
+        parseLine(parser, g_lines[i], out[i]);
+    }
+    executeCompiled(test, out[THREAD_TEST_LINE_COUNT]);
+    executeBinary(test, &parser->scratch, out[THREAD_TEST_LINE_COUNT + 1]);
+}
+
+static void* runWorker(void* arg)
+{
+    ThreadWorker* worker = arg;
+    const ThreadTest* test = worker->test;
+    uint8_t memory[1024];
+    char results[THREAD_TEST_LINE_COUNT + 2][THREAD_TEST_RESULT_OCTETS];
+    ClashParser parser;
+    clashParserInit(&parser, &test->definition, memory, sizeof(memory));
+
+    for (int round = 0; round < THREAD_TEST_ROUND_COUNT; ++round) {
+        runAll(test, &parser, results);
+        for (size_t i = 0; i < THREAD_TEST_LINE_COUNT + 2; ++i) {
+            worker->mismatchCount += strcmp(results[i], test->expected[i]) != 0;
+        }
+    }
+
+    return 0;
+}
+
+static void runWorkers(ThreadWorker* workers, size_t count)
+{
+#if defined CLASH_TEST_THREADS
+    pthread_t threads[THREAD_TEST_THREAD_COUNT];
+    int isStarted[THREAD_TEST_THREAD_COUNT];
+    for (size_t i = 0; i < count; ++i) {
+        isStarted[i] = pthread_create(&threads[i], 0, runWorker, &workers[i]) == 0;
+        CLASH_TEST_CHECK(isStarted[i]);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (isStarted[i]) {
+            pthread_join(threads[i], 0);
+        }
+    }
+#else
+    // Without threads the workers still check that nothing is left behind between parses
+    for (size_t i = 0; i < count; ++i) {
+        runWorker(&workers[i]);
+    }
+#endif
+}
+
+void testThreads(void)
+{
+    static ThreadTest test;
+    test.definition.commands = g_commands;
+    test.definition.commandCount = sizeof(g_commands) / sizeof(g_commands[0]);
+    CLASH_TEST_CHECK(clashDefinitionCompile(&test.definition) == 0);
+
+    test.compiled = clashCompileCommand(&test.definition, "record stop x -v --tag=compiled", 0);
+    CLASH_TEST_CHECK(test.compiled != 0);
+
+    uint8_t memory[1024];
+    ClashParser parser;
+    FldOutStream encodedStream;
+    clashParserInit(&parser, &test.definition, memory, sizeof(memory));
+    fldOutStreamInit(&encodedStream, test.encoded, sizeof(test.encoded));
+    int octetCount = clashBinaryEncodeString(
+        &test.definition, "play encoded -c 3 -t e", &encodedStream, &parser.scratch, 0);
+    CLASH_TEST_CHECK(octetCount > 0);
+    test.encodedOctetCount = octetCount < 0 ? 0 : (size_t)octetCount;
+
+    if (test.compiled != 0 && octetCount > 0) {
+        runAll(&test, &parser, test.expected);
+        CLASH_TEST_CHECK(strcmp(test.expected[1], "0:def/2/5/1.5/a,b,:0") == 0);
+        CLASH_TEST_CHECK(strcmp(test.expected[6], "-10::2") == 0);
+        CLASH_TEST_CHECK(
+            strcmp(test.expected[THREAD_TEST_LINE_COUNT], "0:x/1/0/1.5/compiled,") == 0);
+        CLASH_TEST_CHECK(
+            strcmp(test.expected[THREAD_TEST_LINE_COUNT + 1], "0:encoded/0/3/1.5/e,") == 0);
+
+        ThreadWorker workers[THREAD_TEST_THREAD_COUNT];
+        for (size_t i = 0; i < THREAD_TEST_THREAD_COUNT; ++i) {
+            workers[i].test = &test;
+            workers[i].mismatchCount = 0;
+        }
+        runWorkers(workers, THREAD_TEST_THREAD_COUNT);
+        for (size_t i = 0; i < THREAD_TEST_THREAD_COUNT; ++i) {
+            CLASH_TEST_CHECK(workers[i].mismatchCount == 0);
+        }
+    }
+
+    clashCompiledCommandDestroy(test.compiled);
+    clashDefinitionDestroy(&test.definition);
+}
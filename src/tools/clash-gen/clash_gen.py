@@ -0,0 +1,1035 @@
+#!/usr/bin/env python3
+# Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+# Licensed under the MIT License. See LICENSE in the project root for license information.
+"""Generates clash command tables, typed structs and specialized parse functions from a schema.
+
+The schema is TOML (or JSON, with the same structure):
+
+    prefix = "example"
+
+    [[commands]]
+    name = "record"
+    description = "recording commands"
+
+      [[commands.commands]]
+      name = "start"
+      description = "start recording something"
+      struct = "RecordStartCmd"
+      fn = "onRecordStart"
+
+        [[commands.commands.options]]
+        name = "name"
+        field = "filename"
+        short = "n"
+        type = "string"
+        arg = true
+        default = "somefile.swamp-capture"
+        description = "the file name to store capture to"
+
+Option types are string, view, int, int64, uint64, double, duration, bool and flag. Number
+options can have `minimum` and `maximum` bounds, and string and view options a list of
+`choices`. Defaults are converted and checked when generating. A leaf command with `async = true`
+is queued for a worker thread by clashAsyncParseString(), the generated parser always executes
+it directly. A command either has sub commands or is a leaf with a struct, a fn and options.
+
+Values are converted as soon as they are parsed, but like clashParse() an invalid value is only
+reported after all tokens are parsed, and only if no later value replaces it.
+"""
+
+import argparse
+import json
+import os
+import re
+import sys
+
+TYPES = {
+    "string": ("const char*", "ClashTypeString"),
+    "view": ("ClashStringView", "ClashTypeString | ClashTypeView"),
+    "int": ("int", "ClashTypeInt"),
+    "uint64": ("uint64_t", "ClashTypeUInt64"),
+    "int64": ("int64_t", "ClashTypeInt64"),
+    "double": ("double", "ClashTypeDouble"),
+    "duration": ("int64_t", "ClashTypeDuration"),
+    "bool": ("bool", "ClashTypeBool"),
+    "flag": ("int", "ClashTypeFlag"),
+}
+
+NUMBER_TYPES = ("int", "int64", "uint64", "double", "duration")
+
+# Types where a token like `-12` is a value and not a short option, see clashConvertIsNegativeNumber()
+NEGATIVE_TYPES = ("int", "int64", "double", "duration")
+
+CONVERT_FUNCTIONS = {
+    "int": ("clashConvertInt", "clashConvertCheckRange"),
+    "int64": ("clashConvertInt64", "clashConvertCheckRange"),
+    "uint64": ("clashConvertUInt64", "clashConvertCheckRangeUInt64"),
+    "double": ("clashConvertDouble", "clashConvertCheckRangeDouble"),
+    "duration": ("clashConvertDuration", "clashConvertCheckRange"),
+}
+
+INT_MIN, INT_MAX = -(1 << 31), (1 << 31) - 1
+INT64_MIN, INT64_MAX = -(1 << 63), (1 << 63) - 1
+UINT64_MAX = (1 << 64) - 1
+
+
+class SchemaError(Exception):
+    pass
+
+
+def load_schema(path):
+    if path.endswith(".json"):
+        with open(path, "r", encoding="utf-8") as f:
+            return json.load(f)
+    try:
+        import tomllib
+    except ImportError as e:
+        raise SchemaError("TOML schemas need Python 3.11 or later, use a .json schema") from e
+    with open(path, "rb") as f:
+        return tomllib.load(f)
+
+
+def c_string(s):
+    if s is None:
+        return "0"
+    escaped = s.replace("\\", "\\\\").replace('"', '\\"').replace("\n", "\\n")
+    return '"' + escaped + '"'
+
+
+def c_char(c):
+    if c in ("'", "\\"):
+        return "'\\" + c + "'"
+    return "'" + c + "'"
+
+
+def camel(words):
+    return "".join(w[:1].upper() + w[1:] for w in words)
+
+
+def words_of(name):
+    return [w for w in re.split(r"[^A-Za-z0-9]+", name) if w]
+
+
+class ConvertError(Exception):
+    pass
+
+
+def parse_digits(s, base):
+    """Same rules as parseDigits() in convert.c, `_` is allowed between two digits"""
+    if not s:
+        raise ConvertError("invalid value")
+    value = 0
+    previous_was_digit = False
+    for i, c in enumerate(s):
+        digit = int(c, 16) if c in "0123456789abcdefABCDEF" else 99
+        if digit >= base:
+            if c != "_" or not previous_was_digit or i + 1 == len(s):
+                raise ConvertError("invalid value")
+            previous_was_digit = False
+            continue
+        value = value * base + digit
+        previous_was_digit = True
+    if value > UINT64_MAX:
+        raise ConvertError("value overflows")
+    return value
+
+
+def parse_magnitude(s):
+    if len(s) >= 2 and s[0] == "0" and s[1] in "xX":
+        return parse_digits(s[2:], 16)
+    if len(s) >= 2 and s[0] == "0" and s[1] in "bB":
+        return parse_digits(s[2:], 2)
+    return parse_digits(s, 10)
+
+
+def split_sign(s):
+    if s[:1] in ("-", "+"):
+        return s[0] == "-", s[1:]
+    return False, s
+
+
+def to_uint64(s):
+    return parse_magnitude(s[1:] if s[:1] == "+" else s)
+
+
+def to_int64(s, minimum=INT64_MIN, maximum=INT64_MAX):
+    is_negative, rest = split_sign(s)
+    value = parse_magnitude(rest)
+    value = -value if is_negative else value
+    if value < minimum or value > maximum:
+        raise ConvertError("value overflows")
+    return value
+
+
+def to_double(s):
+    """Accepts the same strings as clashConvertDouble()"""
+    i = 1 if s[:1] in ("-", "+") else 0
+    digit_count = 0
+    is_fraction = False
+    previous_was_digit = False
+    while i < len(s):
+        c = s[i]
+        if c.isdigit():
+            digit_count += 1
+            previous_was_digit = True
+        elif c == "_" and previous_was_digit and i + 1 != len(s):
+            previous_was_digit = False
+        elif c == "." and not is_fraction:
+            is_fraction = True
+            previous_was_digit = False
+        else:
+            break
+        i += 1
+    if digit_count == 0:
+        raise ConvertError("invalid value")
+    if i != len(s):
+        if s[i] not in "eE":
+            raise ConvertError("invalid value")
+        try:
+            exponent = to_int64(s[i + 1:])
+        except ConvertError as e:
+            raise ConvertError("invalid value") from e
+        if abs(exponent) > 100000:
+            raise ConvertError("invalid value")
+    try:
+        value = float(s.replace("_", ""))
+    except ValueError as e:
+        raise ConvertError("invalid value") from e
+    if value in (float("inf"), float("-inf")):
+        raise ConvertError("value overflows")
+    return value
+
+
+DURATION_UNITS = (("ms", 1), ("s", 1000), ("m", 60 * 1000), ("h", 60 * 60 * 1000),
+    ("d", 24 * 60 * 60 * 1000))
+
+
+def to_duration(s):
+    """Milliseconds, with the same rules as clashConvertDuration()"""
+    is_negative, rest = split_sign(s)
+    if re.fullmatch(r"[0-9_]*", rest):
+        total = parse_digits(rest, 10)
+    else:
+        total = 0
+        while rest:
+            digits = re.match(r"[0-9_]*", rest).group(0)
+            count = parse_digits(digits, 10)
+            rest = rest[len(digits):]
+            for unit, milliseconds in DURATION_UNITS:
+                if rest.startswith(unit):
+                    rest = rest[len(unit):]
+                    total += count * milliseconds
+                    break
+            else:
+                raise ConvertError("invalid value")
+            if total > UINT64_MAX:
+                raise ConvertError("value overflows")
+    if total > INT64_MAX:
+        raise ConvertError("value overflows")
+    return -total if is_negative else total
+
+
+def to_bool(s):
+    if s in ("true", "yes", "on", "1"):
+        return True
+    if s in ("false", "no", "off", "0"):
+        return False
+    raise ConvertError("invalid value")
+
+
+def c_int64(value):
+    if value == INT64_MIN:
+        return "INT64_MIN"
+    if value == INT64_MAX:
+        return "INT64_MAX"
+    return "INT64_C(%d)" % value
+
+
+class Option:
+    def __init__(self, command, index, spec):
+        self.name = spec["name"]
+        self.field = spec.get("field", self.name)
+        self.short = spec.get("short")
+        self.type = spec.get("type", "string")
+        self.is_arg = bool(spec.get("arg", False))
+        self.default = spec.get("default")
+        self.description = spec.get("description", "")
+        self.index = index
+        self.minimum = spec.get("minimum")
+        self.maximum = spec.get("maximum")
+        self.choices = spec.get("choices")
+        self.choices_name = "%s%sChoices" % (lower_first(command.ident), camel([self.field]))
+        if self.type not in TYPES:
+            raise SchemaError("%s: unknown type '%s' for option '%s'" % (command.path, self.type, self.name))
+        if self.short is not None and len(self.short) != 1:
+            raise SchemaError("%s: short name for '%s' must be one character" % (command.path, self.name))
+        if not re.match(r"^[A-Za-z_][A-Za-z0-9_]*$", self.field):
+            raise SchemaError("%s: '%s' is not a valid field name" % (command.path, self.field))
+        if self.has_bounds:
+            if self.type not in NUMBER_TYPES:
+                raise SchemaError("%s: only number options can have bounds, not '%s'" % (command.path,
+                    self.name))
+            # Both bounds are needed in the table, zero for both means no bounds
+            self.minimum = INT64_MIN if self.minimum is None else int(self.minimum)
+            self.maximum = INT64_MAX if self.maximum is None else int(self.maximum)
+            if not INT64_MIN <= self.minimum <= self.maximum <= INT64_MAX:
+                raise SchemaError("%s: invalid bounds for '%s'" % (command.path, self.name))
+        if self.choices is not None:
+            if self.type not in ("string", "view"):
+                raise SchemaError("%s: only string options can have choices, not '%s'" % (command.path,
+                    self.name))
+            if not self.choices or not all(isinstance(choice, str) for choice in self.choices):
+                raise SchemaError("%s: choices for '%s' must be a list of strings" % (command.path,
+                    self.name))
+            if self.default is not None and self.default not in self.choices:
+                raise SchemaError("%s: default for '%s' is not one of the choices" % (command.path,
+                    self.name))
+        try:
+            self.default_value = self.convert_default()
+        except ConvertError as e:
+            raise SchemaError("%s: default for '%s': %s" % (command.path, self.name, e)) from e
+
+    @property
+    def has_bounds(self):
+        return self.minimum is not None or self.maximum is not None
+
+    @property
+    def has_range_check(self):
+        return self.has_bounds and not (self.minimum == 0 and self.maximum == 0)
+
+    @property
+    def accepts_negative(self):
+        return self.type in NEGATIVE_TYPES
+
+    @property
+    def takes_value(self):
+        return self.type not in ("flag", "bool")
+
+    def convert_default(self):
+        """The default converted like the commands that are not generated convert it"""
+        if self.type in ("string", "view", "flag") or self.default is None:
+            return self.default
+        if self.type == "bool":
+            return False if self.default == "" else to_bool(self.default)
+        # An empty default is zero
+        if self.default == "":
+            return 0
+        if self.type == "int":
+            value = to_int64(self.default, INT_MIN, INT_MAX)
+        elif self.type == "int64":
+            value = to_int64(self.default)
+        elif self.type == "uint64":
+            value = to_uint64(self.default)
+        elif self.type == "double":
+            value = to_double(self.default)
+        else:
+            value = to_duration(self.default)
+        if self.has_range_check and not self.minimum <= value <= self.maximum:
+            raise ConvertError("value out of range")
+        return value
+
+    @property
+    def c_type(self):
+        return TYPES[self.type][0]
+
+    @property
+    def type_flags(self):
+        flags = TYPES[self.type][1]
+        return flags + " | ClashTypeArg" if self.is_arg else flags
+
+    def default_statements(self, target):
+        """Statements that store the default value, converted when generating"""
+        field = "%s.%s" % (target, self.field)
+        if self.type == "view":
+            length = 0 if self.default is None else len(self.default.encode("utf-8"))
+            return ["%s.str = %s;" % (field, c_string(self.default)), "%s.length = %d;" % (field, length)]
+        return ["%s = %s;" % (field, self.default_expression())]
+
+    def default_expression(self):
+        value = self.default_value
+        if self.type == "string":
+            return c_string(value)
+        if value is None:
+            return "false" if self.type == "bool" else "0"
+        if self.type == "bool":
+            return "true" if value else "false"
+        if self.type == "int":
+            return "(-2147483647 - 1)" if value == INT_MIN else str(value)
+        if self.type in ("int64", "duration"):
+            return c_int64(value)
+        if self.type == "uint64":
+            return "UINT64_C(%d)" % value
+        if self.type == "double":
+            return repr(float(value))
+        return "0"
+
+    @property
+    def bounds_expression(self):
+        if not self.has_bounds:
+            return "0, 0"
+        return "%s, %s" % (c_int64(self.minimum), c_int64(self.maximum))
+
+    def store(self, target, value):
+        """Statements that store the view named value into the field"""
+        field = "%s->%s" % (target, self.field)
+        check = []
+        if self.choices is not None:
+            check = [
+                "if (clashConvertCheckChoice(%s, %s->str, %s->length) < 0) {" % (self.choices_name,
+                    value, value),
+                "    return CLASH_CONVERT_INVALID;",
+                "}",
+            ]
+        if self.type == "string":
+            return check + [
+                "%s = clashScratchCopyString(scratch, %s->str, %s->length);" % (field, value, value),
+                "return %s == 0 ? -7 : 0;" % field,
+            ]
+        if self.type == "view":
+            return check + ["%s = *%s;" % (field, value), "return 0;"]
+        if self.type == "bool":
+            # A short option has no value
+            return [
+                "if (%s->length == 0) {" % value,
+                "    %s = true;" % field,
+                "    return 0;",
+                "}",
+                "return clashConvertBool(%s->str, %s->length, &%s);" % (value, value, field),
+            ]
+        if self.type in CONVERT_FUNCTIONS:
+            convert, check = CONVERT_FUNCTIONS[self.type]
+            call = "%s(%s->str, %s->length, &%s)" % (convert, value, value, field)
+            if not self.has_range_check:
+                return ["return %s;" % call]
+            return [
+                "errorCode = %s;" % call,
+                "if (errorCode < 0) {",
+                "    return errorCode;",
+                "}",
+                "return %s(%s, %s);" % (check, field, self.bounds_expression),
+            ]
+        return ["%s++;" % field, "return 0;"]
+
+
+class Command:
+    def __init__(self, parent_words, spec):
+        self.name = spec["name"]
+        self.description = spec.get("description", "")
+        self.words = parent_words + words_of(self.name)
+        self.path = " ".join(self.words)
+        self.ident = camel(self.words)
+        self.children = [Command(self.words, child) for child in spec.get("commands", [])]
+        option_specs = spec.get("options", [])
+        self.options = []
+        for i, option_spec in enumerate(option_specs):
+            self.options.append(Option(self, i, option_spec))
+        self.struct = spec.get("struct")
+        self.fn = spec.get("fn")
+        self.is_async = bool(spec.get("async", False))
+        if self.children and (self.options or self.fn or self.is_async):
+            raise SchemaError("%s: a command with sub commands can not have options, a fn or async"
+                % self.path)
+        if not self.children and self.options and not self.struct:
+            raise SchemaError("%s: a command with options needs a struct" % self.path)
+        if len(self.options) >= 0xFFFF:
+            raise SchemaError("%s: too many options" % self.path)
+
+    @property
+    def leading_arg_count(self):
+        count = 0
+        for option in self.options:
+            if not option.is_arg:
+                break
+            count += 1
+        return count
+
+    def short_options(self):
+        seen = {}
+        for option in self.options:
+            if option.short is None or option.short == " " or option.short in seen:
+                continue
+            seen[option.short] = option
+        return list(seen.values())
+
+
+class Writer:
+    def __init__(self):
+        self.lines = []
+        self.depth = 0
+
+    def line(self, text=""):
+        self.lines.append(("    " * self.depth + text) if text else "")
+
+    def open(self, text):
+        self.line(text)
+        self.depth += 1
+
+    def close(self, text="}"):
+        self.depth -= 1
+        self.line(text)
+
+    def open_switch(self, text):
+        """The case labels are on the same level as the switch"""
+        self.line(text)
+
+    def close_switch(self):
+        self.line("}")
+
+    def text(self):
+        return "\n".join(self.lines) + "\n"
+
+
+BANNER = """/*----------------------------------------------------------------------------------------------------------
+ *  Generated by clash-gen from %s. Do not edit.
+ *--------------------------------------------------------------------------------------------------------*/"""
+
+
+def all_commands(commands):
+    for command in commands:
+        yield command
+        yield from all_commands(command.children)
+
+
+def write_find(w, function_name, names):
+    """Emits a lookup that switches on the length and then on the first character"""
+    w.line("static int %s(const char* s, size_t length)" % function_name)
+    w.open("{")
+    by_length = {}
+    for index, name in enumerate(names):
+        by_length.setdefault(len(name.encode("utf-8")), []).append((index, name))
+    if not by_length:
+        w.line("(void)s;")
+        w.line("(void)length;")
+        w.line()
+        w.line("return -1;")
+        w.close()
+        return
+    w.open_switch("switch (length) {")
+    for length in sorted(by_length):
+        w.line("case %d:" % length)
+        w.depth += 1
+        by_first = {}
+        for index, name in by_length[length]:
+            by_first.setdefault(name[0], []).append((index, name))
+        w.open_switch("switch (s[0]) {")
+        for first in sorted(by_first):
+            w.line("case %s:" % c_char(first))
+            w.depth += 1
+            for index, name in by_first[first]:
+                if length == 1:
+                    w.line("return %d;" % index)
+                    break
+                w.open('if (memcmp(s + 1, %s, %d) == 0) {' % (c_string(name[1:]), length - 1))
+                w.line("return %d;" % index)
+                w.close()
+            else:
+                w.line("break;")
+            w.depth -= 1
+        w.line("default:")
+        w.line("    break;")
+        w.close_switch()
+        w.line("break;")
+        w.depth -= 1
+    w.line("default:")
+    w.line("    break;")
+    w.close_switch()
+    w.line()
+    w.line("return -1;")
+    w.close()
+
+
+def write_tables(w, prefix, commands):
+    for command in all_commands(commands):
+        if not command.options:
+            continue
+        for option in command.options:
+            if option.choices is not None:
+                w.line("static const char* const %s[] = { %s, 0 };" % (option.choices_name,
+                    ", ".join(c_string(choice) for choice in option.choices)))
+                w.line()
+        w.open("static const ClashOption %sOptions[] = {" % lower_first(command.ident))
+        for option in command.options:
+            short = c_char(option.short) if option.short else "0"
+            w.line("{ %s, %s, %s," % (c_string(option.name), short, c_string(option.description)))
+            w.line("    %s, %s," % (option.type_flags, c_string(option.default)))
+            choices = option.choices_name if option.choices is not None else "0"
+            w.line("    offsetof(%s, %s), %s, %s }," % (command.struct, option.field,
+                option.bounds_expression, choices))
+        w.close("};")
+        w.line()
+
+    def write_command_array(name, array_commands):
+        for command in array_commands:
+            if command.children:
+                write_command_array("%sCommands" % lower_first(command.ident), command.children)
+        w.open("static const ClashCommand %s[] = {" % name)
+        for command in array_commands:
+            struct_size = "sizeof(%s)" % command.struct if command.struct else "0"
+            options = "%sOptions" % lower_first(command.ident) if command.options else "0"
+            sub = "%sCommands" % lower_first(command.ident) if command.children else "0"
+            fn = "(ClashFn)%s" % command.fn if command.fn else "0"
+            flags = "ClashCommandFlagAsync" if command.is_async else "0"
+            w.line("{ %s, %s," % (c_string(command.name), c_string(command.description)))
+            w.line("    %s, %s, %d, %s, %d, %s, %s }," % (struct_size, options, len(command.options),
+                sub, len(command.children), fn, flags))
+        w.close("};")
+        w.line()
+
+    write_command_array("rootCommands", commands)
+    w.line("ClashDefinition %sDefinition = { rootCommands, %d, 0, 0 };" % (prefix, len(commands)))
+    w.line()
+
+
+def lower_first(s):
+    return s[:1].lower() + s[1:]
+
+
+def write_leaf(w, command):
+    ident = command.ident
+    has_options = bool(command.options)
+    data = "&data" if has_options else "0"
+
+    if has_options:
+        write_find(w, "find%sOption" % ident, [option.name for option in command.options])
+        w.line()
+        w.line("static int set%s(%s* data, int optionIndex," % (ident, command.struct))
+        w.line("    const ClashStringView* value, ClashScratch* scratch)")
+        w.open("{")
+        if all(option.type == "flag" for option in command.options):
+            w.line("(void)value;")
+        if not any(option.type == "string" for option in command.options):
+            w.line("(void)scratch;")
+        if any(option.has_range_check for option in command.options):
+            w.line("int errorCode;")
+        if not any(option.type == "string" for option in command.options) or all(
+                option.type == "flag" for option in command.options) or any(
+                option.has_range_check for option in command.options):
+            w.line()
+        w.open_switch("switch (optionIndex) {")
+        for option in command.options:
+            w.line("case %d:" % option.index)
+            w.depth += 1
+            for statement in option.store("data", "value"):
+                w.line(statement)
+            w.depth -= 1
+        w.line("default:")
+        w.line("    return 0;")
+        w.close_switch()
+        w.close()
+        w.line()
+
+    w.line("static int parse%s(const ParseContext* context, size_t tokenIndex)" % ident)
+    w.open("{")
+    if has_options:
+        w.line("%s data;" % command.struct)
+        for option in command.options:
+            for statement in option.default_statements("data"):
+                w.line(statement)
+        w.line()
+        w.line("ValueError valueErrors[%d];" % len(command.options))
+        w.line("memset(valueErrors, 0, sizeof(valueErrors));")
+        w.line("int valueOption = -1;")
+        if command.leading_arg_count > 0:
+            w.line("size_t argIndex = 0;")
+    w.open("for (; tokenIndex < context->tokenCount; ++tokenIndex) {")
+    w.line("const ClashStringView* token = &context->tokens[tokenIndex];")
+    if any(option.accepts_negative for option in command.options):
+        w.line("int isNegativeValue = valueOption >= 0")
+        w.line("    && clashConvertIsNegativeNumber(")
+        w.line("        %sOptions[valueOption].type, token->str, token->length);" % lower_first(ident))
+        w.open("if (!isNegativeValue && token->length != 0 && token->str[0] == '-') {")
+    else:
+        w.open("if (token->length != 0 && token->str[0] == '-') {")
+    if has_options:
+        w.open("if (valueOption >= 0) {")
+        w.line("return contextError(context, ClashParseErrorKindExpectedOptionValue, -6,")
+        w.line("    %sOptions[valueOption].name, tokenIndex, 0);" % lower_first(ident))
+        w.close()
+        w.open("if (token->length >= 3 && token->str[1] == '-') {")
+        w.line("size_t nameLength = token->length - 2;")
+        w.line("const char* equals = memchr(token->str + 2, '=', nameLength);")
+        w.open("if (equals != 0) {")
+        w.line("nameLength = (size_t)(equals - token->str) - 2;")
+        w.close()
+        w.line("valueOption = find%sOption(token->str + 2, nameLength);" % ident)
+        w.open("if (valueOption < 0) {")
+        w.line("return contextError(")
+        w.line("    context, ClashParseErrorKindUnknownOption, -6, \"option\", tokenIndex, 2);")
+        w.close()
+        valueless = [option for option in command.options if not option.takes_value]
+        if valueless:
+            w.open("if (equals == 0 && (%s)) {" % " || ".join(
+                "valueOption == %d" % option.index for option in valueless))
+            w.line("int errorCode = set%s(" % ident)
+            w.line("    &data, valueOption, &emptyValue, context->scratch);")
+            w.line("setValueError(&valueErrors[valueOption], errorCode, tokenIndex, &emptyValue);")
+            w.line("valueOption = -1;")
+            w.line("continue;")
+            w.close()
+        w.open("if (equals != 0) {")
+        w.line("ClashStringView value = { equals + 1, token->length - nameLength - 3 };")
+        write_store_value(w, command, "valueOption")
+        w.line("valueOption = -1;")
+        w.close()
+        w.line("continue;")
+        w.close()
+        short_values = [option for option in command.short_options() if option.takes_value]
+        w.line("int shortOption = -1;")
+        w.open("for (size_t i = 1; i < token->length; ++i) {")
+        w.open_switch("switch (token->str[i]) {")
+        for option in command.short_options():
+            w.line("case %s:" % c_char(option.short))
+            w.line("    %s = %d;" % ("valueOption" if option.takes_value else "shortOption",
+                option.index))
+            w.line("    break;")
+        w.line("default:")
+        w.line("    return contextError(context, ClashParseErrorKindUnknownShortOption, -1,")
+        w.line("        \"short option\", tokenIndex, i);")
+        w.close_switch()
+        if short_values:
+            w.open("if (valueOption >= 0) {")
+            w.open("if (i + 1 < token->length) {")
+            w.line("ClashStringView value = { token->str + i + 1, token->length - i - 1 };")
+            write_store_value(w, command, "valueOption")
+            w.line("valueOption = -1;")
+            w.close()
+            w.line("break;")
+            w.close()
+        w.line("int errorCode = set%s(&data, shortOption, &emptyValue, context->scratch);" % ident)
+        w.line("setValueError(&valueErrors[shortOption], errorCode, tokenIndex, &emptyValue);")
+        w.close()
+    else:
+        w.line("int errorCode = rejectOption(context, tokenIndex);")
+        w.open("if (errorCode < 0) {")
+        w.line("return errorCode;")
+        w.close()
+    w.line("continue;")
+    w.close()
+    if not has_options:
+        w.line()
+        w.line("return tooManyArguments(context, tokenIndex);")
+        w.close()
+    else:
+        write_leaf_value(w, command)
+    w.line()
+    w.line("ClashResponse response;")
+    w.line("clashResponseInit(&response, context->responseStream);")
+    if command.fn:
+        w.line("%s(context->userData, %s, &response);" % (command.fn, data))
+    w.line("clashResponseResetColor(&response);")
+    w.line("fldOutStreamWriteUInt8(context->responseStream, 0);")
+    w.line()
+    w.line("return 0;")
+    w.close()
+    w.line()
+
+
+def write_store_value(w, command, option_index):
+    """Stores the view `value`, that points into the token, as the value of an option"""
+    ident = command.ident
+    w.line("int errorCode = set%s(" % ident)
+    w.line("    &data, %s, &value, context->scratch);" % option_index)
+    w.line("setValueError(&valueErrors[%s], errorCode, tokenIndex, &value);" % option_index)
+
+
+def write_leaf_value(w, command):
+    """Stores a token that is not an option, either as the value of the last long option or as the
+    next argument"""
+    arg_count = command.leading_arg_count
+    w.line()
+    w.line("int optionIndex = valueOption;")
+    w.open("if (optionIndex < 0) {")
+    if arg_count == 0:
+        w.line("return contextError(context, ClashParseErrorKindNotAnArgument, -2, 0, tokenIndex, 0);")
+    else:
+        w.open("if (argIndex >= %d) {" % arg_count)
+        if arg_count < len(command.options):
+            w.line("return argIndex >= %d ? tooManyArguments(context, tokenIndex)" % len(command.options))
+            w.line("    : contextError(context, ClashParseErrorKindNotAnArgument, -2, 0, tokenIndex, 0);")
+        else:
+            w.line("return tooManyArguments(context, tokenIndex);")
+        w.close()
+        w.line("optionIndex = (int)argIndex++;")
+    w.close()
+    w.line("valueOption = -1;")
+    w.line("int errorCode = set%s(&data, optionIndex, token, context->scratch);" % command.ident)
+    w.line("setValueError(&valueErrors[optionIndex], errorCode, tokenIndex, token);")
+    w.close()
+    w.line()
+    w.open("if (valueOption >= 0) {")
+    w.line("return contextError(context, ClashParseErrorKindExpectedOptionValue, -6,")
+    w.line("    %sOptions[valueOption].name, tokenIndex - 1, 0);" % lower_first(command.ident))
+    w.close()
+    w.open("for (size_t i = 0; i < %d; ++i) {" % len(command.options))
+    w.open("if (valueErrors[i].code < 0) {")
+    w.line("return valueError(context, &%sOptions[i], &valueErrors[i]);" % lower_first(command.ident))
+    w.close()
+    w.close()
+
+
+def write_branch(w, function_name, children, find_name, unknown_kind, unknown_code, unknown_expected):
+    w.line("static int %s(const ParseContext* context, size_t tokenIndex)" % function_name)
+    w.open("{")
+    w.open("for (; tokenIndex < context->tokenCount; ++tokenIndex) {")
+    w.line("const ClashStringView* token = &context->tokens[tokenIndex];")
+    w.open("if (token->length == 0 || token->str[0] != '-') {")
+    w.open_switch("switch (%s(token->str, token->length)) {" % find_name)
+    for index, child in enumerate(children):
+        w.line("case %d:" % index)
+        w.line("    return parse%s(context, tokenIndex + 1);" % child.ident)
+    w.line("default:")
+    w.line("    return contextError(context, %s, %d," % (unknown_kind, unknown_code))
+    w.line("        %s, tokenIndex, 0);" % c_string(unknown_expected))
+    w.close_switch()
+    w.close()
+    w.line("int errorCode = rejectOption(context, tokenIndex);")
+    w.open("if (errorCode < 0) {")
+    w.line("return errorCode;")
+    w.close()
+    w.close()
+    w.line()
+    w.line("fldOutStreamWriteUInt8(context->responseStream, 0);")
+    w.line()
+    w.line("return 0;")
+    w.close()
+    w.line()
+
+
+def generate(schema, schema_name, header_name):
+    prefix = schema.get("prefix", "generated")
+    if not re.match(r"^[A-Za-z_][A-Za-z0-9_]*$", prefix):
+        raise SchemaError("'%s' is not a valid prefix" % prefix)
+    max_tokens = int(schema.get("max_tokens", 32))
+    commands = [Command([], spec) for spec in schema.get("commands", [])]
+    if not commands:
+        raise SchemaError("the schema has no commands")
+    guard = "%s_H" % re.sub(r"[^A-Za-z0-9]", "_", os.path.splitext(header_name)[0]).upper()
+    macro_prefix = re.sub(r"([a-z0-9])([A-Z])", r"\1_\2", prefix).upper()
+
+    h = Writer()
+    h.line(BANNER % schema_name)
+    h.line("#ifndef %s" % guard)
+    h.line("#define %s" % guard)
+    h.line()
+    h.line("#include <clash/clash.h>")
+    h.line("#include <stdbool.h>")
+    h.line("#include <stdint.h>")
+    h.line()
+    h.line("struct ClashResponse;")
+    h.line()
+    structs = {}
+    for command in all_commands(commands):
+        if command.options:
+            if command.struct in structs:
+                raise SchemaError("%s: struct '%s' is already used by %s" % (command.path,
+                    command.struct, structs[command.struct]))
+            structs[command.struct] = command.path
+            h.open("typedef struct %s {" % command.struct)
+            for option in command.options:
+                h.line("%s %s;" % (option.c_type, option.field))
+            h.close("} %s;" % command.struct)
+            h.line()
+    for command in all_commands(commands):
+        if command.fn:
+            data_type = "const %s*" % command.struct if command.options else "const void*"
+            h.line("void %s(void* userData, %s data, struct ClashResponse* response);" % (command.fn,
+                data_type))
+    h.line()
+    h.line("extern ClashDefinition %sDefinition;" % prefix)
+    h.line()
+    h.line("int %sParseTokens(const ClashStringView* tokens, size_t tokenCount, void* userData," % prefix)
+    h.line("    struct FldOutStream* responseStream, struct ClashScratch* scratch,")
+    h.line("    struct ClashParseError* error);")
+    h.line("int %sParseString(const char* s, void* userData, struct FldOutStream* responseStream," % prefix)
+    h.line("    struct ClashScratch* scratch, struct ClashParseError* error);")
+    h.line()
+    h.line("#endif")
+
+    w = Writer()
+    w.line(BANNER % schema_name)
+    w.line('#include "%s"' % header_name)
+    w.line("#include <clash/convert.h>")
+    w.line("#include <clash/parse_error.h>")
+    w.line("#include <clash/response.h>")
+    w.line("#include <clash/scratch.h>")
+    w.line("#include <flood/out_stream.h>")
+    w.line("#include <stddef.h>")
+    w.line("#include <string.h>")
+    w.line()
+    w.line("#if !defined %s_MAX_TOKENS" % macro_prefix)
+    w.line("#define %s_MAX_TOKENS (%d)" % (macro_prefix, max_tokens))
+    w.line("#endif")
+    w.line()
+    write_tables(w, prefix, commands)
+    if any(command.short_options() or any(not option.takes_value for option in command.options)
+            for command in all_commands(commands)):
+        w.line("static const ClashStringView emptyValue = { \"\", 0 };")
+        w.line()
+    w.open("typedef struct ParseContext {")
+    w.line("const ClashStringView* tokens;")
+    w.line("size_t tokenCount;")
+    w.line("void* userData;")
+    w.line("FldOutStream* responseStream;")
+    w.line("ClashScratch* scratch;")
+    w.line("ClashParseError* error;")
+    w.close("} ParseContext;")
+    w.line()
+    w.line("static int contextError(const ParseContext* context, ClashParseErrorKind kind, int code,")
+    w.line("    const char* expected, size_t tokenIndex, size_t octetOffset)")
+    w.open("{")
+    w.line("const ClashStringView* token = &context->tokens[tokenIndex];")
+    w.line("return clashParseErrorSet(context->error, kind, code, expected, tokenIndex, token->str,")
+    w.line("    token->length, octetOffset);")
+    w.close()
+    w.line()
+    if any(command.options for command in all_commands(commands)):
+        w.open("typedef struct ValueError {")
+        w.line("int code;")
+        w.line("size_t tokenIndex;")
+        w.line("ClashStringView value;")
+        w.close("} ValueError;")
+        w.line()
+        w.line("static void setValueError(")
+        w.line("    ValueError* self, int code, size_t tokenIndex, const ClashStringView* value)")
+        w.open("{")
+        w.line("self->code = code;")
+        w.line("self->tokenIndex = tokenIndex;")
+        w.line("self->value = *value;")
+        w.close()
+        w.line()
+        w.line("static int valueError(")
+        w.line("    const ParseContext* context, const ClashOption* option, const ValueError* error)")
+        w.open("{")
+        w.line("return clashParseErrorSet(context->error, clashConvertErrorKind(error->code), error->code,")
+        w.line("    clashConvertExpectedValue(option), error->tokenIndex, error->value.str,")
+        w.line("    error->value.length, 0);")
+        w.close()
+        w.line()
+    if any(not command.children and (not command.options or command.leading_arg_count > 0)
+            for command in all_commands(commands)):
+        w.line("static int tooManyArguments(const ParseContext* context, size_t tokenIndex)")
+        w.open("{")
+        w.line("return contextError(context, ClashParseErrorKindTooManyArguments, -1, 0, tokenIndex, 0);")
+        w.close()
+        w.line()
+    w.line("static int rejectOption(const ParseContext* context, size_t tokenIndex)")
+    w.open("{")
+    w.line("const ClashStringView* token = &context->tokens[tokenIndex];")
+    w.open("if (token->length >= 3 && token->str[1] == '-') {")
+    w.line("return contextError(")
+    w.line("    context, ClashParseErrorKindUnknownOption, -6, \"option\", tokenIndex, 2);")
+    w.close()
+    w.open("if (token->length >= 2) {")
+    w.line("return contextError(")
+    w.line("    context, ClashParseErrorKindUnknownShortOption, -1, \"short option\", tokenIndex, 1);")
+    w.close()
+    w.line()
+    w.line("return 0;")
+    w.close()
+    w.line()
+
+    def emit(command_list):
+        for command in command_list:
+            if command.children:
+                emit(command.children)
+        for command in command_list:
+            if command.children:
+                write_find(w, "find%sCommand" % command.ident, [c.name for c in command.children])
+                w.line()
+                write_branch(w, "parse%s" % command.ident, command.children,
+                    "find%sCommand" % command.ident, "ClashParseErrorKindUnknownSubCommand", -5,
+                    "sub command")
+            else:
+                write_leaf(w, command)
+
+    emit(commands)
+    write_find(w, "findRootCommand", [c.name for c in commands])
+    w.line()
+
+    w.line("/// Parses and executes a tokenized command line with code generated for %s." % schema_name)
+    w.line("/// @param tokens the tokens, see clashSplitStringViews()")
+    w.line("/// @param tokenCount number of tokens")
+    w.line("/// @param userData passed to the command functions")
+    w.line("/// @param responseStream the response output")
+    w.line("/// @param scratch temporary memory for string copies, rewound before returning")
+    w.line("/// @param error optional, receives the details if the parse fails")
+    w.line("/// @return negative on error")
+    w.line("int %sParseTokens(const ClashStringView* tokens, size_t tokenCount, void* userData," % prefix)
+    w.line("    FldOutStream* responseStream, ClashScratch* scratch, ClashParseError* error)")
+    w.open("{")
+    w.open("if (error != 0) {")
+    w.line("clashParseErrorClear(error);")
+    w.close()
+    w.line()
+    w.line("ParseContext context;")
+    w.line("context.tokens = tokens;")
+    w.line("context.tokenCount = tokenCount;")
+    w.line("context.userData = userData;")
+    w.line("context.responseStream = responseStream;")
+    w.line("context.scratch = scratch;")
+    w.line("context.error = error;")
+    w.line()
+    w.line("size_t scratchMark = scratch->pos;")
+    w.line("int result;")
+    w.open("if (tokenCount != 0 && tokens[0].length != 0 && tokens[0].str[0] == '-') {")
+    w.line("result = parse%s(&context, 0);" % commands[0].ident)
+    w.close("} else {")
+    w.depth += 1
+    w.line("result = parseRoot(&context, 0);")
+    w.close()
+    w.line("clashScratchRewind(scratch, scratchMark);")
+    w.line()
+    w.line("return result;")
+    w.close()
+    w.line()
+    w.line("/// Splits the string and calls %sParseTokens()." % prefix)
+    w.line("/// @return negative on error")
+    w.line("int %sParseString(const char* s, void* userData, FldOutStream* responseStream," % prefix)
+    w.line("    ClashScratch* scratch, ClashParseError* error)")
+    w.open("{")
+    w.line("ClashStringView tokens[%s_MAX_TOKENS];" % macro_prefix)
+    w.line("int tokenCount = clashSplitStringViews(s, strlen(s), tokens, %s_MAX_TOKENS);" % macro_prefix)
+    w.open("if (tokenCount < 0) {")
+    w.line("ClashParseErrorKind kind = tokenCount == -1 ? ClashParseErrorKindUnterminatedQuote")
+    w.line("                                           : ClashParseErrorKindTooManyTokens;")
+    w.line("return clashParseErrorSet(error, kind, tokenCount, 0, 0, s, strlen(s), 0);")
+    w.close()
+    w.line()
+    w.line("return %sParseTokens(" % prefix)
+    w.line("    tokens, (size_t)tokenCount, userData, responseStream, scratch, error);")
+    w.close()
+
+    # The root level is a branch without a parent command
+    root = Writer()
+    root.depth = 0
+    write_branch(root, "parseRoot", commands, "findRootCommand", "ClashParseErrorKindUnknownCommand", -4,
+        "command")
+    source = w.text()
+    marker = "/// Parses and executes a tokenized command line"
+    source = source.replace(marker, root.text() + marker, 1)
+
+    return h.text(), source
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generates clash command tables and parsers")
+    parser.add_argument("schema", help="the .toml or .json schema")
+    parser.add_argument("--header", required=True, help="the header file to write")
+    parser.add_argument("--source", required=True, help="the source file to write")
+    args = parser.parse_args()
+
+    try:
+        schema = load_schema(args.schema)
+        header, source = generate(schema, os.path.basename(args.schema), os.path.basename(args.header))
+    except (SchemaError, KeyError, OSError, ValueError) as e:
+        print("clash-gen: %s" % e, file=sys.stderr)
+        return 1
+
+    for path, text in ((args.header, header), (args.source, source)):
+        with open(path, "w", encoding="utf-8", newline="\n") as f:
+            f.write(text)
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,146 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/clash-c
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#define _POSIX_C_SOURCE 199309L
+
+#include "example_commands.h"
+#include <clash/clash.h>
+#include <clash/history.h>
+#include <clash/response.h>
+#include <clash/scratch.h>
+#include <clog/clog.h>
+#include <clog/console.h>
+#include <flood/out_stream.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+clog_config g_clog;
+
+// Replays a history recorded with clashDefinitionSetHistory() as fast as possible. It is built
+// against the example schema, to replay the traces of a server, build it with the commands and
+// the ClashFn implementations of that server instead.
+
+void onRecordStart(void* userData, const RecordStartCmd* data, ClashResponse* response)
+{
+    (void)userData;
+
+    clashResponseWritef(response, "record start: %s verbose:%d frames:%d length:%lld ms\n",
+        data->filename, data->verbose, data->frames, (long long)data->length);
+}
+
+void onRecordStop(void* userData, const RecordStopCmd* data, ClashResponse* response)
+{
+    (void)userData;
+
+    clashResponseWritef(response, "record stop: %d\n", data->verbose);
+}
+
+void onQuit(void* userData, const void* data, ClashResponse* response)
+{
+    (void)userData;
+    (void)data;
+
+    clashResponseWritef(response, "quit\n");
+}
+
+static uint64_t nowNanoseconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+static int dumpHistory(const ClashHistory* history)
+{
+    size_t offset = 0;
+    ClashHistoryRecord record;
+    int found;
+    while ((found = clashHistoryNext(history, &offset, &record)) > 0) {
+        printf("%llu.%09llu node:%u", (unsigned long long)(record.timestamp / 1000000000u),
+            (unsigned long long)(record.timestamp % 1000000000u), record.nodeIndex);
+        const char* p = record.args;
+        for (size_t i = 0; i < record.argc; ++i) {
+            const char* quote = strchr(p, ' ') != 0 ? "\"" : "";
+            printf(" %s%s%s", quote, p, quote);
+            p += strlen(p) + 1;
+        }
+        printf("\n");
+    }
+
+    return found;
+}
+
+int main(int argc, const char* argv[])
+{
+    g_clog.log = clog_console;
+
+    const char* path = 0;
+    int isDump = 0;
+    unsigned long repeatCount = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--dump") == 0) {
+            isDump = 1;
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeatCount = strtoul(argv[++i], 0, 10);
+        } else {
+            path = argv[i];
+        }
+    }
+
+    if (path == 0) {
+        fprintf(stderr, "usage: clash-replay [--dump] [--repeat count] history-file\n");
+        return 1;
+    }
+
+    ClashHistory history;
+    int errorCode = clashHistoryOpen(&history, path);
+    if (errorCode < 0) {
+        fprintf(stderr, "could not open history '%s' (%d)\n", path, errorCode);
+        return 1;
+    }
+
+    if (isDump) {
+        errorCode = dumpHistory(&history);
+        clashHistoryClose(&history);
+        return errorCode < 0 ? 1 : 0;
+    }
+
+    clashDefinitionCompile(&exampleDefinition);
+
+    static uint8_t scratchMemory[16 * 1024];
+    ClashScratch scratch;
+    clashScratchInit(&scratch, scratchMemory, sizeof(scratchMemory));
+
+    static uint8_t responseMemory[64 * 1024];
+    FldOutStream responseOut;
+    fldOutStreamInit(&responseOut, responseMemory, sizeof(responseMemory));
+
+    ClashHistoryReplayResult result = { 0, 0, 0, 0 };
+    uint64_t startTime = nowNanoseconds();
+    for (unsigned long i = 0; i < repeatCount && errorCode >= 0; ++i) {
+        errorCode = clashHistoryReplay(&exampleDefinition, &history, 0, &responseOut, &scratch,
+            &result);
+    }
+    uint64_t elapsed = nowNanoseconds() - startTime;
+
+    if (errorCode < 0) {
+        fprintf(stderr, "history '%s' is malformed (%d)\n", path, errorCode);
+    }
+
+    size_t commandCount = result.commandCount * repeatCount;
+    double recordedSeconds = (double)(result.lastTimestamp - result.firstTimestamp) / 1e9;
+    printf("replayed %zu commands (%zu failed) in %.3f ms, %.1f ns/command, recorded over %.3f s, "
+           "%llu dropped while recording\n",
+        commandCount, result.failedCount * repeatCount, (double)elapsed / 1e6,
+        commandCount == 0 ? 0.0 : (double)elapsed / (double)commandCount, recordedSeconds,
+        (unsigned long long)clashHistoryDroppedCount(&history));
+
+    clashHistoryClose(&history);
+    clashDefinitionDestroy(&exampleDefinition);
+
+    return errorCode < 0 ? 1 : 0;
+}